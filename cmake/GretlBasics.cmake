@@ -25,3 +25,14 @@ option(GRETL_ENABLE_CODE_CHECKS "Enable Gretl's code checks" ${_enable_gretl_cod
 
 cmake_dependent_option(GRETL_ENABLE_TESTS "Enables Gretl Tests" ON "ENABLE_TESTS" OFF)
 
+option(GRETL_ENABLE_TOOLS "Enables Gretl command line tools" ON)
+
+
+if(CMAKE_BUILD_TYPE MATCHES "^(Release|RelWithDebInfo|MinSizeRel)$")
+    set(_gretl_validation_default "none")
+else()
+    set(_gretl_validation_default "cheap")
+endif()
+set(GRETL_VALIDATION ${_gretl_validation_default} CACHE STRING
+    "Per-step internal consistency checks: none, cheap or full (O(N) per step, debug builds only); defaults to none in release builds and cheap otherwise")
+set_property(CACHE GRETL_VALIDATION PROPERTY STRINGS none cheap full)
@@ -0,0 +1,217 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "adaptive_checkpoint_strategy.hpp"
+#include <algorithm>
+#include <iostream>
+#include "checkpoint.hpp"
+#include "checkpoint_simulator.hpp"
+#include "checkpoint_strategy_registry.hpp"
+
+namespace gretl {
+
+AdaptiveCheckpointStrategy::AdaptiveCheckpointStrategy(size_t maxStates, const std::vector<std::string>& candidates)
+    : budget_(maxStates)
+{
+  gretl_assert_msg(!candidates.empty(), "the adaptive checkpoint strategy needs at least one candidate");
+  for (const auto& name : candidates) {
+    gretl_assert_msg(name != "adaptive", "the adaptive checkpoint strategy cannot be its own candidate");
+    candidates_.push_back(Candidate{name, make_checkpoint_strategy(name, maxStates), true, {}, {}});
+  }
+}
+
+AdaptiveCheckpointStrategy::~AdaptiveCheckpointStrategy() = default;
+
+double AdaptiveCheckpointStrategy::expected_recomputations(Candidate& candidate, size_t length)
+{
+  auto measured = candidate.measured.find(length);
+  if (measured != candidate.measured.end()) {
+    return static_cast<double>(measured->second);
+  }
+
+  auto simulated_for = [&](Candidate& c) {
+    auto simulated = c.simulated.find(length);
+    if (simulated == c.simulated.end()) {
+      auto strategy = make_checkpoint_strategy(c.name, budget_);
+      size_t recomputations = simulate_checkpointing(length, *strategy).metrics.recomputations;
+      simulated = c.simulated.emplace(length, recomputations).first;
+    }
+    return static_cast<double>(simulated->second);
+  };
+
+  // scale the simulation by how well it predicted the active candidate on this graph
+  double scale = 1.0;
+  auto& active = candidates_[active_];
+  auto activeMeasured = active.measured.find(length);
+  if (activeMeasured != active.measured.end() && simulated_for(active) > 0.0) {
+    scale = static_cast<double>(activeMeasured->second) / simulated_for(active);
+  }
+  return scale * simulated_for(candidate);
+}
+
+void AdaptiveCheckpointStrategy::choose_active(bool inSyncOnly)
+{
+  if (candidates_.size() == 1 || sweepLength_ == 0) return;
+
+  size_t best = active_;
+  double bestExpected = expected_recomputations(candidates_[active_], sweepLength_);
+  for (size_t c = 0; c < candidates_.size(); ++c) {
+    if (c == active_ || (inSyncOnly && !candidates_[c].inSync)) continue;
+    double expected = expected_recomputations(candidates_[c], sweepLength_);
+    // switch for a strict improvement, or between sweeps to measure a candidate predicted to do no worse
+    bool unmeasured = !candidates_[c].measured.count(sweepLength_);
+    if (expected < bestExpected || (!inSyncOnly && unmeasured && expected <= bestExpected)) {
+      best = c;
+      bestExpected = expected;
+    }
+  }
+  if (best != active_) {
+    active_ = best;
+    ++switches_;
+  }
+}
+
+void AdaptiveCheckpointStrategy::begin_reverse_phase()
+{
+  forwardPhase_ = false;
+  choose_active(true);
+}
+
+size_t AdaptiveCheckpointStrategy::add_checkpoint_and_get_index_to_remove(size_t step, bool persistent)
+{
+  auto& active = *candidates_[active_].strategy;
+  size_t nextEraseStep = active.add_checkpoint_and_get_index_to_remove(step, persistent);
+
+  // persistent checkpoints outlive reset(), so every candidate needs all of them
+  for (size_t c = 0; c < candidates_.size(); ++c) {
+    auto& candidate = candidates_[c];
+    if (c == active_ || !(persistent || (forwardPhase_ && candidate.inSync))) continue;
+    size_t candidateEraseStep = candidate.strategy->add_checkpoint_and_get_index_to_remove(step, persistent);
+    if (candidateEraseStep != nextEraseStep) {
+      candidate.inSync = false;
+    }
+  }
+
+  if (forwardPhase_ && !persistent) {
+    sweepLength_ = std::max(sweepLength_, step);
+  }
+
+  metrics_.stores++;
+  if (valid_checkpoint_index(nextEraseStep)) {
+    metrics_.evictions++;
+  }
+  return nextEraseStep;
+}
+
+size_t AdaptiveCheckpointStrategy::last_checkpoint_step() const
+{
+  return candidates_[active_].strategy->last_checkpoint_step();
+}
+
+bool AdaptiveCheckpointStrategy::erase_step(size_t stepIndex)
+{
+  if (forwardPhase_) {
+    begin_reverse_phase();
+  }
+  return candidates_[active_].strategy->erase_step(stepIndex);
+}
+
+bool AdaptiveCheckpointStrategy::contains_step(size_t stepIndex) const
+{
+  return candidates_[active_].strategy->contains_step(stepIndex);
+}
+
+void AdaptiveCheckpointStrategy::reset()
+{
+  if (!forwardPhase_) {
+    candidates_[active_].measured[sweepLength_] = reverseRecomputations_;
+    choose_active(false);
+  }
+  for (auto& candidate : candidates_) {
+    candidate.strategy->reset();
+    candidate.inSync = true;
+  }
+  forwardPhase_ = true;
+  sweepLength_ = 0;
+  reverseRecomputations_ = 0;
+}
+
+size_t AdaptiveCheckpointStrategy::capacity() const { return candidates_[active_].strategy->capacity(); }
+
+std::vector<size_t> AdaptiveCheckpointStrategy::set_capacity(size_t maxStates)
+{
+  std::vector<size_t> evicted = candidates_[active_].strategy->set_capacity(maxStates);
+  for (size_t c = 0; c < candidates_.size(); ++c) {
+    auto& candidate = candidates_[c];
+    if (c == active_) continue;
+    if (candidate.strategy->set_capacity(maxStates) != evicted) {
+      candidate.inSync = false;
+    }
+  }
+  // earlier measurements and simulations were for the old budget
+  budget_ = maxStates;
+  for (auto& candidate : candidates_) {
+    candidate.measured.clear();
+    candidate.simulated.clear();
+  }
+  metrics_.evictions += evicted.size();
+  return evicted;
+}
+
+bool AdaptiveCheckpointStrategy::supports_renumbering() const
+{
+  return std::all_of(candidates_.begin(), candidates_.end(),
+                     [](const Candidate& candidate) { return candidate.strategy->supports_renumbering(); });
+}
+
+void AdaptiveCheckpointStrategy::renumber_steps(const std::vector<size_t>& newSteps)
+{
+  for (auto& candidate : candidates_) {
+    candidate.strategy->renumber_steps(newSteps);
+  }
+  if (sweepLength_ < newSteps.size() && valid_checkpoint_index(newSteps[sweepLength_])) {
+    sweepLength_ = newSteps[sweepLength_];
+  }
+}
+
+void AdaptiveCheckpointStrategy::make_persistent(size_t step)
+{
+  // as for persistent checkpoints added, every candidate needs all of them, and the phase of the sweep is unchanged
+  for (auto& candidate : candidates_) {
+    candidate.strategy->make_persistent(step);
+  }
+}
+
+size_t AdaptiveCheckpointStrategy::size() const { return candidates_[active_].strategy->size(); }
+
+void AdaptiveCheckpointStrategy::print(std::ostream& os) const
+{
+  os << "CHECKPOINTS (Adaptive): active = " << active_strategy() << ", switches = " << switches_ << std::endl;
+  candidates_[active_].strategy->print(os);
+}
+
+CheckpointMetrics AdaptiveCheckpointStrategy::metrics() const { return metrics_; }
+
+void AdaptiveCheckpointStrategy::reset_metrics() { metrics_ = {}; }
+
+void AdaptiveCheckpointStrategy::record_recomputation()
+{
+  metrics_.recomputations++;
+  if (!forwardPhase_) {
+    reverseRecomputations_++;
+  }
+}
+
+void AdaptiveCheckpointStrategy::set_eviction_oracle(EvictionOracle oracle)
+{
+  for (auto& candidate : candidates_) {
+    candidate.strategy->set_eviction_oracle(oracle);
+  }
+}
+
+const std::string& AdaptiveCheckpointStrategy::active_strategy() const { return candidates_[active_].name; }
+
+}  // namespace gretl
@@ -0,0 +1,98 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file adaptive_checkpoint_strategy.hpp
+ * @brief Meta-strategy which picks the eviction policy of several registered strategies online.
+ */
+
+#pragma once
+
+#include "checkpoint_strategy.hpp"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gretl {
+
+/// @brief Chooses between several checkpoint strategies (by default Wang and StrummWalther) while running, aiming to
+/// track whichever needs fewer recomputations without knowing the number of steps in advance.
+///
+/// One candidate is active during each sweep (the calls between two reset()s) and makes every decision.  During the
+/// forward phase of a sweep, i.e. until the first erase_step, every other candidate is fed the same calls for as long
+/// as it makes the same evictions as the active one.  Such candidates hold exactly the same checkpoints, so at the
+/// start of the reverse phase, when the graph length is known, the active candidate can switch to whichever of them is
+/// expected to recompute least.  At each reset() the candidate for the next sweep is chosen among all of them.
+///
+/// Expected reverse-phase recomputations come from the measured recomputations of earlier sweeps over a graph of the
+/// same length when a candidate has been active for one, otherwise from simulating the candidate on a linear chain of
+/// that length (scaled by the measured/simulated ratio of the active candidate, so the two are comparable).  Linear
+/// chain simulations cannot tell strategies apart which only differ on graphs with fan-in, so at a reset() an
+/// unmeasured candidate predicted to do no worse is made active for the next sweep to measure it.
+class AdaptiveCheckpointStrategy final : public CheckpointStrategy {
+ public:
+  /// @brief Construct with a given number of non-persistent checkpoint slots, choosing between registered strategies.
+  explicit AdaptiveCheckpointStrategy(size_t maxStates,
+                                      const std::vector<std::string>& candidates = {"wang", "strumm_walther"});
+
+  /// @brief Destructor
+  ~AdaptiveCheckpointStrategy() override;
+
+  size_t add_checkpoint_and_get_index_to_remove(size_t step, bool persistent = false) override;
+  size_t last_checkpoint_step() const override;
+  bool erase_step(size_t stepIndex) override;
+  bool contains_step(size_t stepIndex) const override;
+  void reset() override;
+  size_t capacity() const override;
+  std::vector<size_t> set_capacity(size_t maxStates) override;
+  bool supports_renumbering() const override;
+  void renumber_steps(const std::vector<size_t>& newSteps) override;
+  void make_persistent(size_t step) override;
+  size_t size() const override;
+  void print(std::ostream& os) const override;
+  CheckpointMetrics metrics() const override;
+  void reset_metrics() override;
+  void record_recomputation() override;
+  void set_eviction_oracle(EvictionOracle oracle) override;
+
+  /// @brief Name of the strategy currently making decisions.
+  const std::string& active_strategy() const;
+
+  /// @brief Number of times the active strategy changed.
+  size_t switches() const { return switches_; }
+
+ private:
+  /// @brief A candidate strategy and what is known about its performance.
+  struct Candidate {
+    std::string name;                              ///< registered name
+    std::unique_ptr<CheckpointStrategy> strategy;  ///< instance, fed calls while active or in sync
+    bool inSync = true;                            ///< holds the same checkpoints as the active candidate
+    std::map<size_t, size_t> measured;             ///< graph length -> reverse recomputations of the last sweep
+    std::map<size_t, size_t> simulated;            ///< graph length -> reverse recomputations on a linear chain
+  };
+
+  /// @brief Expected reverse-phase recomputations of a candidate for a graph of the given length.
+  double expected_recomputations(Candidate& candidate, size_t length);
+
+  /// @brief Switch to the candidate expected to recompute least, among those allowed.  Between sweeps (!inSyncOnly),
+  /// ties favour a candidate not yet measured for the current length.
+  void choose_active(bool inSyncOnly);
+
+  /// @brief Called at the first erase_step of a sweep.
+  void begin_reverse_phase();
+
+  size_t budget_;                      ///< non-persistent budget given to every candidate
+  std::vector<Candidate> candidates_;  ///< candidates, the first is active initially
+  size_t active_ = 0;                  ///< index of the active candidate
+  bool forwardPhase_ = true;           ///< no erase_step yet in this sweep
+  size_t sweepLength_ = 0;             ///< largest non-persistent step stored in the forward phase of this sweep
+  size_t reverseRecomputations_ = 0;   ///< recomputations in the reverse phase of this sweep
+  size_t switches_ = 0;                ///< number of changes of the active candidate
+  CheckpointMetrics metrics_;          ///< metrics, counted identically to the built-in strategies
+};
+
+}  // namespace gretl
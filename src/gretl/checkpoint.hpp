@@ -10,7 +10,7 @@
 
 #pragma once
 
-#include <map>
+#include <vector>
 #include <ostream>
 #include <iostream>
 #include <cassert>
@@ -33,57 +33,146 @@
                              std::string(", ") + std::string(msg_name_)};                                        \
   assert(x);
 
+/// @brief validation levels of the internal consistency checks run for every step of the graph, selected at compile
+/// time with GRETL_VALIDATION (the GRETL_VALIDATION cmake option: none, cheap or full)
+#define GRETL_VALIDATION_NONE 0   ///< no per-step checks, errors in the use of the api are still reported
+#define GRETL_VALIDATION_CHEAP 1  ///< constant time per-step checks (the default outside of release builds)
+#define GRETL_VALIDATION_FULL 2   ///< additionally check the whole graph after every step, O(N) per step
+
+#ifndef GRETL_VALIDATION
+#ifdef NDEBUG
+#define GRETL_VALIDATION GRETL_VALIDATION_NONE
+#else
+#define GRETL_VALIDATION GRETL_VALIDATION_CHEAP
+#endif
+#endif
+
+#if GRETL_VALIDATION >= GRETL_VALIDATION_FULL && defined(NDEBUG)
+#error "GRETL_VALIDATION=full is only available in debug builds"
+#endif
+
+#if GRETL_VALIDATION >= GRETL_VALIDATION_CHEAP
+/// @brief gretl_assert for internal consistency checks on the per-step paths, removed at GRETL_VALIDATION_NONE
+#define gretl_check(x) gretl_assert(x)
+#else
+#define gretl_check(x) static_cast<void>(sizeof(!(x)))
+#endif
+
+#if GRETL_VALIDATION >= GRETL_VALIDATION_FULL
+/// @brief gretl_assert for O(N) consistency checks of the whole graph, only compiled in at GRETL_VALIDATION_FULL
+#define gretl_check_full(x) gretl_assert(x)
+#else
+#define gretl_check_full(x) static_cast<void>(sizeof(!(x)))
+#endif
+
 namespace gretl {
 
 /// @brief interface to run forward with a linear graph, checkpoint, then automatically backpropagate the sensitivities
 /// given the reverse_callback vjp.
-/// @tparam T type of each state's data
+///
+/// Checkpoints live in a flat pool of slots, preallocated from strategy->capacity() as copies of the initial
+/// condition and reused as the strategy evicts steps, so update_func can write each new state in place into storage
+/// which already has the right shape.  The pool only grows if a strategy holds more checkpoints than its capacity.
+/// @tparam T type of each state's data, needs to be copy constructible
 /// @param numSteps number of forward iterations
 /// @param x initial condition
-/// @param update_func function which evaluates the forward response
+/// @param update_func function which evaluates the forward response in place: update_func(n, x_n, x_{n+1})
 /// @param reverse_callback vjp function (action of Jacobian-transposed) to back propagate sensitivities
 /// @param strategy checkpoint strategy (required)
-/// @return
+/// @return the final state x_{numSteps}
 template <typename T>
-T advance_and_reverse_steps(size_t numSteps, T x, std::function<T(size_t n, const T&)> update_func,
+T advance_and_reverse_steps(size_t numSteps, T x, std::function<void(size_t n, const T&, T&)> update_func,
                             std::function<void(size_t n, const T&)> reverse_callback,
                             std::unique_ptr<CheckpointStrategy> strategy)
 {
   CheckpointStrategy& cps = *strategy;
-  std::map<size_t, T> savedCps;
-  savedCps[0] = x;
+  constexpr size_t noSlot = CheckpointStrategy::invalidCheckpointIndex;
 
-  cps.add_checkpoint_and_get_index_to_remove(0, true);
-  for (size_t i = 0; i < numSteps; ++i) {
-    x = update_func(i, savedCps[i]);
-    size_t eraseStep = cps.add_checkpoint_and_get_index_to_remove(i + 1, false);
+  // the persistent initial condition, capacity() checkpoints, and the state currently being computed
+  std::vector<T> slots;
+  slots.reserve(cps.capacity() + 2);
+  slots.emplace_back(std::move(x));
+  std::vector<size_t> freeSlots;
+  for (size_t s = 1; s < cps.capacity() + 2; ++s) {
+    slots.push_back(slots.front());
+    freeSlots.push_back(s);
+  }
+  std::vector<size_t> slotOfStep(numSteps + 1, noSlot);
+  slotOfStep[0] = 0;
+
+  auto acquire_slot = [&]() {
+    if (freeSlots.empty()) {
+      slots.push_back(slots.front());
+      return slots.size() - 1;
+    }
+    size_t slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+  };
+
+  auto release_slot = [&](size_t step) {
+    if (slotOfStep[step] != noSlot) {
+      freeSlots.push_back(slotOfStep[step]);
+      slotOfStep[step] = noSlot;
+    }
+  };
+
+  auto advance = [&](size_t n) {
+    size_t eraseStep = cps.add_checkpoint_and_get_index_to_remove(n + 1, false);
+    // acquire before releasing the evicted step, so the output never aliases the input
+    size_t slot = acquire_slot();
+    update_func(n, slots[slotOfStep[n]], slots[slot]);
+    slotOfStep[n + 1] = slot;
     if (cps.valid_checkpoint_index(eraseStep)) {
-      savedCps.erase(eraseStep);
+      release_slot(eraseStep);
     }
+  };
 
-    savedCps[i + 1] = x;
+  cps.add_checkpoint_and_get_index_to_remove(0, true);
+  for (size_t i = 0; i < numSteps; ++i) {
+    advance(i);
   }
 
-  double xf = x;
+  // the final state is held outside of the pool until it is returned
+  size_t finalSlot = slotOfStep[numSteps];
 
   for (size_t i = numSteps; i + 1 > 0; --i) {
     while (cps.last_checkpoint_step() < i) {
-      size_t lastCp = cps.last_checkpoint_step();
-      x = update_func(lastCp, savedCps[lastCp]);
-      size_t eraseStep = cps.add_checkpoint_and_get_index_to_remove(lastCp + 1, false);
-      if (cps.valid_checkpoint_index(eraseStep)) {
-        savedCps.erase(eraseStep);
-      }
-      savedCps[lastCp + 1] = x;
+      advance(cps.last_checkpoint_step());
       cps.record_recomputation();
     }
-    reverse_callback(i, savedCps[i]);
+    reverse_callback(i, slots[slotOfStep[i]]);
 
     cps.erase_step(i);
-    savedCps.erase(i);
+    if (i == numSteps) {
+      slotOfStep[i] = noSlot;
+    } else {
+      release_slot(i);
+    }
   }
 
-  return xf;
+  return std::move(slots[finalSlot]);
+}
+
+/// @brief interface to run forward with a linear graph, checkpoint, then automatically backpropagate the sensitivities
+/// given the reverse_callback vjp.  Overload for update functions which return the new state by value.
+/// @tparam T type of each state's data, needs to be copy constructible and move assignable
+/// @param numSteps number of forward iterations
+/// @param x initial condition
+/// @param update_func function which evaluates the forward response
+/// @param reverse_callback vjp function (action of Jacobian-transposed) to back propagate sensitivities
+/// @param strategy checkpoint strategy (required)
+/// @return the final state x_{numSteps}
+template <typename T>
+T advance_and_reverse_steps(size_t numSteps, T x, std::function<T(size_t n, const T&)> update_func,
+                            std::function<void(size_t n, const T&)> reverse_callback,
+                            std::unique_ptr<CheckpointStrategy> strategy)
+{
+  std::function<void(size_t n, const T&, T&)> in_place_update = [update_func](size_t n, const T& xn, T& xnp1) {
+    xnp1 = update_func(n, xn);
+  };
+  return advance_and_reverse_steps<T>(numSteps, std::move(x), std::move(in_place_update), std::move(reverse_callback),
+                                      std::move(strategy));
 }
 
 }  // namespace gretl
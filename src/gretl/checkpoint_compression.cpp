@@ -0,0 +1,246 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "checkpoint_compression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "checkpoint.hpp"
+
+namespace gretl {
+
+namespace {
+
+constexpr size_t headerBytes = 8;  // number of values
+constexpr std::uint64_t exponentMask = 0x7ff;
+constexpr size_t maxLiteral = 128;  // control bytes below 128 are followed by control + 1 literal bytes
+constexpr size_t minRun = 3;        // control bytes from 128 repeat the next byte control - 125 times
+constexpr size_t maxRun = 130;
+
+std::uint64_t to_bits(double value)
+{
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double from_bits(std::uint64_t bits)
+{
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/// write the number of values as the header
+void write_count(size_t count, std::uint8_t* header)
+{
+  std::uint64_t count64 = count;
+  for (size_t k = 0; k < headerBytes; ++k) {
+    header[k] = static_cast<std::uint8_t>(count64 >> (8 * k));
+  }
+}
+
+/// read the number of values from the header
+size_t read_count(const std::vector<std::uint8_t>& bytes)
+{
+  gretl_assert_msg(bytes.size() >= headerBytes, "corrupt compressed checkpoint");
+  std::uint64_t count64 = 0;
+  for (size_t k = 0; k < headerBytes; ++k) {
+    count64 |= std::uint64_t{bytes[k]} << (8 * k);
+  }
+  return static_cast<size_t>(count64);
+}
+
+/// round the mantissa to nearest, keeping mantissaBits bits.  Zeros, subnormals, infinities and nans are unchanged.
+std::uint64_t round_mantissa(std::uint64_t bits, int mantissaBits)
+{
+  std::uint64_t exponent = (bits >> 52) & exponentMask;
+  if (mantissaBits >= 52 || exponent == 0 || exponent == exponentMask) {
+    return bits;
+  }
+  unsigned dropped = static_cast<unsigned>(52 - mantissaBits);
+  std::uint64_t mask = ~((std::uint64_t{1} << dropped) - 1);
+  std::uint64_t rounded = (bits + (std::uint64_t{1} << (dropped - 1))) & mask;
+  // a carry may reach the next exponent, which is still within the bound, but must not overflow to infinity
+  if (((rounded >> 52) & exponentMask) == exponentMask) {
+    return bits & mask;
+  }
+  return rounded;
+}
+
+/// PackBits style run-length encoding
+void run_length_encode(const std::vector<std::uint8_t>& in, std::vector<std::uint8_t>& out)
+{
+  size_t i = 0;
+  size_t literalStart = 0;
+  auto flush_literals = [&](size_t end) {
+    while (literalStart < end) {
+      size_t count = std::min(maxLiteral, end - literalStart);
+      out.push_back(static_cast<std::uint8_t>(count - 1));
+      out.insert(out.end(), in.begin() + static_cast<std::ptrdiff_t>(literalStart),
+                 in.begin() + static_cast<std::ptrdiff_t>(literalStart + count));
+      literalStart += count;
+    }
+  };
+
+  while (i < in.size()) {
+    size_t run = 1;
+    while (i + run < in.size() && run < maxRun && in[i + run] == in[i]) {
+      ++run;
+    }
+    if (run >= minRun) {
+      flush_literals(i);
+      out.push_back(static_cast<std::uint8_t>(run + 125));
+      out.push_back(in[i]);
+      i += run;
+      literalStart = i;
+    } else {
+      i += run;
+    }
+  }
+  flush_literals(in.size());
+}
+
+void run_length_decode(const std::uint8_t* in, size_t size, std::vector<std::uint8_t>& out)
+{
+  size_t i = 0;
+  while (i < size) {
+    size_t control = in[i++];
+    if (control < maxLiteral) {
+      gretl_assert_msg(i + control + 1 <= size, "corrupt compressed checkpoint");
+      out.insert(out.end(), in + i, in + i + control + 1);
+      i += control + 1;
+    } else {
+      gretl_assert_msg(i < size, "corrupt compressed checkpoint");
+      out.insert(out.end(), control - 125, in[i++]);
+    }
+  }
+}
+
+}  // namespace
+
+FloatingPointCodec::FloatingPointCodec(double relativeErrorBound)
+{
+  gretl_assert_msg(relativeErrorBound >= 0.0, "relative error bound must be non-negative");
+  // rounding to m mantissa bits gives a relative error of at most 2^-(m+1)
+  mantissaBits_ = 52;
+  if (relativeErrorBound > 0.0) {
+    double bits = std::ceil(-std::log2(relativeErrorBound)) - 1.0;
+    mantissaBits_ = static_cast<int>(std::max(0.0, std::min(52.0, bits)));
+  }
+}
+
+bool FloatingPointCodec::compress(const std::any& primal, CompressedPrimal& compressed) const
+{
+  auto vector = std::any_cast<std::vector<double>>(&primal);
+  if (!vector) {
+    return false;
+  }
+  const double* values = vector->data();
+  size_t count = vector->size();
+
+  // xor with the previous value, then shuffle byte k of every value into plane k
+  std::vector<std::uint8_t> planes(8 * count);
+  std::uint64_t previous = 0;
+  for (size_t i = 0; i < count; ++i) {
+    std::uint64_t bits = round_mantissa(to_bits(values[i]), mantissaBits_);
+    std::uint64_t delta = bits ^ previous;
+    previous = bits;
+    for (size_t k = 0; k < 8; ++k) {
+      planes[k * count + i] = static_cast<std::uint8_t>(delta >> (8 * k));
+    }
+  }
+
+  std::vector<std::uint8_t> bytes(headerBytes);
+  bytes.reserve(headerBytes + planes.size() / 2);
+  write_count(count, bytes.data());
+  run_length_encode(planes, bytes);
+
+  size_t rawBytes = count * sizeof(double);
+  if (bytes.size() >= rawBytes) {
+    return false;
+  }
+  bytes.shrink_to_fit();
+  compressed.bytes = std::move(bytes);
+  compressed.rawBytes = rawBytes;
+  return true;
+}
+
+std::any FloatingPointCodec::decompress(const CompressedPrimal& compressed) const
+{
+  const auto& bytes = compressed.bytes;
+  size_t count = read_count(bytes);
+
+  std::vector<std::uint8_t> planes;
+  planes.reserve(8 * count);
+  run_length_decode(bytes.data() + headerBytes, bytes.size() - headerBytes, planes);
+  gretl_assert_msg(planes.size() == 8 * count, "corrupt compressed checkpoint");
+
+  std::vector<double> values(count);
+  std::uint64_t previous = 0;
+  for (size_t i = 0; i < count; ++i) {
+    std::uint64_t delta = 0;
+    for (size_t k = 0; k < 8; ++k) {
+      delta |= std::uint64_t{planes[k * count + i]} << (8 * k);
+    }
+    previous ^= delta;
+    values[i] = from_bits(previous);
+  }
+  return values;
+}
+
+bool Float32Codec::compress(const std::any& primal, CompressedPrimal& compressed) const
+{
+  auto vector = std::any_cast<std::vector<double>>(&primal);
+  if (!vector) {
+    return false;
+  }
+  size_t count = vector->size();
+  size_t rawBytes = count * sizeof(double);
+  if (headerBytes + count * sizeof(float) >= rawBytes) {
+    return false;
+  }
+  // converting a finite double beyond the float range is undefined, in practice it becomes inf and every gradient
+  // recomputed from the checkpoint with it, so such a primal stays in double precision
+  constexpr double floatMax = static_cast<double>(std::numeric_limits<float>::max());
+  if (std::any_of(vector->begin(), vector->end(), [](double x) { return std::abs(x) > floatMax; })) {
+    return false;
+  }
+
+  compressed.bytes.resize(headerBytes + count * sizeof(float));
+  write_count(count, compressed.bytes.data());
+  for (size_t i = 0; i < count; ++i) {
+    float value = static_cast<float>((*vector)[i]);
+    std::memcpy(compressed.bytes.data() + headerBytes + i * sizeof(float), &value, sizeof(float));
+  }
+  compressed.rawBytes = rawBytes;
+  return true;
+}
+
+std::any Float32Codec::decompress(const CompressedPrimal& compressed) const
+{
+  const auto& bytes = compressed.bytes;
+  size_t count = read_count(bytes);
+  gretl_assert_msg(bytes.size() == headerBytes + count * sizeof(float), "corrupt compressed checkpoint");
+
+  std::vector<double> values(count);
+  for (size_t i = 0; i < count; ++i) {
+    float value;
+    std::memcpy(&value, bytes.data() + headerBytes + i * sizeof(float), sizeof(float));
+    values[i] = static_cast<double>(value);
+  }
+  return values;
+}
+
+std::shared_ptr<const PrimalCodec> make_floating_point_codec(double relativeErrorBound)
+{
+  return std::make_shared<FloatingPointCodec>(relativeErrorBound);
+}
+
+std::shared_ptr<const PrimalCodec> make_float32_codec() { return std::make_shared<Float32Codec>(); }
+
+}  // namespace gretl
@@ -0,0 +1,91 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file checkpoint_compression.hpp
+ * @brief Codecs for compressing the primal values of checkpointed states while they are not being used.
+ */
+
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gretl {
+
+/// @brief A compressed primal value, stored in place of the primal while its step is only held as a checkpoint
+struct CompressedPrimal {
+  std::vector<std::uint8_t> bytes;  ///< encoded value
+  size_t rawBytes = 0;              ///< size of the value before compression
+};
+
+/// @brief counters of a DataStore's checkpoint compression
+struct CompressionMetrics {
+  size_t compressions = 0;     ///< number of primals compressed
+  size_t decompressions = 0;   ///< number of primals decompressed on access
+  size_t rawBytes = 0;         ///< total size of the primals compressed
+  size_t compressedBytes = 0;  ///< total size of those primals after compression
+
+  /// @brief raw over compressed size of everything compressed so far
+  double ratio() const
+  {
+    return compressedBytes ? static_cast<double>(rawBytes) / static_cast<double>(compressedBytes) : 1.0;
+  }
+};
+
+/// @brief Interface for compressing type-erased primal values
+class PrimalCodec {
+ public:
+  /// @brief virtual destructor
+  virtual ~PrimalCodec() = default;
+
+  /// @brief Compress a primal value.  Returns false, leaving the primal uncompressed, if its type is not supported or
+  /// compression would not save memory.
+  virtual bool compress(const std::any& primal, CompressedPrimal& compressed) const = 0;
+
+  /// @brief Restore a primal value compressed by this codec
+  virtual std::any decompress(const CompressedPrimal& compressed) const = 0;
+};
+
+/// @brief Codec for std::vector<double> primals (e.g. VectorState).  Each value is xor-ed with the previous one, so
+/// smooth fields leave mostly zero sign, exponent and leading mantissa bits, and the 8 bytes of every value are then
+/// shuffled into byte planes and run-length encoded.  Lossless by default.  With a positive relative error bound,
+/// mantissas of normal numbers are first rounded to the fewest bits keeping |x - x'| <= relativeErrorBound |x|, which
+/// zeroes the low mantissa bytes.
+class FloatingPointCodec final : public PrimalCodec {
+ public:
+  /// @brief Construct with an optional relative error bound (0 is lossless)
+  explicit FloatingPointCodec(double relativeErrorBound = 0.0);
+
+  bool compress(const std::any& primal, CompressedPrimal& compressed) const override;
+  std::any decompress(const CompressedPrimal& compressed) const override;
+
+  /// @brief Number of mantissa bits kept, 52 when lossless
+  int mantissa_bits() const { return mantissaBits_; }
+
+ private:
+  int mantissaBits_;  ///< mantissa bits kept
+};
+
+/// @brief Codec storing std::vector<double> primals (e.g. VectorState) in single precision.  Restored primals are
+/// upcast back to double, so recomputations from them run in full precision starting from the rounded values.  Primals
+/// with a finite value beyond the float range are not compressed.
+class Float32Codec final : public PrimalCodec {
+ public:
+  bool compress(const std::any& primal, CompressedPrimal& compressed) const override;
+  std::any decompress(const CompressedPrimal& compressed) const override;
+};
+
+/// @brief Make a codec for DataStore::set_checkpoint_compression
+/// @param relativeErrorBound 0 for lossless compression, otherwise the relative error allowed in each value
+std::shared_ptr<const PrimalCodec> make_floating_point_codec(double relativeErrorBound = 0.0);
+
+/// @brief Make a codec storing checkpoints in single precision, e.g. for StateBase::set_checkpoint_codec
+std::shared_ptr<const PrimalCodec> make_float32_codec();
+
+}  // namespace gretl
@@ -0,0 +1,284 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "checkpoint_file.hpp"
+#include <cstring>
+#include <fstream>
+#include <map>
+#include "state_base.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRETL_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gretl {
+
+namespace {
+
+constexpr char magic[8] = {'G', 'R', 'E', 'T', 'L', 'C', 'K', 'P'};
+constexpr std::uint32_t byteOrderMarker = 0x01020304;
+constexpr size_t headerBytes = 32;
+constexpr size_t payloadAlignment = 8;
+
+/// the built-in serializers are registered here rather than by static registration objects, which a linker may drop
+/// from a static library
+std::map<std::type_index, PrimalSerializer>& registry()
+{
+  static std::map<std::type_index, PrimalSerializer> serializers = {
+      {std::type_index(typeid(double)),
+       PrimalSerializer{"double",
+                        [](const std::any& primal, std::vector<std::uint8_t>& bytes) {
+                          double value = std::any_cast<double>(primal);
+                          auto begin = reinterpret_cast<const std::uint8_t*>(&value);
+                          bytes.insert(bytes.end(), begin, begin + sizeof(double));
+                        },
+                        [](const std::uint8_t* bytes, size_t size) {
+                          gretl_assert_msg(size == sizeof(double), "corrupt checkpoint file");
+                          double value;
+                          std::memcpy(&value, bytes, sizeof(double));
+                          return std::any(value);
+                        }}},
+      {std::type_index(typeid(std::vector<double>)),
+       PrimalSerializer{"vector<double>",
+                        [](const std::any& primal, std::vector<std::uint8_t>& bytes) {
+                          const auto& values = std::any_cast<const std::vector<double>&>(primal);
+                          auto begin = reinterpret_cast<const std::uint8_t*>(values.data());
+                          bytes.insert(bytes.end(), begin, begin + values.size() * sizeof(double));
+                        },
+                        [](const std::uint8_t* bytes, size_t size) {
+                          gretl_assert_msg(size % sizeof(double) == 0, "corrupt checkpoint file");
+                          std::vector<double> values(size / sizeof(double));
+                          std::memcpy(values.data(), bytes, size);
+                          return std::any(std::move(values));
+                        }}}};
+  return serializers;
+}
+
+template <typename T>
+void write_value(std::ostream& out, T value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/// bounds checked reads from the mapped file
+struct Reader {
+  const std::uint8_t* data;
+  size_t size;
+  size_t position;
+
+  template <typename T>
+  T read()
+  {
+    gretl_assert_msg(position + sizeof(T) <= size, "corrupt checkpoint file, unexpected end of file");
+    T value;
+    std::memcpy(&value, data + position, sizeof(T));
+    position += sizeof(T);
+    return value;
+  }
+
+  std::string read_string()
+  {
+    auto length = read<std::uint64_t>();
+    gretl_assert_msg(length <= size - position, "corrupt checkpoint file, unexpected end of file");
+    std::string value(reinterpret_cast<const char*>(data + position), static_cast<size_t>(length));
+    position += static_cast<size_t>(length);
+    return value;
+  }
+};
+
+}  // namespace
+
+void register_primal_serializer(std::type_index type, PrimalSerializer serializer)
+{
+  gretl_assert_msg(!serializer.name.empty() && serializer.write && serializer.read,
+                   "a primal serializer needs a name, a write and a read function");
+  registry()[type] = std::move(serializer);
+}
+
+const PrimalSerializer* find_primal_serializer(std::type_index type)
+{
+  auto serializer = registry().find(type);
+  return serializer == registry().end() ? nullptr : &serializer->second;
+}
+
+const PrimalSerializer* find_primal_serializer(const std::string& name)
+{
+  for (const auto& entry : registry()) {
+    if (entry.second.name == name) {
+      return &entry.second;
+    }
+  }
+  return nullptr;
+}
+
+void save_checkpoint_file(DataStore& dataStore, const std::string& path)
+{
+  gretl_assert_msg(dataStore.currentStep_ == dataStore.size(),
+                   "checkpoint files are written after building the graph, before back propagating");
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  gretl_assert_msg(out, "could not open checkpoint file '" + path + "' for writing");
+
+  std::vector<std::string> names;
+  std::map<std::string, std::uint32_t> nameIndex;
+  auto name_index = [&](const std::string& name) {
+    auto [entry, inserted] = nameIndex.emplace(name, static_cast<std::uint32_t>(names.size()));
+    if (inserted) {
+      names.push_back(name);
+    }
+    return entry->second;
+  };
+
+  out.write(magic, sizeof(magic));
+  write_value(out, CheckpointFile::version);
+  write_value(out, byteOrderMarker);
+  write_value(out, std::uint64_t{dataStore.size()});
+  write_value(out, std::uint64_t{0});  // step table offset, written at the end
+
+  struct StepEntry {
+    std::uint32_t stepType;
+    std::uint32_t primalType;
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+  std::vector<StepEntry> entries;
+  std::vector<std::uint8_t> bytes;
+  std::uint64_t position = headerBytes;
+  for (Int step = 0; step < dataStore.size(); ++step) {
+    const StateBase& state = *dataStore.states_[step];
+    StepEntry entry{name_index(typeid(state).name()), ~std::uint32_t{0}, 0, 0};
+    if (state.primal() && !dataStore.is_persistent(step)) {
+      // save compressed or not yet paged in primals without changing what the DataStore holds
+      const std::any& stored = *state.primal();
+      std::any restored;
+      if (auto compressed = std::any_cast<CompressedPrimal>(&stored)) {
+        restored = dataStore.checkpoint_codec(step)->decompress(*compressed);
+      } else if (auto mapped = std::any_cast<MappedPrimal>(&stored)) {
+        restored = mapped->file->read_primal(mapped->step);
+      }
+      const std::any& primal = restored.has_value() ? restored : stored;
+      auto serializer = find_primal_serializer(std::type_index(primal.type()));
+      gretl_assert_msg(serializer, "no primal serializer registered for the type of step " + std::to_string(step) +
+                                       ", see register_primal_serializer");
+      bytes.clear();
+      serializer->write(primal, bytes);
+      while (position % payloadAlignment) {
+        out.put(0);
+        ++position;
+      }
+      entry.primalType = name_index(serializer->name);
+      entry.offset = position;
+      entry.size = bytes.size();
+      out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+      position += bytes.size();
+    }
+    entries.push_back(entry);
+  }
+
+  std::uint64_t tableOffset = position;
+  write_value(out, std::uint64_t{names.size()});
+  for (const auto& name : names) {
+    write_value(out, std::uint64_t{name.size()});
+    out.write(name.data(), static_cast<std::streamsize>(name.size()));
+  }
+  for (Int step = 0; step < dataStore.size(); ++step) {
+    const auto& entry = entries[step];
+    write_value(out, entry.stepType);
+    write_value(out, entry.primalType);
+    write_value(out, entry.offset);
+    write_value(out, entry.size);
+    write_value(out, std::uint64_t{dataStore.upstreamSteps_[step].size()});
+    for (Int upstream : dataStore.upstreamSteps_[step]) {
+      write_value(out, std::uint32_t{upstream});
+    }
+  }
+
+  out.seekp(static_cast<std::streamoff>(headerBytes - sizeof(std::uint64_t)));
+  write_value(out, tableOffset);
+  gretl_assert_msg(out, "failed writing checkpoint file '" + path + "'");
+}
+
+std::shared_ptr<const CheckpointFile> CheckpointFile::open(const std::string& path)
+{
+  std::shared_ptr<CheckpointFile> file(new CheckpointFile());
+
+#ifdef GRETL_HAVE_MMAP
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  gretl_assert_msg(descriptor >= 0, "could not open checkpoint file '" + path + "'");
+  struct stat status;
+  bool statOk = ::fstat(descriptor, &status) == 0;
+  file->size_ = statOk ? static_cast<size_t>(status.st_size) : 0;
+  void* mapped = file->size_ ? ::mmap(nullptr, file->size_, PROT_READ, MAP_PRIVATE, descriptor, 0) : MAP_FAILED;
+  ::close(descriptor);
+  gretl_assert_msg(mapped != MAP_FAILED, "could not map checkpoint file '" + path + "'");
+  file->data_ = static_cast<const std::uint8_t*>(mapped);
+#else
+  std::ifstream in(path, std::ios::binary);
+  gretl_assert_msg(in, "could not open checkpoint file '" + path + "'");
+  file->buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  file->data_ = file->buffer_.data();
+  file->size_ = file->buffer_.size();
+#endif
+
+  Reader reader{file->data_, file->size_, 0};
+  gretl_assert_msg(file->size_ >= headerBytes && std::memcmp(file->data_, magic, sizeof(magic)) == 0,
+                   "'" + path + "' is not a gretl checkpoint file");
+  reader.position = sizeof(magic);
+  auto fileVersion = reader.read<std::uint32_t>();
+  gretl_assert_msg(fileVersion == version, "unsupported checkpoint file version " + std::to_string(fileVersion));
+  auto fileByteOrder = reader.read<std::uint32_t>();
+  gretl_assert_msg(fileByteOrder == byteOrderMarker,
+                   "checkpoint file '" + path + "' was written with a different byte order");
+  auto numSteps = reader.read<std::uint64_t>();
+  auto tableOffset = reader.read<std::uint64_t>();
+  gretl_assert_msg(tableOffset >= headerBytes && tableOffset <= file->size_, "corrupt checkpoint file");
+
+  reader.position = static_cast<size_t>(tableOffset);
+  auto numNames = reader.read<std::uint64_t>();
+  for (std::uint64_t n = 0; n < numNames; ++n) {
+    file->names_.push_back(reader.read_string());
+  }
+  for (std::uint64_t step = 0; step < numSteps; ++step) {
+    Step entry;
+    entry.stepType = reader.read<std::uint32_t>();
+    entry.primalType = reader.read<std::uint32_t>();
+    entry.offset = reader.read<std::uint64_t>();
+    entry.size = reader.read<std::uint64_t>();
+    gretl_assert_msg(entry.stepType < numNames && (entry.primalType == noPrimal || entry.primalType < numNames) &&
+                         entry.offset <= tableOffset && entry.size <= tableOffset - entry.offset,
+                     "corrupt checkpoint file, bad entry for step " + std::to_string(step));
+    auto numUpstreams = reader.read<std::uint64_t>();
+    for (std::uint64_t u = 0; u < numUpstreams; ++u) {
+      entry.upstreams.push_back(reader.read<std::uint32_t>());
+    }
+    file->steps_.push_back(std::move(entry));
+  }
+  return file;
+}
+
+CheckpointFile::~CheckpointFile()
+{
+#ifdef GRETL_HAVE_MMAP
+  if (data_) {
+    ::munmap(const_cast<std::uint8_t*>(data_), size_);
+  }
+#endif
+}
+
+std::any CheckpointFile::read_primal(Int step) const
+{
+  gretl_assert_msg(has_primal(step), "the primal of step " + std::to_string(step) + " is not in the checkpoint file");
+  const auto& entry = steps_[step];
+  const auto& name = names_[entry.primalType];
+  auto serializer = find_primal_serializer(name);
+  gretl_assert_msg(serializer, "no primal serializer registered under the name '" + name + "'");
+  return serializer->read(data_ + entry.offset, static_cast<size_t>(entry.size));
+}
+
+}  // namespace gretl
@@ -0,0 +1,128 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file checkpoint_file.hpp
+ * @brief Saving the checkpoints of a forward run to a file, and restoring a graph from it in a later job for back
+ * propagation without repeating the forward pass.
+ */
+
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <vector>
+#include "data_store.hpp"
+
+namespace gretl {
+
+/// @brief Serialization hooks for one primal type
+struct PrimalSerializer {
+  /// @brief name identifying the type in checkpoint files, which must be the same in every process reading them
+  std::string name;
+  /// @brief append the bytes of a primal to a buffer
+  std::function<void(const std::any& primal, std::vector<std::uint8_t>& bytes)> write;
+  /// @brief read a primal back from the bytes written for it
+  std::function<std::any(const std::uint8_t* bytes, size_t size)> read;
+};
+
+/// @brief Register the serialization hooks for a primal type.  Registering a type again replaces its hooks.  The
+/// built-in hooks cover double ("double") and std::vector<double> ("vector<double>").
+void register_primal_serializer(std::type_index type, PrimalSerializer serializer);
+
+/// @brief Typed convenience overload of register_primal_serializer
+template <typename T>
+void register_primal_serializer(const std::string& name,
+                                std::function<void(const T& primal, std::vector<std::uint8_t>& bytes)> write,
+                                std::function<T(const std::uint8_t* bytes, size_t size)> read)
+{
+  register_primal_serializer(
+      std::type_index(typeid(T)),
+      PrimalSerializer{name, [write](const std::any& primal, std::vector<std::uint8_t>& bytes) {
+                         write(std::any_cast<const T&>(primal), bytes);
+                       },
+                       [read](const std::uint8_t* bytes, size_t size) { return std::any(read(bytes, size)); }});
+}
+
+/// @brief Find the serialization hooks for a primal type, null if none are registered
+const PrimalSerializer* find_primal_serializer(std::type_index type);
+
+/// @brief Find the serialization hooks registered under a name, null if none are registered
+const PrimalSerializer* find_primal_serializer(const std::string& name);
+
+/// @brief Write the graph metadata and every non-persistent primal currently held by a DataStore to a checkpoint file.
+/// Must be called after building the graph and before back propagating, when the DataStore holds exactly the
+/// checkpoints chosen by its strategy during the forward pass.
+///
+/// Layout (version 1, native byte order, checked when reading): a 32 byte header with the magic "GRETLCKP", the format
+/// version, a byte order marker, the number of steps and the offset of the step table; then the primal payloads, each
+/// aligned to 8 bytes; then the step table: a table of type names, followed by each step's type name, primal type name
+/// (or none), payload offset and size, and upstream steps.  All integers are 32 or 64 bit.
+void save_checkpoint_file(DataStore& dataStore, const std::string& path);
+
+/// @brief A checkpoint file opened for restoring a graph.  The file is memory mapped, so payloads are only paged in
+/// when a restored step's primal is first accessed.
+class CheckpointFile {
+ public:
+  /// @brief current version of the file layout
+  static constexpr std::uint32_t version = 1;
+
+  /// @brief Open and map a file written by save_checkpoint_file.  Throws if it is not a valid checkpoint file.
+  static std::shared_ptr<const CheckpointFile> open(const std::string& path);
+
+  /// @brief Unmaps the file
+  ~CheckpointFile();
+
+  CheckpointFile(const CheckpointFile&) = delete;             ///< not copyable
+  CheckpointFile& operator=(const CheckpointFile&) = delete;  ///< not copyable
+
+  /// @brief Number of steps in the saved graph
+  size_t num_steps() const { return steps_.size(); }
+
+  /// @brief Upstream steps of a saved step
+  const std::vector<Int>& upstream_steps(Int step) const { return steps_[step].upstreams; }
+
+  /// @brief Type of a saved step's state
+  const std::string& step_type(Int step) const { return names_[steps_[step].stepType]; }
+
+  /// @brief Check if the primal of a step was saved
+  bool has_primal(Int step) const { return steps_[step].primalType != noPrimal; }
+
+  /// @brief Read the saved primal of a step
+  std::any read_primal(Int step) const;
+
+ private:
+  CheckpointFile() = default;
+
+  static constexpr std::uint32_t noPrimal = ~std::uint32_t{0};
+
+  /// @brief metadata of one saved step
+  struct Step {
+    std::uint32_t stepType;      ///< index of the state type name
+    std::uint32_t primalType;    ///< index of the primal serializer name, noPrimal if not saved
+    std::uint64_t offset;        ///< payload offset in the file
+    std::uint64_t size;          ///< payload size
+    std::vector<Int> upstreams;  ///< upstream steps
+  };
+
+  const std::uint8_t* data_ = nullptr;  ///< mapped file contents
+  size_t size_ = 0;                     ///< file size
+  std::vector<std::uint8_t> buffer_;    ///< file contents when memory mapping is not available
+  std::vector<std::string> names_;      ///< type names
+  std::vector<Step> steps_;             ///< saved steps
+};
+
+/// @brief Placeholder held in place of a restored primal until it is first accessed
+struct MappedPrimal {
+  std::shared_ptr<const CheckpointFile> file;  ///< file holding the primal
+  Int step;                                    ///< step to read
+};
+
+}  // namespace gretl
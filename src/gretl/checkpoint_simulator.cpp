@@ -0,0 +1,122 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "checkpoint_simulator.hpp"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include "checkpoint.hpp"
+
+namespace gretl {
+
+SimulationResult simulate_checkpointing(size_t numSteps, CheckpointStrategy& strategy, const StepModel& stepCost,
+                                        const StepModel& stepMemory)
+{
+  auto cost = [&](size_t n) { return stepCost ? stepCost(n) : 1.0; };
+  auto memory = [&](size_t n) { return stepMemory ? stepMemory(n) : 1.0; };
+
+  SimulationResult result;
+  strategy.reset_metrics();
+
+  std::map<size_t, double> stored;  // checkpointed step -> memory
+  double storedMemory = 0.0;
+
+  auto store = [&](size_t step, bool persistent) {
+    // the new state exists alongside all current checkpoints until the evicted one is released
+    double stepMemoryValue = memory(step);
+    result.peakMemory = std::max(result.peakMemory, storedMemory + stepMemoryValue);
+    result.peakCheckpoints = std::max(result.peakCheckpoints, stored.size() + 1);
+    size_t eraseStep = strategy.add_checkpoint_and_get_index_to_remove(step, persistent);
+    if (CheckpointStrategy::valid_checkpoint_index(eraseStep)) {
+      auto evicted = stored.find(eraseStep);
+      gretl_assert_msg(evicted != stored.end(), "strategy evicted step " + std::to_string(eraseStep) +
+                                                    " which is not checkpointed");
+      storedMemory -= evicted->second;
+      stored.erase(evicted);
+    }
+    stored[step] = stepMemoryValue;
+    storedMemory += stepMemoryValue;
+  };
+
+  store(0, true);
+  for (size_t i = 0; i < numSteps; ++i) {
+    result.forwardCost += cost(i);
+    store(i + 1, false);
+  }
+
+  for (size_t i = numSteps; i + 1 > 0; --i) {
+    RecomputeEvent event{i, strategy.last_checkpoint_step(), 0, 0.0};
+    while (strategy.last_checkpoint_step() < i) {
+      size_t lastCp = strategy.last_checkpoint_step();
+      event.recomputations++;
+      event.cost += cost(lastCp);
+      store(lastCp + 1, false);
+      strategy.record_recomputation();
+    }
+    if (event.recomputations > 0) {
+      result.recomputeCost += event.cost;
+      result.timeline.push_back(event);
+    }
+
+    if (strategy.erase_step(i)) {
+      storedMemory -= stored[i];
+      stored.erase(i);
+    }
+  }
+
+  result.metrics = strategy.metrics();
+  return result;
+}
+
+std::vector<BudgetSweepPoint> sweep_checkpoint_budgets(size_t numSteps, const CheckpointStrategyFactory& factory,
+                                                       const std::vector<size_t>& budgets, const StepModel& stepCost,
+                                                       const StepModel& stepMemory)
+{
+  std::vector<BudgetSweepPoint> points;
+  for (size_t budget : budgets) {
+    auto strategy = factory(budget);
+    points.push_back({budget, simulate_checkpointing(numSteps, *strategy, stepCost, stepMemory)});
+  }
+  return points;
+}
+
+StepModel parse_step_model(const std::string& spec)
+{
+  auto colon = spec.find(':');
+  std::string kind = colon == std::string::npos ? "const" : spec.substr(0, colon);
+  std::string args = colon == std::string::npos ? spec : spec.substr(colon + 1);
+
+  try {
+    if (kind == "const") {
+      double value = std::stod(args);
+      return [value](size_t) { return value; };
+    }
+    if (kind == "linear") {
+      auto comma = args.find(',');
+      gretl_assert_msg(comma != std::string::npos, "linear step model expects linear:<a>,<b>, got " + spec);
+      double a = std::stod(args.substr(0, comma));
+      double b = std::stod(args.substr(comma + 1));
+      return [a, b](size_t n) { return a + b * static_cast<double>(n); };
+    }
+  } catch (const std::logic_error&) {
+    gretl_assert_msg(false, "could not parse step model " + spec);
+  }
+  if (kind == "file") {
+    std::ifstream file(args);
+    gretl_assert_msg(file.good(), "could not open step model file " + args);
+    std::vector<double> values;
+    double value;
+    while (file >> value) {
+      values.push_back(value);
+    }
+    gretl_assert_msg(!values.empty(), "step model file " + args + " has no values");
+    return [values](size_t n) { return values[std::min(n, values.size() - 1)]; };
+  }
+  gretl_assert_msg(false, "unknown step model " + spec + ", expected const:, linear: or file:");
+  return {};
+}
+
+}  // namespace gretl
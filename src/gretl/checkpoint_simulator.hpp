@@ -0,0 +1,73 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file checkpoint_simulator.hpp
+ * @brief Simulates a checkpoint strategy on a linear chain without any state data, to estimate recomputation cost
+ * and checkpoint memory ahead of a production run.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "checkpoint_strategy.hpp"
+#include "checkpoint_strategy_registry.hpp"
+
+namespace gretl {
+
+/// @brief cost (e.g. seconds) of advancing from step n to step n+1, or memory (e.g. bytes) held by the state at step n
+using StepModel = std::function<double(size_t n)>;
+
+/// @brief recomputations needed before the reverse sweep could process a step
+struct RecomputeEvent {
+  size_t step;            ///< step being reversed
+  size_t fromStep;        ///< checkpoint the recomputation restarted from
+  size_t recomputations;  ///< number of forward steps recomputed
+  double cost;            ///< cost of the recomputed steps
+};
+
+/// @brief result of simulating one forward and reverse sweep
+struct SimulationResult {
+  CheckpointMetrics metrics;             ///< strategy counters over the simulation
+  double forwardCost = 0.0;              ///< cost of the initial forward sweep
+  double recomputeCost = 0.0;            ///< cost of all forward recomputations during the reverse sweep
+  double peakMemory = 0.0;               ///< peak memory held by checkpoints, including a state being computed
+  size_t peakCheckpoints = 0;            ///< peak number of checkpoints, including a state being computed
+  std::vector<RecomputeEvent> timeline;  ///< recomputations in reverse sweep order, only steps which needed any
+
+  /// @brief total forward work relative to a run which stores every step
+  double cost_ratio() const { return forwardCost > 0.0 ? (forwardCost + recomputeCost) / forwardCost : 1.0; }
+};
+
+/// @brief a single point of a budget sweep
+struct BudgetSweepPoint {
+  size_t budget;            ///< number of non-persistent checkpoints
+  SimulationResult result;  ///< simulation at this budget
+};
+
+/// @brief Simulate the checkpointed forward and reverse sweeps of a linear chain, driving the strategy exactly as
+/// advance_and_reverse_steps does.
+/// @param numSteps number of forward iterations
+/// @param strategy checkpoint strategy to simulate
+/// @param stepCost cost model, defaults to unit cost per step
+/// @param stepMemory memory model, defaults to unit memory per state
+SimulationResult simulate_checkpointing(size_t numSteps, CheckpointStrategy& strategy, const StepModel& stepCost = {},
+                                        const StepModel& stepMemory = {});
+
+/// @brief Simulate a range of budgets, e.g. to choose the smallest budget meeting a recomputation cost target.
+std::vector<BudgetSweepPoint> sweep_checkpoint_budgets(size_t numSteps, const CheckpointStrategyFactory& factory,
+                                                       const std::vector<size_t>& budgets,
+                                                       const StepModel& stepCost = {},
+                                                       const StepModel& stepMemory = {});
+
+/// @brief Parse a step model specification: "const:<v>", "linear:<a>,<b>" (a + b n), or "file:<path>" with one value
+/// per step (whitespace separated, the last value repeats for later steps).  A plain number is a constant.
+StepModel parse_step_model(const std::string& spec);
+
+}  // namespace gretl
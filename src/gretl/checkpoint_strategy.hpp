@@ -12,9 +12,11 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <ostream>
+#include <vector>
 
 namespace gretl {
 
@@ -25,6 +27,11 @@ struct CheckpointMetrics {
   size_t recomputations = 0;  ///< Forward re-evaluations triggered during reverse
 };
 
+/// @brief Oracle provided by the DataStore: the number of bytes evicting a step would actually release right now.  0
+/// means the step's memory is still pinned, e.g. by later steps which need it or by handles held outside the graph,
+/// so evicting it would only cost a future recomputation.
+using EvictionOracle = std::function<size_t(size_t step)>;
+
 /// @brief Abstract interface for checkpoint eviction strategies.
 ///
 /// Implementations decide which step to evict when checkpoint capacity is
@@ -62,6 +69,29 @@ class CheckpointStrategy {
   /// @brief Return the maximum number of non-persistent checkpoint slots.
   virtual size_t capacity() const = 0;
 
+  /// @brief Change the number of non-persistent checkpoint slots, e.g. in response to memory pressure.  Growing only
+  /// raises the limit.  Shrinking below the number of checkpoints held evicts the surplus right away, choosing each by
+  /// the strategy's own eviction rule; persistent checkpoints are never evicted.
+  /// Strategies which do not support it keep their capacity by default.
+  /// @param maxStates The new number of non-persistent slots, as passed to the constructor.
+  /// @return The steps evicted, which the caller must release.
+  virtual std::vector<size_t> set_capacity(size_t /*maxStates*/) { return {}; }
+
+  /// @brief Query if the strategy supports renumber_steps and make_persistent, which the sliding window of a DataStore
+  /// needs (see DataStore::set_window).  False by default.
+  virtual bool supports_renumbering() const { return false; }
+
+  /// @brief Renumber the steps of the checkpoints held, after the DataStore removed steps from the front of its graph.
+  /// Checkpoints whose new step is invalidCheckpointIndex are dropped, persistent ones included, and the others keep
+  /// their order, priority and persistence.  Only called if supports_renumbering().
+  /// @param newSteps new step of each old step, indexed by old step
+  virtual void renumber_steps(const std::vector<size_t>& /*newSteps*/) {}
+
+  /// @brief Hold a step as a persistent checkpoint from now on, whether or not it is currently checkpointed.  As for
+  /// add_checkpoint_and_get_index_to_remove(step, true), the capacity grows by one and nothing is evicted.  Only
+  /// called if supports_renumbering().
+  virtual void make_persistent(size_t /*step*/) {}
+
   /// @brief Return the current number of checkpoints (persistent + non-persistent).
   virtual size_t size() const = 0;
 
@@ -76,6 +106,11 @@ class CheckpointStrategy {
 
   /// @brief Record a forward recomputation (called by DataStore during fetch).
   virtual void record_recomputation() = 0;
+
+  /// @brief Provide an oracle of the memory released by evicting a step.  Strategies supporting it prefer, among the
+  /// steps they consider dispensable, one whose eviction releases memory.  Passing an empty oracle turns this off.
+  /// Ignored by default.
+  virtual void set_eviction_oracle(EvictionOracle /*oracle*/) {}
 };
 
 /// @brief ostream operator for CheckpointStrategy
@@ -0,0 +1,96 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "checkpoint_strategy_registry.hpp"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include "adaptive_checkpoint_strategy.hpp"
+#include "checkpoint.hpp"
+#include "replay_checkpoint_strategy.hpp"
+#include "strumm_walther_checkpoint_strategy.hpp"
+#include "wang_checkpoint_strategy.hpp"
+
+namespace gretl {
+
+namespace {
+
+std::string normalized_name(const std::string& name)
+{
+  std::string lower = name;
+  std::transform(lower.begin(), lower.end(), lower.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return lower;
+}
+
+/// the built-in strategies are registered here rather than by static registration objects, which a linker may drop
+/// from a static library
+std::map<std::string, CheckpointStrategyFactory>& registry()
+{
+  static std::map<std::string, CheckpointStrategyFactory> factories = {
+      {"adaptive", [](size_t budget) { return std::make_unique<AdaptiveCheckpointStrategy>(budget); }},
+      {"wang", [](size_t budget) { return std::make_unique<WangCheckpointStrategy>(budget); }},
+      {"strumm_walther", [](size_t budget) { return std::make_unique<StrummWaltherCheckpointStrategy>(budget); }}};
+  return factories;
+}
+
+/// constant initialized, since strategies may be registered before dynamic initialization of this file
+constexpr char replayPrefix[] = "replay:";
+constexpr size_t replayPrefixLength = sizeof(replayPrefix) - 1;
+
+bool is_replay_name(const std::string& key) { return key.compare(0, replayPrefixLength, replayPrefix) == 0; }
+
+}  // namespace
+
+void register_checkpoint_strategy(const std::string& name, CheckpointStrategyFactory factory)
+{
+  std::string key = normalized_name(name);
+  gretl_assert_msg(!key.empty() && !is_replay_name(key),
+                   "invalid checkpoint strategy name '" + name + "'");
+  gretl_assert_msg(factory, "no factory given for checkpoint strategy '" + name + "'");
+  registry()[key] = std::move(factory);
+}
+
+std::unique_ptr<CheckpointStrategy> make_checkpoint_strategy(const std::string& name, size_t budget)
+{
+  std::string key = normalized_name(name);
+  if (is_replay_name(key)) {
+    auto strategy = make_checkpoint_strategy(name.substr(replayPrefixLength), budget);
+    return std::make_unique<ReplayCheckpointStrategy>(std::move(strategy));
+  }
+
+  auto factory = registry().find(key);
+  if (factory == registry().end()) {
+    std::string known;
+    for (const auto& registered : registered_checkpoint_strategies()) {
+      known += (known.empty() ? "" : ", ") + registered;
+    }
+    gretl_assert_msg(false, "unknown checkpoint strategy '" + name + "', registered strategies are: " + known);
+  }
+  auto strategy = factory->second(budget);
+  gretl_assert_msg(strategy, "factory for checkpoint strategy '" + name + "' returned null");
+  return strategy;
+}
+
+bool is_checkpoint_strategy_registered(const std::string& name)
+{
+  std::string key = normalized_name(name);
+  if (is_replay_name(key)) {
+    return is_checkpoint_strategy_registered(key.substr(replayPrefixLength));
+  }
+  return registry().count(key) > 0;
+}
+
+std::vector<std::string> registered_checkpoint_strategies()
+{
+  std::vector<std::string> names;
+  for (const auto& entry : registry()) {
+    names.push_back(entry.first);
+  }
+  return names;
+}
+
+}  // namespace gretl
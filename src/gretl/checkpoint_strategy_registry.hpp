@@ -0,0 +1,61 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file checkpoint_strategy_registry.hpp
+ * @brief Runtime selection of checkpoint strategies by name.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "checkpoint_strategy.hpp"
+
+namespace gretl {
+
+/// @brief creates a checkpoint strategy for a given budget of non-persistent checkpoints
+using CheckpointStrategyFactory = std::function<std::unique_ptr<CheckpointStrategy>(size_t budget)>;
+
+/// @brief Register a checkpoint strategy factory under a name.  Names are case insensitive, and registering an
+/// existing name replaces its factory.  The built-in strategies are registered as "wang", "strumm_walther" and
+/// "adaptive".
+void register_checkpoint_strategy(const std::string& name, CheckpointStrategyFactory factory);
+
+/// @brief Create a registered checkpoint strategy by name, e.g. make_checkpoint_strategy("wang", 20).  A name of the
+/// form "replay:<name>" wraps the named strategy in a ReplayCheckpointStrategy.  Throws for unknown names.
+std::unique_ptr<CheckpointStrategy> make_checkpoint_strategy(const std::string& name, size_t budget);
+
+/// @brief Check if a strategy name is registered.
+bool is_checkpoint_strategy_registered(const std::string& name);
+
+/// @brief Names of all registered strategies, sorted.
+std::vector<std::string> registered_checkpoint_strategies();
+
+/// @brief Registers a strategy during static initialization, see GRETL_REGISTER_CHECKPOINT_STRATEGY.
+struct CheckpointStrategyRegistration {
+  /// @brief Constructor
+  CheckpointStrategyRegistration(const std::string& name, CheckpointStrategyFactory factory)
+  {
+    register_checkpoint_strategy(name, std::move(factory));
+  }
+};
+
+}  // namespace gretl
+
+#define GRETL_REGISTRATION_CONCAT_IMPL_(a, b) a##b
+#define GRETL_REGISTRATION_CONCAT_(a, b) GRETL_REGISTRATION_CONCAT_IMPL_(a, b)
+
+/// @brief Self-register a CheckpointStrategy type, constructible from a size_t budget, under a name.  Use at namespace
+/// scope in a source file which is linked into the executable, e.g.
+/// GRETL_REGISTER_CHECKPOINT_STRATEGY("my_strategy", MyStrategy);
+#define GRETL_REGISTER_CHECKPOINT_STRATEGY(name, StrategyType)                                        \
+  static const ::gretl::CheckpointStrategyRegistration GRETL_REGISTRATION_CONCAT_(                      \
+      gretlCheckpointStrategyRegistration_, __LINE__)(name, [](size_t budget) {                          \
+    return std::unique_ptr<::gretl::CheckpointStrategy>(std::make_unique<StrategyType>(budget));       \
+  })
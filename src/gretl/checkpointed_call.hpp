@@ -0,0 +1,231 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file checkpointed_call.hpp
+ * @brief Collapsing a function of states into a single step of the graph, taped on a nested DataStore only when it is
+ * differentiated.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "state.hpp"
+
+namespace gretl {
+
+/// @brief Implementation of checkpointed_call: the function and the dual initializers of its inputs, shared by the
+/// eval, vjp, jvp and hvp of the step
+/// @tparam F function taking the input states, returning the output state
+/// @tparam Output output state type
+/// @tparam ...Inputs input state types
+template <typename F, typename Output, typename... Inputs>
+class CheckpointedCall {
+ public:
+  using T = typename Output::type;       ///< primal type of the output
+  using D = typename Output::dual_type;  ///< dual type of the output
+
+  /// @brief Constructor
+  /// @param f function
+  /// @param budget checkpoint budget of the nested DataStores taping f
+  /// @param outputZeroDual dual initializer of the output, learned from the first call to f if empty
+  /// @param inputs input states, only their dual initializers are kept
+  CheckpointedCall(F f, size_t budget, InitializeZeroDual<T, D> outputZeroDual, const Inputs&... inputs)
+      : f_(std::move(f)),
+        budget_(budget),
+        zeroDuals_(inputs.initialize_zero_dual()...),
+        outputZeroDual_(std::move(outputZeroDual))
+  {
+  }
+
+  /// @brief zero initialized dual of the output, once f has been called or if it was given
+  D output_zero_dual(const T& t) const
+  {
+    gretl_assert_msg(outputZeroDual_, "the output of a checkpointed_call was never evaluated");
+    return outputZeroDual_(t);
+  }
+
+  /// @brief keep the dual initializer of an output of f
+  void learn_output(const Output& output) const
+  {
+    if (!outputZeroDual_) {
+      outputZeroDual_ = output.initialize_zero_dual();
+    }
+  }
+
+  /// @brief evaluate f on a streaming DataStore, which records nothing
+  void eval(const UpstreamStates& upstreams, DownstreamState& downstream) const
+  {
+    DataStore nested(1);
+    nested.set_streaming(true);
+    auto [inputs, output] = call(nested, upstreams, false, std::index_sequence_for<Inputs...>());
+    downstream.set<T, D>(output.get());
+  }
+
+  /// @brief tape f on a nested DataStore and back propagate through it
+  void vjp(UpstreamStates& upstreams, const DownstreamState& downstream) const
+  {
+    DataStore nested(budget_);
+    auto [inputs, output] = call(nested, upstreams, false, std::index_sequence_for<Inputs...>());
+    seed_input_duals(upstreams, inputs, std::index_sequence_for<Inputs...>());
+    output.set_dual(downstream.get_dual<D, T>());
+    nested.back_prop();
+    gather_input_duals(upstreams, inputs, std::index_sequence_for<Inputs...>());
+  }
+
+  /// @brief evaluate f on a nested DataStore with the upstream tangents as the tangents of its inputs
+  void jvp(const UpstreamStates& upstreams, DownstreamState& downstream) const
+  {
+    DataStore nested(budget_);
+    auto [inputs, output] = call(nested, upstreams, true, std::index_sequence_for<Inputs...>());
+    downstream.set_tangent(D(output.get_tangent()));
+  }
+
+  /// @brief tape f with tangents on a nested DataStore and back propagate the dual tangents through it
+  void hvp(UpstreamStates& upstreams, const DownstreamState& downstream) const
+  {
+    DataStore nested(budget_);
+    auto [inputs, output] = call(nested, upstreams, true, std::index_sequence_for<Inputs...>());
+    seed_input_dual_tangents(upstreams, inputs, std::index_sequence_for<Inputs...>());
+    output.set_dual(downstream.get_dual<D, T>());
+    nested.get_dual_tangent<D, T>(output.step()) = downstream.get_dual_tangent<D, T>();
+    nested.back_prop_hvp();
+    gather_input_dual_tangents(upstreams, inputs, std::index_sequence_for<Inputs...>());
+  }
+
+ private:
+  /// @brief copy the upstreams onto a nested DataStore as persistent states, and call f on them
+  template <size_t... I>
+  std::pair<std::tuple<Inputs...>, Output> call(DataStore& nested, const UpstreamStates& upstreams, bool tangents,
+                                                std::index_sequence<I...>) const
+  {
+    std::tuple<Inputs...> inputs{nested.create_state<typename Inputs::type, typename Inputs::dual_type>(
+        upstreams[I].template get<typename Inputs::type>(), std::get<I>(zeroDuals_))...};
+    if (tangents) {
+      (std::get<I>(inputs).set_tangent(
+           upstreams[I].template get_tangent<typename Inputs::dual_type, typename Inputs::type>()),
+       ...);
+    }
+    Output output = std::apply(f_, inputs);
+    learn_output(output);
+    // streamed steps forget their upstreams once evaluated, so this is only checked when taping
+    gretl_assert_msg(nested.streaming() || !nested.is_persistent(output.step()),
+                     "the function of a checkpointed_call must return a new state computed from its inputs");
+    return {std::move(inputs), std::move(output)};
+  }
+
+  /// @brief start the nested back propagation from the duals accumulated so far, avoiding a generic plus-equals
+  template <size_t... I>
+  static void seed_input_duals(UpstreamStates& upstreams, std::tuple<Inputs...>& inputs, std::index_sequence<I...>)
+  {
+    (std::get<I>(inputs).set_dual(upstreams[I].template get_dual<typename Inputs::dual_type, typename Inputs::type>()),
+     ...);
+  }
+
+  /// @brief copy the duals of the nested inputs back to the upstreams
+  template <size_t... I>
+  static void gather_input_duals(UpstreamStates& upstreams, std::tuple<Inputs...>& inputs, std::index_sequence<I...>)
+  {
+    ((upstreams[I].template get_dual<typename Inputs::dual_type, typename Inputs::type>() =
+          std::get<I>(inputs).get_dual()),
+     ...);
+  }
+
+  /// @brief as seed_input_duals, for the dual tangents
+  template <size_t... I>
+  static void seed_input_dual_tangents(UpstreamStates& upstreams, std::tuple<Inputs...>& inputs,
+                                       std::index_sequence<I...>)
+  {
+    ((std::get<I>(inputs).data_store().template get_dual_tangent<typename Inputs::dual_type, typename Inputs::type>(
+          std::get<I>(inputs).step()) =
+          upstreams[I].template get_dual_tangent<typename Inputs::dual_type, typename Inputs::type>()),
+     ...);
+  }
+
+  /// @brief as gather_input_duals, for the dual tangents
+  template <size_t... I>
+  static void gather_input_dual_tangents(UpstreamStates& upstreams, std::tuple<Inputs...>& inputs,
+                                         std::index_sequence<I...>)
+  {
+    ((upstreams[I].template get_dual_tangent<typename Inputs::dual_type, typename Inputs::type>() =
+          std::get<I>(inputs).get_dual_tangent()),
+     ...);
+  }
+
+  F f_;            ///< function
+  size_t budget_;  ///< checkpoint budget of the nested DataStores
+  std::tuple<InitializeZeroDual<typename Inputs::type, typename Inputs::dual_type>...>
+      zeroDuals_;                                     ///< dual initializers of the inputs
+  mutable InitializeZeroDual<T, D> outputZeroDual_;  ///< dual initializer of the output, set when f is first called
+};
+
+/// @brief Implementation of both forms of checkpointed_call
+template <typename F, typename Output, typename... Inputs>
+Output make_checkpointed_call(F f, InitializeZeroDual<typename Output::type, typename Output::dual_type> outputZeroDual,
+                              const Inputs&... inputs)
+{
+  using T = typename Output::type;
+  using D = typename Output::dual_type;
+  static_assert(sizeof...(Inputs) > 0, "checkpointed_call requires at least one input state");
+
+  std::vector<StateBase> upstreams{inputs...};
+  for (size_t i = 0; i < upstreams.size(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      gretl_assert_msg(upstreams[i].step() != upstreams[j].step(),
+                       "each input of a checkpointed_call must be a distinct state");
+    }
+  }
+  DataStore& dataStore = upstreams[0].data_store();
+  // the step is not evaluated while restoring, which is where the dual initializer of the output is otherwise learned
+  gretl_assert_msg(outputZeroDual || !dataStore.restoring(),
+                   "a checkpointed_call restored from a checkpoint file needs the dual initializer of its output");
+
+  size_t budget = std::max<size_t>(1, dataStore.checkpoint_capacity());
+  auto impl =
+      std::make_shared<const CheckpointedCall<F, Output, Inputs...>>(std::move(f), budget, outputZeroDual, inputs...);
+  InitializeZeroDual<T, D> zeroDual = [impl](const T& t) { return impl->output_zero_dual(t); };
+  auto output = upstreams[0].create_state<T, D>(upstreams, zeroDual);
+  output.set_eval([impl](const UpstreamStates& u, DownstreamState& d) { impl->eval(u, d); });
+  output.set_vjp([impl](UpstreamStates& u, const DownstreamState& d) { impl->vjp(u, d); });
+  output.set_jvp([impl](const UpstreamStates& u, DownstreamState& d) { impl->jvp(u, d); });
+  output.set_hvp([impl](UpstreamStates& u, const DownstreamState& d) { impl->hvp(u, d); });
+  return output.finalize();
+}
+
+/// @brief Call a function of states as a single step of the graph, e.g. a whole time step of an integrator producing
+/// many intermediate states.  Only the inputs and the output are recorded in the graph.  f is evaluated on a nested,
+/// streaming DataStore which records nothing, and when back propagating through the step it is called again on a
+/// nested DataStore which tapes it, with the same checkpoint budget as the graph, and back propagated there.  Tangents
+/// and Hessian-vector products are propagated the same way.  f must not read states other than its arguments, and
+/// each input must be a distinct state (f may use an argument several times).  The dual initializer of the output is
+/// learned from the first evaluation of f, so a graph restored from a checkpoint file, whose steps are not evaluated,
+/// must pass it instead (see the overload below).
+/// @param f function taking the input states (as const references or by value), returning a new state
+/// @param inputs input states of the same DataStore
+template <typename F, typename... Inputs>
+auto checkpointed_call(F f, const Inputs&... inputs) -> decltype(f(inputs...))
+{
+  using Output = decltype(f(inputs...));
+  return make_checkpointed_call<F, Output>(std::move(f), {}, inputs...);
+}
+
+/// @brief checkpointed_call given the dual initializer of the output, which f is then never evaluated to learn
+/// @param f function taking the input states (as const references or by value), returning a new state
+/// @param outputZeroDual dual initializer of the output, as passed to create_state
+/// @param inputs input states of the same DataStore
+template <typename F, typename... Inputs, typename Output = std::invoke_result_t<F&, const Inputs&...>>
+Output checkpointed_call(F f, InitializeZeroDual<typename Output::type, typename Output::dual_type> outputZeroDual,
+                         const Inputs&... inputs)
+{
+  return make_checkpointed_call<F, Output>(std::move(f), std::move(outputZeroDual), inputs...);
+}
+
+}  // namespace gretl
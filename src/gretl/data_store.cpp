@@ -6,10 +6,13 @@
 
 #include <any>
 #include "data_store.hpp"
+#include "checkpoint_file.hpp"
+#include "memory_monitor.hpp"
 #include "state.hpp"
 #include "wang_checkpoint_strategy.hpp"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 namespace gretl {
 
@@ -24,6 +27,10 @@ DataStore::DataStore(std::unique_ptr<CheckpointStrategy> strategy) : checkpointS
 
 void DataStore::back_prop()
 {
+  gretl_assert_msg(!streaming_, "streaming must be turned off before back propagating");
+  if (window_ > 0 && currentStep_ == size() && size() > window_) {
+    retire_steps_before(size() - window_);
+  }
   stillConstructingGraph_ = false;
   currentStep_ = static_cast<Int>(states_.size());
   for (size_t n = states_.size(); n > 0; --n) {
@@ -31,12 +38,24 @@ void DataStore::back_prop()
   }
 }
 
+void DataStore::back_prop_hvp()
+{
+  gretl_assert_msg(tangents_enabled_, "hessian-vector products require seeded tangents, see forward_tangent");
+  secondOrderSweep_ = true;
+  back_prop();
+  secondOrderSweep_ = false;
+}
+
+/// calls func for each step an active step keeps in memory: its non-persistent upstreams, unless only checkpointing
+/// live cuts, and the earlier steps passing through it
 template <typename Func>
 void for_each_active_upstream(const DataStore* dataStore, size_t step, const Func& func)
 {
-  for (Int upstreamStep : dataStore->upstreamSteps_[step]) {
-    if (!dataStore->is_persistent(upstreamStep)) {
-      func(upstreamStep);
+  if (!dataStore->live_cut_checkpoints()) {
+    for (Int upstreamStep : dataStore->upstreamSteps_[step]) {
+      if (!dataStore->is_persistent(upstreamStep)) {
+        func(upstreamStep);
+      }
     }
   }
   for (Int upstreamStepPassingThrough : dataStore->passthroughs_[step]) {
@@ -47,6 +66,7 @@ void for_each_active_upstream(const DataStore* dataStore, size_t step, const Fun
 void DataStore::clear_usage(Int step)
 {
   states_[step]->primal() = nullptr;
+  tangents_[step] = nullptr;
   active_[step] = false;
   usageCount_[step] = 0;
   try_to_free(step);
@@ -72,6 +92,10 @@ void DataStore::reset()
       num_persistent++;
     }
     duals_[stepToClear] = nullptr;
+    dualTangents_[stepToClear] = nullptr;
+    for (auto& seedDuals : seedDuals_) {
+      seedDuals[stepToClear] = nullptr;
+    }
   }
   checkpointStrategy_->reset();
   currentStep_ = num_persistent;
@@ -86,6 +110,10 @@ void DataStore::reset_graph()
       num_persistent++;
     }
     duals_[stepToClear] = nullptr;
+    dualTangents_[stepToClear] = nullptr;
+    for (auto& seedDuals : seedDuals_) {
+      seedDuals[stepToClear] = nullptr;
+    }
   }
   // Restore currentStep_ before resize, since back_prop() decrements it to 0
   // but resize() asserts newSize <= currentStep_.
@@ -93,6 +121,7 @@ void DataStore::reset_graph()
   resize(num_persistent);
   checkpointStrategy_->reset();
   stillConstructingGraph_ = true;
+  restoreFile_ = nullptr;
 }
 
 ///@ brief deallocate back down to a new, smaller, size
@@ -106,11 +135,19 @@ void DataStore::resize(Int newSize)
   upstreamSteps_.resize(newSize);
   evals_.resize(newSize);
   vjps_.resize(newSize);
+  jvps_.resize(newSize);
+  tangents_.resize(newSize);
+  hvps_.resize(newSize);
+  dualTangents_.resize(newSize);
+  for (auto& seedDuals : seedDuals_) {
+    seedDuals.resize(newSize);
+  }
   requires_vjp_.resize(newSize);
   active_.resize(newSize);
   usageCount_.resize(newSize);
   lastStepUsed_.resize(newSize);
   passthroughs_.resize(newSize);
+  evaluatedPrimalBytes_.resize(newSize);
   currentStep_ = newSize;
 }
 
@@ -121,12 +158,132 @@ void DataStore::reset_for_backprop()
   for (auto& dual : duals_) {
     dual = nullptr;
   }
+  for (auto& dualTangent : dualTangents_) {
+    dualTangent = nullptr;
+  }
+  for (auto& seedDuals : seedDuals_) {
+    for (auto& dual : seedDuals) {
+      dual = nullptr;
+    }
+  }
+}
+
+void DataStore::set_num_dual_seeds(size_t numSeeds)
+{
+  gretl_assert_msg(numSeeds > 0, "at least one dual seed is required");
+  seedDuals_.resize(numSeeds - 1);
+  for (auto& seedDuals : seedDuals_) {
+    seedDuals.resize(states_.size());
+  }
+}
+
+void DataStore::swap_seed_duals(Int step, size_t seed)
+{
+  auto& seedDuals = seedDuals_[seed - 1];
+  std::swap(duals_[step], seedDuals[step]);
+  const auto& upstreams = upstreamSteps_[step];
+  for (auto u = upstreams.begin(); u != upstreams.end(); ++u) {
+    // an upstream may appear more than once (e.g., c = a + a), only swap it once
+    if (std::find(upstreams.begin(), u, *u) == u) {
+      std::swap(duals_[*u], seedDuals[*u]);
+    }
+  }
 }
 
 void DataStore::vjp(StateBase& state) { state.evaluate_vjp(); }
 
+void DataStore::jvp(StateBase& state) { state.evaluate_jvp(); }
+
+void DataStore::hvp(StateBase& state) { state.evaluate_hvp(); }
+
+void DataStore::forward_tangent()
+{
+  tangents_enabled_ = true;
+  stillConstructingGraph_ = false;
+  reset();
+  reset_for_backprop();
+}
+
+void DataStore::clear_tangents()
+{
+  for (auto& tangent : tangents_) {
+    tangent = nullptr;
+  }
+  tangents_enabled_ = false;
+}
+
 bool DataStore::is_persistent(Int step) const { return upstreamSteps_[step].empty(); }
 
+void DataStore::set_live_cut_checkpoints(bool enable)
+{
+  for (Int step = 0; step < states_.size(); ++step) {
+    gretl_assert_msg(!active_[step] || is_persistent(step),
+                     "live cut checkpointing can only be changed while no non-persistent step is stored, e.g. before "
+                     "the graph is built or after reset()");
+  }
+  liveCutCheckpoints_ = enable;
+}
+
+size_t DataStore::primal_bytes(Int step) const
+{
+  const auto& primal = states_[step]->primal();
+  if (!primal) {
+    return 0;
+  }
+  if (auto vector = std::any_cast<std::vector<double>>(primal.get())) {
+    return vector->size() * sizeof(double);
+  }
+  if (auto compressed = std::any_cast<CompressedPrimal>(primal.get())) {
+    return compressed->bytes.size();
+  }
+  if (std::any_cast<MappedPrimal>(primal.get())) {
+    // backed by the checkpoint file
+    return 0;
+  }
+  if (std::any_cast<double>(primal.get())) {
+    return sizeof(double);
+  }
+  // other types are only known to hold some memory
+  return 1;
+}
+
+size_t DataStore::freeable_bytes(Int step) const
+{
+  if (is_persistent(step) || !active_[step]) {
+    return 0;
+  }
+  size_t bytes = 0;
+  if (usageCount_[step] == 0 && states_[step]->wild_count() == 0) {
+    bytes += primal_bytes(step);
+  }
+  // an upstream is released if this step holds all of its uses, it can be held more than once (as an upstream and as
+  // a passthrough), so the uses are counted over runs of the sorted upstreams
+  auto& upstreams = freeableUpstreams_;
+  upstreams.clear();
+  for_each_active_upstream(this, step, [&](Int upstream) { upstreams.push_back(upstream); });
+  std::sort(upstreams.begin(), upstreams.end());
+  for (auto first = upstreams.begin(); first != upstreams.end();) {
+    Int upstream = *first;
+    auto last = std::find_if(first, upstreams.end(), [upstream](Int u) { return u != upstream; });
+    size_t uses = static_cast<size_t>(last - first);
+    if (!active_[upstream] && usageCount_[upstream] == uses && states_[upstream]->wild_count() == 0) {
+      bytes += primal_bytes(upstream);
+    }
+    first = last;
+  }
+  return bytes;
+}
+
+void DataStore::set_liveness_aware_eviction(bool enable)
+{
+  livenessAwareEviction_ = enable;
+  EvictionOracle oracle;
+  if (enable) {
+    oracle = [this](size_t step) { return freeable_bytes(static_cast<Int>(step)); };
+  }
+  checkpointStrategy_->set_eviction_oracle(std::move(oracle));
+}
+
 void DataStore::reverse_state()
 {
   // must erase the final step in the cp manager before we get started
@@ -134,9 +291,20 @@ void DataStore::reverse_state()
     checkpointStrategy_->erase_step(currentStep_ - 1);
   }
   --currentStep_;
+  if (memoryMonitor_) {
+    poll_memory_monitor();
+  }
   if (requires_vjp_[currentStep_] && !upstreamSteps_[currentStep_].empty()) {
     fetch_state_data(currentStep_ - 1);
     vjp(*states_[currentStep_]);
+    for (size_t seed = 1; seed < num_dual_seeds(); ++seed) {
+      swap_seed_duals(currentStep_, seed);
+      vjp(*states_[currentStep_]);
+      swap_seed_duals(currentStep_, seed);
+    }
+    if (secondOrderSweep_) {
+      hvp(*states_[currentStep_]);
+    }
     clear_usage(currentStep_);
     checkpointStrategy_->erase_step(currentStep_ - 1);
   } else if (!upstreamSteps_[currentStep_].empty()) {
@@ -147,6 +315,87 @@ void DataStore::reverse_state()
 
 std::shared_ptr<std::any>& DataStore::any_primal(Int step) { return states_[step]->primal(); }
 
+bool DataStore::compress_primal(Int step)
+{
+  auto& primal = any_primal(step);
+  const PrimalCodec* codec = checkpoint_codec(step);
+  if (!codec || is_persistent(step) || !primal || is_compressed(step) || states_[step]->data_.use_count() > 1) {
+    return false;
+  }
+  CompressedPrimal compressed;
+  if (!codec->compress(*primal, compressed)) {
+    return false;
+  }
+  compressionMetrics_.compressions++;
+  compressionMetrics_.rawBytes += compressed.rawBytes;
+  compressionMetrics_.compressedBytes += compressed.bytes.size();
+  *primal = std::move(compressed);
+  return true;
+}
+
+bool DataStore::decompress_primal(Int step)
+{
+  auto& primal = any_primal(step);
+  auto compressed = primal ? std::any_cast<CompressedPrimal>(primal.get()) : nullptr;
+  if (!compressed) {
+    return false;
+  }
+  const PrimalCodec* codec = checkpoint_codec(step);
+  gretl_assert_msg(codec, "compressed primal found without a checkpoint codec");
+  std::any value = codec->decompress(*compressed);
+  *primal = std::move(value);
+  compressionMetrics_.decompressions++;
+  return true;
+}
+
+bool DataStore::is_compressed(Int step) const
+{
+  const auto& primal = states_[step]->primal();
+  return primal && primal->type() == typeid(CompressedPrimal);
+}
+
+const PrimalCodec* DataStore::checkpoint_codec(Int step) const
+{
+  const auto& stateCodec = states_[step]->data_->checkpointCodec_;
+  return stateCodec ? stateCodec.get() : checkpointCodec_.get();
+}
+
+void DataStore::restore_from(std::shared_ptr<const CheckpointFile> file)
+{
+  gretl_assert_msg(states_.empty(), "a graph can only be restored into an empty DataStore");
+  restoreFile_ = std::move(file);
+}
+
+void DataStore::restore_step(Int step)
+{
+  if (restoreFile_->has_primal(step)) {
+    any_primal(step) = std::make_shared<std::any>(MappedPrimal{restoreFile_, step});
+  } else {
+    // not saved, so it must be recomputed if it is ever needed
+    any_primal(step) = nullptr;
+  }
+}
+
+bool DataStore::page_in_primal(Int step)
+{
+  auto& primal = any_primal(step);
+  auto mapped = primal ? std::any_cast<MappedPrimal>(primal.get()) : nullptr;
+  if (!mapped) {
+    return false;
+  }
+  std::any value = mapped->file->read_primal(mapped->step);
+  *primal = std::move(value);
+  return true;
+}
+
+void DataStore::set_checkpoint_compression(std::shared_ptr<const PrimalCodec> codec)
+{
+  for (Int step = 0; step < states_.size(); ++step) {
+    decompress_primal(step);
+  }
+  checkpointCodec_ = std::move(codec);
+}
+
 void printv(const std::vector<Int>& v)
 {
   size_t c = 0;
@@ -169,29 +418,55 @@ void printv(const std::vector<StateBase>& v)
 
 void DataStore::try_to_free(Int step)
 {
+  if (is_streamed(step)) {
+    // the step may already be released, when this is called from the destructor of its own copy
+    if (states_[step] && usageCount_[step] == 0 && states_[step]->data_.use_count() <= 1) {
+      release_streamed_step(step);
+    }
+    return;
+  }
   if (!is_persistent(step) && states_[step] && states_[step]->data_) {
     if (usageCount_[step] == 0 && !active_[step] && states_[step]->data_.use_count() <= 1) {
       states_[step]->primal() = nullptr;
       duals_[step] = nullptr;
+      tangents_[step] = nullptr;
+      dualTangents_[step] = nullptr;
+      for (auto& seedDuals : seedDuals_) {
+        seedDuals[step] = nullptr;
+      }
+    } else if (stillConstructingGraph_ && lastStepUsed_[step] != step) {
+      // the last external handle may just have been released, after every downstream step using it was evaluated
+      compress_primal(step);
     }
   }
 }
 
 void DataStore::add_state(std::unique_ptr<StateBase> newState, const std::vector<StateBase>& upstreams)
 {
+  if (streaming_) {
+    add_streamed_state(std::move(newState), upstreams);
+    return;
+  }
   Int step = newState->step();
 
   states_.emplace_back(std::move(newState));
   duals_.emplace_back(nullptr);
+  tangents_.emplace_back(nullptr);
+  dualTangents_.emplace_back(nullptr);
+  for (auto& seedDuals : seedDuals_) {
+    seedDuals.emplace_back(nullptr);
+  }
   usageCount_.push_back(0);
   active_.push_back(true);
   lastStepUsed_.push_back(step);
   passthroughs_.push_back({});
+  evaluatedPrimalBytes_.push_back(0);
   requires_vjp_.push_back(gradients_enabled());
 
   bool persistent = upstreams.size() == 0;
   if (persistent) {
     checkpointStrategy_->add_checkpoint_and_get_index_to_remove(step, persistent);
+    ++persistentCheckpoints_;
   }
 
   std::vector<Int> upstreamSteps;
@@ -202,18 +477,27 @@ void DataStore::add_state(std::unique_ptr<StateBase> newState, const std::vector
   }
   upstreamSteps_.emplace_back(std::move(upstreamSteps));
 
+  if (restoring()) {
+    const StateBase& state = *states_[step];
+    gretl_assert_msg(step < restoreFile_->num_steps() && restoreFile_->upstream_steps(step) == upstreamSteps_[step] &&
+                         restoreFile_->step_type(step) == typeid(state).name(),
+                     "the graph being restored does not match the checkpoint file at step " + std::to_string(step));
+  }
+
   for (auto& u : upstreams) {
     Int upstreamStep = u.step();
     if (!is_persistent(upstreamStep)) {
       // we are now using this upstream (again), add to count of uses
-      usageCount_[upstreamStep]++;
+      if (!liveCutCheckpoints_) {
+        usageCount_[upstreamStep]++;
+      }
 
       // check if step fully deleted,
       if (!states_[upstreamStep]->primal()) {
-        gretl_assert(usageCount_[upstreamStep] == 1);
+        gretl_check(usageCount_[upstreamStep] == (liveCutCheckpoints_ ? 0 : 1));
         states_[upstreamStep]->primal() = u.primal();
       } else {
-        gretl_assert(states_[upstreamStep]->primal() == u.primal());
+        gretl_check(states_[upstreamStep]->primal() == u.primal());
       }
 
       // knowing this upstream is used here, push the passthroughs forward from their last known use to the previous
@@ -240,18 +524,305 @@ void DataStore::add_state(std::unique_ptr<StateBase> newState, const std::vector
     gretl_assert(false);
   });
 
-  bool isGood = check_validity();
-  gretl_assert(isGood);
+  jvps_.emplace_back([step](const UpstreamStates&, DownstreamState&) {
+    std::cout << "jvp not implemented for step " << step << std::endl;
+    gretl_assert(false);
+  });
+
+  hvps_.emplace_back([step](UpstreamStates&, const DownstreamState&) {
+    std::cout << "hvp not implemented for step " << step << std::endl;
+    gretl_assert(false);
+  });
+
+  gretl_check_full(check_validity());
 
   ++currentStep_;
-  gretl_assert(currentStep_ == states_.size());
-  gretl_assert(currentStep_ == duals_.size());
-  gretl_assert(currentStep_ == upstreamSteps_.size());
-  gretl_assert(currentStep_ == passthroughs_.size());
-  gretl_assert(currentStep_ == active_.size());
-  gretl_assert(currentStep_ == usageCount_.size());
-  gretl_assert(currentStep_ == vjps_.size());
-  gretl_assert(currentStep_ == lastStepUsed_.size());
+  gretl_check(currentStep_ == states_.size());
+  gretl_check(currentStep_ == duals_.size());
+  gretl_check(currentStep_ == upstreamSteps_.size());
+  gretl_check(currentStep_ == passthroughs_.size());
+  gretl_check(currentStep_ == active_.size());
+  gretl_check(currentStep_ == usageCount_.size());
+  gretl_check(currentStep_ == vjps_.size());
+  gretl_check(currentStep_ == jvps_.size());
+  gretl_check(currentStep_ == tangents_.size());
+  gretl_check(currentStep_ == hvps_.size());
+  gretl_check(currentStep_ == dualTangents_.size());
+  gretl_check(currentStep_ == lastStepUsed_.size());
+  gretl_check(currentStep_ == evaluatedPrimalBytes_.size());
+}
+
+void DataStore::add_streamed_state(std::unique_ptr<StateBase> newState, const std::vector<StateBase>& upstreams)
+{
+  Int step = newState->step();
+  if (step == states_.size()) {
+    states_.emplace_back();
+    duals_.emplace_back();
+    tangents_.emplace_back();
+    dualTangents_.emplace_back();
+    for (auto& seedDuals : seedDuals_) {
+      seedDuals.emplace_back();
+    }
+    usageCount_.push_back(0);
+    active_.push_back(true);
+    lastStepUsed_.push_back(step);
+    passthroughs_.emplace_back();
+    evaluatedPrimalBytes_.push_back(0);
+    requires_vjp_.push_back(false);
+    upstreamSteps_.emplace_back();
+    evals_.emplace_back();
+    vjps_.emplace_back();
+    jvps_.emplace_back();
+    hvps_.emplace_back();
+  } else {
+    gretl_check(!freeSteps_.empty() && freeSteps_.back() == step);
+    freeSteps_.pop_back();
+  }
+  states_[step] = std::move(newState);
+
+  for (auto& u : upstreams) {
+    Int upstreamStep = u.step();
+    upstreamSteps_[step].push_back(upstreamStep);
+    if (is_streamed(upstreamStep)) {
+      // held until this step is evaluated
+      usageCount_[upstreamStep]++;
+    }
+  }
+
+  evals_[step] = [step](const UpstreamStates&, DownstreamState&) {
+    std::cout << "eval not implemented for step " << step << std::endl;
+    gretl_assert(false);
+  };
+  vjps_[step] = [](UpstreamStates&, const DownstreamState&) {};
+  jvps_[step] = [](const UpstreamStates&, DownstreamState&) {};
+  hvps_[step] = [](UpstreamStates&, const DownstreamState&) {};
+
+  currentStep_ = size();
+}
+
+void DataStore::release_streamed_step(Int step)
+{
+  std::vector<Int> upstreamSteps = std::move(upstreamSteps_[step]);
+  upstreamSteps_[step].clear();
+  duals_[step] = nullptr;
+  tangents_[step] = nullptr;
+  dualTangents_[step] = nullptr;
+  for (auto& seedDuals : seedDuals_) {
+    seedDuals[step] = nullptr;
+  }
+  evals_[step] = nullptr;
+  vjps_[step] = nullptr;
+  jvps_[step] = nullptr;
+  hvps_[step] = nullptr;
+  freeSteps_.push_back(step);
+  // the destructor of the stored copy calls try_to_free again, after the step is emptied
+  states_[step] = nullptr;
+
+  // a step released before it was evaluated still held its upstreams
+  for (Int upstream : upstreamSteps) {
+    if (is_streamed(upstream)) {
+      usageCount_[upstream]--;
+      try_to_free(upstream);
+    }
+  }
+}
+
+void DataStore::set_streaming(bool enable)
+{
+  if (enable == streaming_) {
+    return;
+  }
+  gretl_assert_msg(stillConstructingGraph_ && !restoring(), "streaming can only be changed while building a graph");
+  if (enable) {
+    streamingBegin_ = size();
+    streaming_ = true;
+    return;
+  }
+
+  for (Int step = streamingBegin_; step < size(); ++step) {
+    gretl_assert_msg(!states_[step] || is_persistent(step), "a state created while streaming was never evaluated");
+  }
+
+  // move the streamed states still referenced to the front of the released steps, keeping them as persistent states
+  Int newSize = streamingBegin_;
+  for (Int step = streamingBegin_; step < size(); ++step) {
+    if (!states_[step]) {
+      continue;
+    }
+    if (step != newSize) {
+      states_[newSize] = std::move(states_[step]);
+      states_[newSize]->reset_step(newSize);
+      duals_[newSize] = std::move(duals_[step]);
+      tangents_[newSize] = std::move(tangents_[step]);
+      dualTangents_[newSize] = std::move(dualTangents_[step]);
+      for (auto& seedDuals : seedDuals_) {
+        seedDuals[newSize] = std::move(seedDuals[step]);
+      }
+      evals_[newSize] = std::move(evals_[step]);
+      vjps_[newSize] = std::move(vjps_[step]);
+      jvps_[newSize] = std::move(jvps_[step]);
+      hvps_[newSize] = std::move(hvps_[step]);
+      evaluatedPrimalBytes_[newSize] = evaluatedPrimalBytes_[step];
+    }
+    usageCount_[newSize] = 0;
+    active_[newSize] = true;
+    lastStepUsed_[newSize] = newSize;
+    ++newSize;
+  }
+  streaming_ = false;
+  freeSteps_.clear();
+  currentStep_ = size();
+  resize(newSize);
+  for (Int step = streamingBegin_; step < newSize; ++step) {
+    checkpointStrategy_->add_checkpoint_and_get_index_to_remove(step, true);
+    ++persistentCheckpoints_;
+  }
+}
+
+void DataStore::set_window(Int numSteps)
+{
+  gretl_assert_msg(numSteps == 0 || checkpointStrategy_->supports_renumbering(),
+                   "a sliding window requires a checkpoint strategy supporting renumbering");
+  window_ = numSteps;
+}
+
+void DataStore::retire_steps_before(Int boundary)
+{
+  gretl_assert_msg(!streaming_ && !restoring(), "steps cannot be retired while streaming or restoring a graph");
+  gretl_assert_msg(currentStep_ == size() && boundary <= size(),
+                   "steps can only be retired from a graph which is not being back propagated");
+  gretl_assert_msg(checkpointStrategy_->supports_renumbering(),
+                   "retiring steps requires a checkpoint strategy supporting renumbering");
+
+  // steps before the boundary are kept if later steps use them, or handles outside the graph reference them
+  std::vector<bool> kept(boundary, false);
+  for (Int step = boundary; step < size(); ++step) {
+    for (Int upstream : upstreamSteps_[step]) {
+      if (upstream < boundary) {
+        kept[upstream] = true;
+      }
+    }
+  }
+  bool retiring = false;
+  for (Int step = 0; step < boundary; ++step) {
+    kept[step] = kept[step] || states_[step]->wild_count() > 0;
+    retiring = retiring || !kept[step];
+  }
+  if (!retiring) {
+    return;
+  }
+
+  // the kept steps become persistent, so their primals must be in memory.  A freed one is evaluated again from the
+  // closest checkpoint before it, which keeps every earlier step used after it in memory.  Every step evaluated here
+  // ends up persistent or retired, so none of them is handed to the checkpoint strategy.
+  for (Int step = 0; step < boundary; ++step) {
+    if (!kept[step] || states_[step]->primal()) {
+      continue;
+    }
+    Int checkpoint = step;
+    while (!active_[checkpoint] && !is_persistent(checkpoint)) {
+      --checkpoint;
+    }
+    for (Int i = checkpoint + 1; i <= step; ++i) {
+      if (!states_[i]->primal()) {
+        states_[i]->primal() = std::make_shared<std::any>();
+        states_[i]->evaluate_primal();
+      }
+    }
+  }
+
+  std::vector<size_t> newSteps(size(), CheckpointStrategy::invalidCheckpointIndex);
+  std::vector<bool> promoted(boundary, false);
+  Int newSize = 0;
+  for (Int step = 0; step < size(); ++step) {
+    if (step >= boundary || kept[step]) {
+      newSteps[step] = newSize++;
+    }
+    if (step < boundary) {
+      promoted[step] = kept[step] && !is_persistent(step);
+    }
+  }
+  checkpointStrategy_->renumber_steps(newSteps);
+
+  // move the kept steps to the front, as when streaming is turned off
+  std::vector<std::unique_ptr<StateBase>> retired;
+  for (Int step = 0; step < newSteps.size(); ++step) {
+    if (!CheckpointStrategy::valid_checkpoint_index(newSteps[step])) {
+      // no handle references it, and its destructor must not reach back into the renumbered graph
+      states_[step]->data_->lifetimeToken_.reset();
+      retired.push_back(std::move(states_[step]));
+      continue;
+    }
+    Int newStep = static_cast<Int>(newSteps[step]);
+    if (newStep != step) {
+      states_[newStep] = std::move(states_[step]);
+      states_[newStep]->reset_step(newStep);
+      duals_[newStep] = std::move(duals_[step]);
+      tangents_[newStep] = std::move(tangents_[step]);
+      dualTangents_[newStep] = std::move(dualTangents_[step]);
+      for (auto& seedDuals : seedDuals_) {
+        seedDuals[newStep] = std::move(seedDuals[step]);
+      }
+      evals_[newStep] = std::move(evals_[step]);
+      vjps_[newStep] = std::move(vjps_[step]);
+      jvps_[newStep] = std::move(jvps_[step]);
+      hvps_[newStep] = std::move(hvps_[step]);
+      upstreamSteps_[newStep] = std::move(upstreamSteps_[step]);
+      passthroughs_[newStep] = std::move(passthroughs_[step]);
+      requires_vjp_[newStep] = requires_vjp_[step];
+      active_[newStep] = active_[step];
+      usageCount_[newStep] = usageCount_[step];
+      lastStepUsed_[newStep] = lastStepUsed_[step];
+      evaluatedPrimalBytes_[newStep] = evaluatedPrimalBytes_[step];
+    }
+    if (step < boundary) {
+      // every earlier step is now persistent or retired
+      passthroughs_[newStep].clear();
+      usageCount_[newStep] = 0;
+      lastStepUsed_[newStep] = newStep;
+      if (promoted[step]) {
+        upstreamSteps_[newStep].clear();
+        active_[newStep] = true;
+        decompress_primal(newStep);
+      }
+      continue;
+    }
+    for (Int& upstream : upstreamSteps_[newStep]) {
+      upstream = static_cast<Int>(newSteps[upstream]);
+    }
+    auto& passthroughs = passthroughs_[newStep];
+    passthroughs.erase(std::remove_if(passthroughs.begin(), passthroughs.end(), [&](Int p) { return p < boundary; }),
+                       passthroughs.end());
+    for (Int& passthrough : passthroughs) {
+      passthrough = static_cast<Int>(newSteps[passthrough]);
+    }
+    lastStepUsed_[newStep] = static_cast<Int>(newSteps[lastStepUsed_[newStep]]);
+  }
+  resize(newSize);
+
+  // the promoted steps are held as persistent checkpoints, in place of any checkpoint they had
+  persistentCheckpoints_ = 0;
+  for (Int step = 0; step < boundary; ++step) {
+    if (promoted[step]) {
+      checkpointStrategy_->make_persistent(newSteps[step]);
+    }
+  }
+  for (Int step = 0; step < size(); ++step) {
+    if (is_persistent(step)) {
+      ++persistentCheckpoints_;
+    }
+  }
+  gretl_check_full(check_validity());
+}
+
+void DataStore::resume_graph()
+{
+  gretl_assert_msg(!stillConstructingGraph_, "the graph is still being built");
+  reset();
+  if (size() > 0) {
+    reset_for_backprop();
+  }
+  stillConstructingGraph_ = true;
 }
 
 void DataStore::fetch_state_data(Int stepIndex)
@@ -268,55 +839,147 @@ void DataStore::fetch_state_data(Int stepIndex)
                        std::to_string(lastCheckpoint) + " > " + std::to_string(stepIndex));
   gretl_assert_msg(state_in_use(lastCheckpoint),
                    "cannot confirm that last checkpointed state is actually currently in memory");
-  for_each_active_upstream(this, lastCheckpoint, [&](Int upstream) { gretl_assert(state_in_use(upstream)); });
-  for (Int i = lastCheckpoint; i < stepIndex; ++i) {
+  recompute_from(lastCheckpoint, stepIndex);
+}
+
+void DataStore::recompute_primal(Int step)
+{
+  gretl_assert_msg(!stillConstructingGraph_, "not allowed to recompute a state before the graph is constructed");
+  gretl_assert_msg(step < currentStep_, "step " + std::to_string(step) + " was already back propagated");
+  if (states_[step]->primal()) {
+    return;
+  }
+  // the closest checkpoint before the step keeps every earlier step used after it in memory
+  Int checkpoint = step;
+  while (!active_[checkpoint] && !is_persistent(checkpoint)) {
+    --checkpoint;
+  }
+  gretl_check(state_in_use(checkpoint));
+  recompute_from(checkpoint, step);
+}
+
+void DataStore::recompute_from(Int checkpoint, Int stepIndex)
+{
+  for_each_active_upstream(this, checkpoint, [&](Int upstream) { gretl_check(state_in_use(upstream)); });
+  for (Int i = checkpoint; i < stepIndex; ++i) {
     Int iEval = i + 1;
     for_each_active_upstream(this, iEval, [&](Int u) {
-      gretl_assert_msg(state_in_use(u), "upstream is not in use");
+      gretl_check(state_in_use(u));
       usageCount_[u]++;
     });
-    gretl_assert(!active_[iEval]);
+    gretl_check(!active_[iEval]);
     active_[iEval] = true;
 
     if (states_[iEval]->primal()) {
-      for_each_active_upstream(this, iEval, [&](Int upstream) { gretl_assert(state_in_use(upstream)); });
+      for_each_active_upstream(this, iEval, [&](Int upstream) { gretl_check(state_in_use(upstream)); });
       erase_step_state_data(iEval);
     } else {
       states_[iEval]->evaluate_forward();
       checkpointStrategy_->record_recomputation();
     }
 
-    gretl_assert(check_validity());
+    gretl_check_full(check_validity());
   }
 }
 
 void DataStore::erase_step_state_data(Int step)
 {
+  if (is_streamed(step)) {
+    // nothing is recorded, the evaluated step becomes a leaf and stops holding its upstreams
+    std::vector<Int> upstreamSteps = std::move(upstreamSteps_[step]);
+    upstreamSteps_[step].clear();
+    evals_[step] = nullptr;
+    for (Int upstream : upstreamSteps) {
+      if (is_streamed(upstream)) {
+        gretl_check(usageCount_[upstream]);
+        usageCount_[upstream]--;
+        try_to_free(upstream);
+      }
+    }
+    return;
+  }
   if (!is_persistent(step)) {
     size_t stepToErase = checkpointStrategy_->add_checkpoint_and_get_index_to_remove(step);
     if (CheckpointStrategy::valid_checkpoint_index(stepToErase)) {
-      active_[stepToErase] = false;
-      try_to_free(static_cast<Int>(stepToErase));
-      for_each_active_upstream(this, stepToErase, [&](Int upstream) {
-        gretl_assert(usageCount_[upstream]);
-        usageCount_[upstream]--;
-        try_to_free(upstream);
-      });
+      evict_step(static_cast<Int>(stepToErase));
     }
+    if (memoryMonitor_) {
+      monitoredCheckpointBytes_ += primal_bytes(step);
+      ++monitoredCheckpoints_;
+    }
+    // upstreams last used here are not needed again until recomputing or back propagating through this step, unless
+    // this is the step just before the one being back propagated
+    if (stillConstructingGraph_ || step + 1 < currentStep_) {
+      for (Int upstream : upstreamSteps_[step]) {
+        if (lastStepUsed_[upstream] == step) {
+          compress_primal(upstream);
+        }
+      }
+    }
+    // while recomputing, the step just evaluated may be needed by the next one, so the capacity only changes between
+    // steps of back propagation
+    if (memoryMonitor_ && stillConstructingGraph_) {
+      poll_memory_monitor();
+    }
+    // retiring steps in batches of the window keeps its cost O(1) per step
+    if (window_ > 0 && stillConstructingGraph_ && !restoring() && step + 1 == size() &&
+        size() - persistentCheckpoints_ >= 2 * static_cast<size_t>(window_)) {
+      retire_steps_before(size() - window_);
+    }
+  }
+  gretl_check_full(check_validity());
+}
+
+void DataStore::evict_step(Int step)
+{
+  active_[step] = false;
+  try_to_free(step);
+  for_each_active_upstream(this, step, [&](Int upstream) {
+    gretl_check(usageCount_[upstream]);
+    usageCount_[upstream]--;
+    try_to_free(upstream);
+  });
+}
+
+void DataStore::set_checkpoint_capacity(size_t maxStates)
+{
+  gretl_assert_msg(maxStates >= 1, "the checkpoint capacity must be at least 1");
+  for (size_t step : checkpointStrategy_->set_capacity(maxStates)) {
+    evict_step(static_cast<Int>(step));
+  }
+  gretl_check_full(check_validity());
+}
+
+void DataStore::set_memory_monitor(std::shared_ptr<const MemoryMonitor> monitor)
+{
+  memoryMonitor_ = std::move(monitor);
+  memoryMonitorMaxCapacity_ = checkpoint_capacity();
+  memoryMonitorCalls_ = 0;
+  monitoredCheckpointBytes_ = 0;
+  monitoredCheckpoints_ = 0;
+}
+
+void DataStore::poll_memory_monitor()
+{
+  if (++memoryMonitorCalls_ < memoryMonitor_->options().interval || monitoredCheckpoints_ == 0) {
+    return;
   }
-  if (!check_validity()) {
-    gretl_assert(check_validity());
+  memoryMonitorCalls_ = 0;
+  size_t held = checkpointStrategy_->size() - persistentCheckpoints_;
+  size_t capacity = memoryMonitor_->recommend_capacity(held, monitoredCheckpointBytes_ / monitoredCheckpoints_,
+                                                       memoryMonitorMaxCapacity_);
+  if (capacity != checkpoint_capacity()) {
+    set_checkpoint_capacity(capacity);
   }
 }
 
 bool DataStore::check_validity() const
 {
-  return true;
   bool valid = true;
   // first check that our version of the saved states matches the cp manager
   // we are allowed to be saving an extra step here at the end
   for (size_t i = 0; i < currentStep_; ++i) {
-    if (active_[i]) {
+    if (active_[i] && !is_streamed(static_cast<Int>(i))) {
       bool cp_has_i = checkpointStrategy_->contains_step(i);
       if (!cp_has_i) {
         gretl::print("step", i, "not consistent with checkpoint manager");
@@ -327,12 +990,17 @@ bool DataStore::check_validity() const
 
   std::vector<Int> my_active_count(states_.size(), 0);
   for (size_t i = 0; i < states_.size(); ++i) {
-    if (active_[i]) {
+    if (active_[i] && !is_streamed(static_cast<Int>(i))) {
       for_each_active_upstream(this, i, [&](Int u) { my_active_count[u]++; });
     }
   }
   for (size_t i = 0; i < states_.size(); ++i) {
-    if (my_active_count[i] > 0 && !states_[i]->primal()) {
+    if (is_streamed(static_cast<Int>(i))) {
+      // streamed steps only count the uses of steps not yet evaluated
+      continue;
+    }
+    // while restoring, only the primals saved in the checkpoint file are attached
+    if (my_active_count[i] > 0 && !states_[i]->primal() && !restoring()) {
       gretl::print("step", i, "has an active count, but is deallocated");
       valid = false;
     }
@@ -355,6 +1023,24 @@ bool DataStore::check_validity() const
   return valid;
 }
 
+std::vector<PinnedStep> DataStore::pinned_steps() const
+{
+  std::vector<PinnedStep> pinned;
+  for (Int step = 0; step < states_.size(); ++step) {
+    if (!states_[step] || is_persistent(step) || active_[step] || !states_[step]->primal()) {
+      continue;
+    }
+    size_t externalHandles = states_[step]->wild_count();
+    if (externalHandles || usageCount_[step]) {
+      pinned.push_back(
+          PinnedStep{step, typeString(*states_[step]), primal_bytes(step), externalHandles, usageCount_[step]});
+    }
+  }
+  std::stable_sort(pinned.begin(), pinned.end(),
+                   [](const PinnedStep& a, const PinnedStep& b) { return a.bytes > b.bytes; });
+  return pinned;
+}
+
 void DataStore::print_graph() const
 {
   for (Int i = 0; i < states_.size(); ++i) {
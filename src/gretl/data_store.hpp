@@ -19,6 +19,7 @@
 #include <type_traits>
 #include <utility>
 #include "checkpoint.hpp"
+#include "checkpoint_compression.hpp"
 #include "checkpoint_strategy.hpp"
 #include "print_utils.hpp"
 
@@ -40,6 +41,10 @@ struct UpstreamStates;
 
 struct DownstreamState;
 
+class CheckpointFile;
+
+class MemoryMonitor;
+
 /// @brief ZeroDual function type
 template <typename T, typename D = T>
 using InitializeZeroDual = std::function<D(const T&)>;
@@ -51,6 +56,15 @@ struct defaultInitializeZeroDual {
   D operator()(const T&) { return D{}; }
 };
 
+/// @brief A step whose primal is kept in memory by something other than the checkpoint strategy
+struct PinnedStep {
+  Int step;                ///< step
+  std::string type;        ///< type of the step's state
+  size_t bytes;            ///< primal_bytes of the step
+  size_t externalHandles;  ///< State handles held outside the graph, see StateBase::wild_count
+  Int uses;                ///< uses by checkpointed steps, as an upstream or passthrough
+};
+
 /// @brief DataStore class hold onto states, duals and additional information to represent a computational graph, its
 /// checkpointing state information, and its backpropagated sensitivities
 class DataStore {
@@ -74,7 +88,7 @@ class DataStore {
   template <typename T, typename D>
   State<T, D> create_state(const T& t, InitializeZeroDual<T, D> initial_zero_dual = [](const T&) { return D{}; })
   {
-    State<T, D> state(this, lifetimeToken_, states_.size(), std::make_shared<std::any>(t), initial_zero_dual);
+    State<T, D> state(this, lifetimeToken_, next_step(), std::make_shared<std::any>(t), initial_zero_dual);
     add_state(std::make_unique<State<T, D>>(state), {});
     if (!gradients_enabled()) {
       state.set_vjp([](UpstreamStates&, const DownstreamState&) {});
@@ -85,9 +99,16 @@ class DataStore {
   /// @brief  unwind one step of the graph
   virtual void reverse_state();
 
-  /// @brief unwind the entire graph
+  /// @brief unwind the entire graph.  If more than one dual seed is in use, every seed is back propagated in this
+  /// same sweep, so checkpoint recomputations are only paid once for all seeds.
   void back_prop();
 
+  /// @brief unwind the entire graph, additionally propagating dual tangents through each state's hvp.  Requires
+  /// tangents to have been seeded and propagated forward (see forward_tangent).  The dual tangents of the inputs then
+  /// hold the Hessian-vector product of the objective in the seeded direction.  Only the regular dual seed is
+  /// differentiated.
+  void back_prop_hvp();
+
   /// @brief clear all but persistent state, keeping the graph. Returns the number of persistent states.
   void reset();
 
@@ -103,10 +124,19 @@ class DataStore {
   /// @brief get total number of states in the graph
   Int size() { return static_cast<Int>(states_.size()); }
 
+  /// @brief step of the next state added to the graph, reusing a released step while streaming
+  Int next_step() const { return freeSteps_.empty() ? static_cast<Int>(states_.size()) : freeSteps_.back(); }
+
   /// @brief print all checkpoint data in data store
   void print_graph() const;
 
-  /// @brief do internal checks of consistency with respect to checkpoints and
+  /// @brief List the non-persistent steps held in memory without being checkpointed, i.e. pinned by external State
+  /// handles or by checkpointed steps which use them later, largest first.  These are what make a run use more memory
+  /// than its checkpoint budget implies.  O(N) in the size of the graph, so it can be called at any point.
+  std::vector<PinnedStep> pinned_steps() const;
+
+  /// @brief do internal checks of consistency with respect to checkpoints and usage counts.  This is O(N) in the size
+  /// of the graph, it only runs after every step when compiled with GRETL_VALIDATION=full.
   bool check_validity() const;
 
   /// @brief create a new state in the graph, store it, return it
@@ -115,10 +145,12 @@ class DataStore {
   {
     gretl_assert(!upstreams.empty());
     auto t = std::make_shared<std::any>(T{});
-    State<T, D> state(this, lifetimeToken_, states_.size(), t, initial_zero_dual);
+    State<T, D> state(this, lifetimeToken_, next_step(), t, initial_zero_dual);
     add_state(std::make_unique<State<T, D>>(state), upstreams);
     if (!gradients_enabled()) {
       state.set_vjp([](UpstreamStates&, const DownstreamState&) {});
+      state.set_jvp([](const UpstreamStates&, DownstreamState&) {});
+      state.set_hvp([](UpstreamStates&, const DownstreamState&) {});
     }
     return state;
   }
@@ -126,12 +158,31 @@ class DataStore {
   /// @brief vjp
   void vjp(StateBase& state);
 
+  /// @brief jvp
+  void jvp(StateBase& state);
+
+  /// @brief hvp
+  void hvp(StateBase& state);
+
+  /// @brief re-evaluates the graph forward from its persistent states, propagating the seeded tangents to every
+  /// downstream state.  Tangents are only held alongside primals, so checkpointed steps keep theirs and recomputed
+  /// steps regenerate them.
+  void forward_tangent();
+
+  /// @brief clear all tangents, including the seeds on persistent states, and stop propagating tangents
+  void clear_tangents();
+
   /// @brief function for safely adding new states to graph and checkpoint
   void add_state(std::unique_ptr<StateBase> newState, const std::vector<StateBase>& upstreams);
 
   /// @brief method for fetching states at a particular step
   void fetch_state_data(Int);
 
+  /// @brief Recompute the freed primal of a step which has not been back propagated yet, from the closest checkpoint
+  /// before it, which need not be the last checkpoint as when fetching.  For reading steps out of order after the
+  /// graph is finalized, e.g. through a WeakState.
+  void recompute_primal(Int step);
+
   /// @brief erase the data for a particular step
   void erase_step_state_data(Int);
 
@@ -144,6 +195,13 @@ class DataStore {
   /// @brief std::function for computing vector-jacobian product from downstream dual to upstream duals
   using VjpT = std::function<void(UpstreamStates& upstreams, const DownstreamState& downstream)>;
 
+  /// @brief std::function for computing jacobian-vector product from upstream tangents to the downstream tangent
+  using JvpT = std::function<void(const UpstreamStates& upstreams, DownstreamState& downstream)>;
+
+  /// @brief std::function for computing the tangent of the vector-jacobian product (forward-over-reverse), from the
+  /// downstream dual and dual tangent, and the upstream tangents, to the upstream dual tangents
+  using HvpT = std::function<void(UpstreamStates& upstreams, const DownstreamState& downstream)>;
+
   /// @brief Get the primal data as a shared_ptr to std::any (type-erased)
   /// @param step
   std::shared_ptr<std::any>& any_primal(Int step);
@@ -154,9 +212,12 @@ class DataStore {
   const T& get_primal(Int step)
   {
     T* tptr = std::any_cast<T>(any_primal(step).get());
+    if (!tptr && (decompress_primal(step) || page_in_primal(step))) {
+      tptr = std::any_cast<T>(any_primal(step).get());
+    }
     if (stillConstructingGraph_) {
       if (!tptr) {
-        gretl_assert(check_validity());
+        gretl_check_full(check_validity());
         print_graph();
         print("on reverse, at ", currentStep_, "getting", step);
       }
@@ -179,6 +240,11 @@ class DataStore {
   {
     using U = std::decay_t<T>;
     U* tptr = std::any_cast<U>(any_primal(step).get());
+    if (!tptr && any_primal(step)) {
+      // replace a compressed or not yet paged in primal
+      *any_primal(step) = std::forward<T>(t);
+      return;
+    }
     if (!tptr) {
       gretl_assert(!stillConstructingGraph_);
       any_primal(step) = std::make_shared<std::any>(std::forward<T>(t));
@@ -193,15 +259,7 @@ class DataStore {
   template <typename D, typename T>
   D& get_dual(Int step)
   {
-    if (!duals_[step]) {
-      const T& thisPrimal = get_primal<T>(step);
-      auto thisState = dynamic_cast<const State<T, D>*>(states_[step].get());
-      gretl_assert_msg(thisState, std::string("failed to get primal to this state, step ") + std::to_string(step));
-      duals_[step] = std::make_unique<std::any>(thisState->initialize_zero_dual_(thisPrimal));
-    }
-    auto dualData = std::any_cast<D>(duals_[step].get());
-    gretl_assert(dualData);
-    return *dualData;
+    return get_dual_in<D, T>(duals_, step);
   }
 
   /// @brief Set dual value
@@ -210,14 +268,47 @@ class DataStore {
   template <typename D>
   void set_dual(Int step, const D& d)
   {
-    if (!duals_[step]) {
-      duals_[step] = std::make_unique<std::any>(d);
+    set_dual_in(duals_, step, d);
+  }
+
+  /// @brief Get the dual value for one seed of a batched reverse sweep.  Seed 0 is the regular dual.
+  /// @param step step
+  /// @param seed seed index, the number of seeds grows as needed
+  template <typename D, typename T>
+  D& get_seed_dual(Int step, size_t seed)
+  {
+    if (seed == 0) {
+      return get_dual<D, T>(step);
     }
-    auto dualData = std::any_cast<D>(duals_[step].get());
-    gretl_assert(dualData);
-    *dualData = d;
+    if (seed >= num_dual_seeds()) {
+      set_num_dual_seeds(seed + 1);
+    }
+    return get_dual_in<D, T>(seedDuals_[seed - 1], step);
+  }
+
+  /// @brief Set the dual value for one seed of a batched reverse sweep.  Seed 0 is the regular dual.
+  /// @param step step
+  /// @param seed seed index, the number of seeds grows as needed
+  /// @param d value of type D to set dual to
+  template <typename D>
+  void set_seed_dual(Int step, size_t seed, const D& d)
+  {
+    if (seed == 0) {
+      set_dual(step, d);
+      return;
+    }
+    if (seed >= num_dual_seeds()) {
+      set_num_dual_seeds(seed + 1);
+    }
+    set_dual_in(seedDuals_[seed - 1], step, d);
   }
 
+  /// @brief Number of dual seeds back propagated together by back_prop, including the regular dual
+  size_t num_dual_seeds() const { return seedDuals_.size() + 1; }
+
+  /// @brief Set the number of dual seeds back propagated together by back_prop.  Setting 1 removes all additional seeds.
+  void set_num_dual_seeds(size_t numSeeds);
+
   /// @brief Deallocate the dual value
   /// @param step
   void clear_dual(Int step)
@@ -227,6 +318,62 @@ class DataStore {
     }
   }
 
+  /// @brief Get tangent value, tangents live in the dual space and are zero initialized like duals
+  /// @param step
+  template <typename D, typename T>
+  D& get_tangent(Int step)
+  {
+    if (!tangents_[step]) {
+      const T& thisPrimal = get_primal<T>(step);
+      auto thisState = dynamic_cast<const State<T, D>*>(states_[step].get());
+      gretl_assert_msg(thisState, std::string("failed to get primal to this state, step ") + std::to_string(step));
+      tangents_[step] = std::make_unique<std::any>(thisState->initialize_zero_dual_(thisPrimal));
+    }
+    auto tangentData = std::any_cast<D>(tangents_[step].get());
+    gretl_assert(tangentData);
+    return *tangentData;
+  }
+
+  /// @brief Set tangent value (forwarding version: moves rvalues, copies lvalues)
+  /// @param step step
+  /// @param d value of type D to set tangent to
+  template <typename D>
+  void set_tangent(Int step, D&& d)
+  {
+    using U = std::decay_t<D>;
+    U* dptr = tangents_[step] ? std::any_cast<U>(tangents_[step].get()) : nullptr;
+    if (!dptr) {
+      tangents_[step] = std::make_unique<std::any>(std::forward<D>(d));
+      return;
+    }
+    *dptr = std::forward<D>(d);
+  }
+
+  /// @brief Deallocate the tangent value
+  /// @param step
+  void clear_tangent(Int step)
+  {
+    if (tangents_[step]) {
+      tangents_[step] = nullptr;
+    }
+  }
+
+  /// @brief Get the dual tangent value, the directional derivative of the dual along the seeded tangents
+  /// @param step
+  template <typename D, typename T>
+  D& get_dual_tangent(Int step)
+  {
+    if (!dualTangents_[step]) {
+      const T& thisPrimal = get_primal<T>(step);
+      auto thisState = dynamic_cast<const State<T, D>*>(states_[step].get());
+      gretl_assert_msg(thisState, std::string("failed to get primal to this state, step ") + std::to_string(step));
+      dualTangents_[step] = std::make_unique<std::any>(thisState->initialize_zero_dual_(thisPrimal));
+    }
+    auto dualTangentData = std::any_cast<D>(dualTangents_[step].get());
+    gretl_assert(dualTangentData);
+    return *dualTangentData;
+  }
+
   /// @brief Check if state in use
   /// @param step step
   /// @return bool
@@ -237,6 +384,47 @@ class DataStore {
   /// @return bool
   bool is_persistent(Int step) const;
 
+  /// @brief Compress the primal of a step with the checkpoint codec, if one is set.  Returns false, leaving the primal
+  /// untouched, if the step is persistent, not in memory, referenced by states outside the graph, already compressed,
+  /// or not supported by the codec.
+  bool compress_primal(Int step);
+
+  /// @brief Restore a compressed primal in place.  Returns false if the primal was not compressed.
+  bool decompress_primal(Int step);
+
+  /// @brief Check if the primal of a step is currently held compressed
+  bool is_compressed(Int step) const;
+
+  /// @brief Codec used for the checkpoints of a step: the state's own codec if set, otherwise the DataStore's
+  const PrimalCodec* checkpoint_codec(Int step) const;
+
+  /// @brief Set a codec used to compress the primals of checkpointed steps while they are not needed: a primal is
+  /// compressed once every downstream step known to use it has been evaluated, and decompressed when it is next
+  /// accessed (e.g. when recomputing from it, or back propagating through the step after it).  Passing nullptr
+  /// restores all compressed primals and turns compression off.  States may override the codec, see
+  /// StateBase::set_checkpoint_codec.
+  void set_checkpoint_compression(std::shared_ptr<const PrimalCodec> codec);
+
+  /// @brief Counters of the checkpoint compression
+  const CompressionMetrics& compression_metrics() const { return compressionMetrics_; }
+
+  /// @brief Restore a graph saved by save_checkpoint_file after its forward pass, e.g. in a later job.  The graph must
+  /// then be built again by the same code, starting from the same persistent states, and with the same checkpoint
+  /// strategy and budget, so the strategy makes the same decisions.  While building, steps are checked against the
+  /// file but not evaluated; the saved primals are paged in from the file when first accessed, and back_prop then
+  /// runs as it would have in the original job.  Code building the graph must not read primals which were not saved.
+  void restore_from(std::shared_ptr<const CheckpointFile> file);
+
+  /// @brief Check if the graph being built is restored from a checkpoint file
+  bool restoring() const { return restoreFile_ && stillConstructingGraph_; }
+
+  /// @brief Called instead of evaluating a step while restoring: attaches its saved primal, if any
+  void restore_step(Int step);
+
+  /// @brief Read a primal saved in a checkpoint file in place.  Returns false if the primal was not waiting to be paged
+  /// in.
+  bool page_in_primal(Int step);
+
   /// @brief Register the graph as being complete.  This is mostly for internal consistency checks.
   void finalize_graph() { stillConstructingGraph_ = false; }
 
@@ -245,13 +433,19 @@ class DataStore {
   /// upstream; and 3.) an external copy of this state is not being help for potential future use outside of the graph.
   void try_to_free(Int step);
 
-  std::vector<std::unique_ptr<StateBase>> states_;  ///< states for steps
-  std::vector<std::unique_ptr<std::any>> duals_;    ///< duals for steps
-  std::vector<std::vector<Int>> upstreamSteps_;     ///< upstream step dependencies for steps
-  std::vector<EvalT> evals_;                        ///< forward evaluation functions for steps
-  std::vector<VjpT> vjps_;                          ///< vector-jacobian product functions for steps
-  std::vector<bool> requires_vjp_;                  ///< flag to indicate if state requires VJP evaluation
-  std::vector<bool> active_;                        ///< active status for steps
+  std::vector<std::unique_ptr<StateBase>> states_;       ///< states for steps
+  std::vector<std::unique_ptr<std::any>> duals_;         ///< duals for steps
+  std::vector<std::vector<Int>> upstreamSteps_;          ///< upstream step dependencies for steps
+  std::vector<EvalT> evals_;                             ///< forward evaluation functions for steps
+  std::vector<VjpT> vjps_;                               ///< vector-jacobian product functions for steps
+  std::vector<JvpT> jvps_;                               ///< jacobian-vector product functions for steps
+  std::vector<std::unique_ptr<std::any>> tangents_;      ///< forward-mode tangents for steps, freed with their primals
+  std::vector<HvpT> hvps_;                               ///< forward-over-reverse adjoint functions for steps
+  std::vector<std::unique_ptr<std::any>> dualTangents_;  ///< tangents of the duals for steps, freed with their duals
+  std::vector<std::vector<std::unique_ptr<std::any>>> seedDuals_;  ///< duals for the additional seeds of a batched
+                                                                   ///< reverse sweep, seed k is stored at k - 1
+  std::vector<bool> requires_vjp_;                       ///< flag to indicate if state requires VJP evaluation
+  std::vector<bool> active_;                             ///< active status for steps
   std::vector<Int> usageCount_;  ///< count how many times a step is used in some downstream still is the scope of the
                                  ///< checkpoint algorithm
 
@@ -259,10 +453,21 @@ class DataStore {
       lastStepUsed_;  ///< for a given step, records the last known future-step where its used as an upstream
   std::vector<std::vector<Int>> passthroughs_;  ///< at a given step, the list of all the previous steps which are
                                                 ///< eventually used in some future step as an upstream
+  std::vector<size_t> evaluatedPrimalBytes_;    ///< primal_bytes of each step when it was last evaluated, see
+                                                ///< estimate_sweep_memory
 
   /// container which track the states in the graph with allocated data
   std::unique_ptr<CheckpointStrategy> checkpointStrategy_;
 
+  /// codec compressing the primals of checkpointed steps, none by default
+  std::shared_ptr<const PrimalCodec> checkpointCodec_;
+
+  /// counters of the checkpoint compression
+  CompressionMetrics compressionMetrics_;
+
+  /// checkpoint file the graph being built is restored from
+  std::shared_ptr<const CheckpointFile> restoreFile_;
+
   /// step counter
   Int currentStep_;
 
@@ -272,12 +477,144 @@ class DataStore {
   /// @brief flag to control whether states compute gradients (VJP)
   bool gradients_enabled_ = true;
 
-  /// @brief Query if gradients are enabled for newly created states
-  bool gradients_enabled() const { return gradients_enabled_; }
+  /// @brief Query if gradients are enabled for newly created states, they never are while streaming
+  bool gradients_enabled() const { return gradients_enabled_ && !streaming_; }
 
   /// @brief Set whether gradients (VJPs) should be recorded for newly created states
   void set_gradients_enabled(bool enable) { gradients_enabled_ = enable; }
 
+  /// @brief flag to control whether forward evaluations also propagate tangents (JVP)
+  bool tangents_enabled_ = false;
+
+  /// @brief Query if tangents are propagated during forward evaluation
+  bool tangents_enabled() const { return tangents_enabled_; }
+
+  /// @brief Set whether tangents should be propagated during forward evaluation, including checkpoint recomputation
+  void set_tangents_enabled(bool enable) { tangents_enabled_ = enable; }
+
+  /// @brief flag to control whether a checkpointed step only keeps its live cut in memory
+  bool liveCutCheckpoints_ = false;
+
+  /// @brief flag to control whether new states are evaluated without recording the graph
+  bool streaming_ = false;
+
+  /// @brief first step created while streaming
+  Int streamingBegin_ = 0;
+
+  /// @brief steps released while streaming, reused by the next states created
+  std::vector<Int> freeSteps_;
+
+  /// @brief Query if new states are streamed
+  bool streaming() const { return streaming_; }
+
+  /// @brief Check if a step was created while streaming
+  bool is_streamed(Int step) const { return streaming_ && step >= streamingBegin_; }
+
+  /// @brief Set whether new states are streamed: evaluated without recording the graph, for forward-only runs.
+  /// Unlike set_gradients_enabled(false), which still records every step for the checkpoint strategy, a streamed state
+  /// forgets its upstreams and eval once it is evaluated, and its step is released as soon as no handle references it,
+  /// to be reused by the next state created.  Memory then only grows with the number of live states, and the checkpoint
+  /// strategy is not involved.  When streaming is turned off, the streamed states still referenced are kept as
+  /// persistent states (constants of the graph), so gradients can be recorded again downstream of them.  Can only be
+  /// changed while building the graph.
+  void set_streaming(bool enable);
+
+  /// @brief number of most recent steps kept by the sliding window, 0 when the whole graph is kept
+  Int window_ = 0;
+
+  /// @brief Query the number of most recent steps kept by the sliding window, 0 when the whole graph is kept
+  Int window() const { return window_; }
+
+  /// @brief Set a sliding window for unbounded runs which only need gradients over their last numSteps steps.  While
+  /// building the graph, once it holds twice the window, the steps before the last numSteps are retired (see
+  /// retire_steps_before), and back_prop first retires down to exactly the window.  Memory and the cost of each back
+  /// propagation then stay O(numSteps) however long the run, e.g. alternating steps, back_prop and resume_graph.  0
+  /// keeps the whole graph.  Requires a checkpoint strategy supporting renumbering.
+  void set_window(Int numSteps);
+
+  /// @brief Remove the steps before a given step from the graph.  The steps before it still used by later steps, or
+  /// referenced by handles outside the graph, are kept as persistent states (constants of the graph) holding their
+  /// current primal, recomputed if needed; after back_prop their duals hold the gradient with respect to the window
+  /// boundary.  The other steps are dropped, and the kept steps renumbered from the front.  Can only be called before
+  /// back propagating, not while streaming or restoring.
+  void retire_steps_before(Int boundary);
+
+  /// @brief After back propagating, evaluate the graph forward again and go back to building it, so that more steps
+  /// can be added, e.g. to continue an unbounded run after taking a gradient over its window.
+  void resume_graph();
+
+  /// @brief Query if checkpoints only keep their live cut in memory
+  bool live_cut_checkpoints() const { return liveCutCheckpoints_; }
+
+  /// @brief Set whether a checkpointed step only keeps its live cut in memory: the step itself and the earlier steps
+  /// which are used after it.  By default a checkpointed step also keeps all of its own upstreams, which for wide DAGs
+  /// (e.g. the stages combined at the end of an rk4 step) can be much more than is needed to resume from it.  The
+  /// upstreams needed to back propagate through a step are instead provided by the live cut of the step before it.
+  /// Can only be changed while no non-persistent step is in memory, i.e. before the graph is built or after reset().
+  void set_live_cut_checkpoints(bool enable);
+
+  /// @brief Estimated size in bytes of the primal a step holds in memory: exact for double and std::vector<double>
+  /// primals, the encoded size when compressed, and 0 when not in memory or not yet paged in from a checkpoint file.
+  /// Other types count as 1 byte.
+  size_t primal_bytes(Int step) const;
+
+  /// @brief Bytes released if a checkpointed step were evicted now: its own primal, unless later steps still use it
+  /// or handles outside the graph reference it, and the primals of the upstreams only it keeps in memory.
+  size_t freeable_bytes(Int step) const;
+
+  /// @brief Query if the checkpoint strategy is told which evictions release memory
+  bool liveness_aware_eviction() const { return livenessAwareEviction_; }
+
+  /// @brief Set whether the checkpoint strategy is given freeable_bytes as its eviction oracle, so that among the
+  /// steps it considers dispensable it prefers one whose eviction actually releases memory.  Evicting a step pinned
+  /// by a long lived passthrough or an external handle frees nothing, and only costs a later recomputation.  Since
+  /// the eviction decisions then depend on what is in memory, this should not be combined with restore_from.  Must be
+  /// set again if the checkpoint strategy is replaced.
+  void set_liveness_aware_eviction(bool enable);
+
+  /// @brief flag to control whether the checkpoint strategy is given an eviction oracle
+  bool livenessAwareEviction_ = false;
+
+  /// @brief scratch buffer of freeable_bytes, reused so the eviction oracle does not allocate once it has grown
+  mutable std::vector<Int> freeableUpstreams_;
+
+  /// @brief Number of non-persistent checkpoints the checkpoint strategy may hold
+  size_t checkpoint_capacity() const { return checkpointStrategy_->capacity() - persistentCheckpoints_; }
+
+  /// @brief Change the number of non-persistent checkpoints the checkpoint strategy may hold, while building the graph
+  /// or between steps of back propagation.  Shrinking evicts the surplus checkpoints right away, which are then
+  /// recomputed when needed; growing lets later stores keep more.  Strategies not supporting set_capacity ignore it.
+  void set_checkpoint_capacity(size_t maxStates);
+
+  /// @brief Set a monitor which adjusts the checkpoint capacity to the memory available, or null to stop.  It is polled
+  /// every few checkpoint stores while building the graph and every few steps of back propagation, with the average
+  /// size of the checkpoints stored so far.  Unless set in its options, the largest capacity it recommends is the one
+  /// at the time it is set, so a long run degrades to more recomputation under memory pressure and recovers its
+  /// capacity when memory is released.
+  void set_memory_monitor(std::shared_ptr<const MemoryMonitor> monitor);
+
+  /// @brief The memory monitor set, if any
+  const std::shared_ptr<const MemoryMonitor>& memory_monitor() const { return memoryMonitor_; }
+
+  /// @brief number of persistent checkpoints given to the checkpoint strategy
+  size_t persistentCheckpoints_ = 0;
+
+  /// @brief monitor adjusting the checkpoint capacity, none by default
+  std::shared_ptr<const MemoryMonitor> memoryMonitor_;
+
+  /// @brief largest capacity the memory monitor may recommend, unless set in its options
+  size_t memoryMonitorMaxCapacity_ = 0;
+
+  /// @brief calls to poll_memory_monitor since the memory was last read
+  size_t memoryMonitorCalls_ = 0;
+
+  /// @brief total size of the checkpoints stored while a memory monitor is set, and their number
+  size_t monitoredCheckpointBytes_ = 0;
+  size_t monitoredCheckpoints_ = 0;  ///< number of checkpoints in monitoredCheckpointBytes_
+
+  /// @brief flag which is set while back_prop_hvp is unwinding the graph
+  bool secondOrderSweep_ = false;
+
   /// @brief flag to prevent accessing freed memory during destruction
   bool isDestroying_ = false;
   std::shared_ptr<void> lifetimeToken_ = std::make_shared<int>(0);
@@ -289,6 +626,53 @@ class DataStore {
 
   friend struct UpstreamState;
   friend struct DownstreamState;
+
+ private:
+  /// @brief Get (allocating and zeroing if needed) a dual value from a given bank of duals
+  template <typename D, typename T>
+  D& get_dual_in(std::vector<std::unique_ptr<std::any>>& duals, Int step)
+  {
+    if (!duals[step]) {
+      const T& thisPrimal = get_primal<T>(step);
+      auto thisState = dynamic_cast<const State<T, D>*>(states_[step].get());
+      gretl_assert_msg(thisState, std::string("failed to get primal to this state, step ") + std::to_string(step));
+      duals[step] = std::make_unique<std::any>(thisState->initialize_zero_dual_(thisPrimal));
+    }
+    auto dualData = std::any_cast<D>(duals[step].get());
+    gretl_assert(dualData);
+    return *dualData;
+  }
+
+  /// @brief add_state while streaming: reuses a released step, and only holds the upstreams until evaluation
+  void add_streamed_state(std::unique_ptr<StateBase> newState, const std::vector<StateBase>& upstreams);
+
+  /// @brief Release a streamed step no longer referenced, so it can be reused
+  void release_streamed_step(Int step);
+
+  /// @brief Release a checkpointed step evicted by the checkpoint strategy, and its hold on its upstreams
+  void evict_step(Int step);
+
+  /// @brief Evaluate the steps after a checkpoint up to a given step, storing them with the checkpoint strategy
+  void recompute_from(Int checkpoint, Int stepIndex);
+
+  /// @brief Read the memory monitor if it is due, and apply the capacity it recommends
+  void poll_memory_monitor();
+
+  /// @brief Set a dual value in a given bank of duals
+  template <typename D>
+  void set_dual_in(std::vector<std::unique_ptr<std::any>>& duals, Int step, const D& d)
+  {
+    if (!duals[step]) {
+      duals[step] = std::make_unique<std::any>(d);
+    }
+    auto dualData = std::any_cast<D>(duals[step].get());
+    gretl_assert(dualData);
+    *dualData = d;
+  }
+
+  /// @brief Swap the duals of a step and its upstreams with those of an additional seed, so the step's vjp acts on
+  /// that seed.  Calling twice restores the original layout.
+  void swap_seed_duals(Int step, size_t seed);
 };
 
 }  // namespace gretl
@@ -34,6 +34,18 @@ inline State<double> axpby(double a, const State<double>& x, double b, const Sta
     Y_dual += b * Z_dual;
   });
 
+  z.set_jvp([a, b](const gretl::UpstreamStates& upstreams, gretl::DownstreamState& downstream) {
+    const double& X_tangent = upstreams[0].get_tangent<double, double>();
+    const double& Y_tangent = upstreams[1].get_tangent<double, double>();
+    downstream.set_tangent(a * X_tangent + b * Y_tangent);
+  });
+
+  z.set_hvp([a, b](gretl::UpstreamStates& upstreams, const gretl::DownstreamState& downstream) {
+    const double& Z_dual_tangent = downstream.get_dual_tangent<double, double>();
+    upstreams[0].get_dual_tangent<double, double>() += a * Z_dual_tangent;
+    upstreams[1].get_dual_tangent<double, double>() += b * Z_dual_tangent;
+  });
+
   return z.finalize();
 }
 
@@ -53,6 +65,16 @@ inline State<double> axpb(double a, const State<double>& x, double b)
     X_dual += a * Z_dual;
   });
 
+  z.set_jvp([a](const gretl::UpstreamStates& upstreams, gretl::DownstreamState& downstream) {
+    const double& X_tangent = upstreams[0].get_tangent<double, double>();
+    downstream.set_tangent(a * X_tangent);
+  });
+
+  z.set_hvp([a](gretl::UpstreamStates& upstreams, const gretl::DownstreamState& downstream) {
+    const double& Z_dual_tangent = downstream.get_dual_tangent<double, double>();
+    upstreams[0].get_dual_tangent<double, double>() += a * Z_dual_tangent;
+  });
+
   return z.finalize();
 }
 
@@ -89,17 +111,60 @@ inline State<double> operator/(double a, const State<double>& x)
     upstreams[0].get_dual<double, double>() -= a * Z_dual / (X * X);
   });
 
+  z.set_jvp([a](const gretl::UpstreamStates& upstreams, gretl::DownstreamState& downstream) {
+    const double& X = upstreams[0].get<double>();
+    const double& X_tangent = upstreams[0].get_tangent<double, double>();
+    downstream.set_tangent(-a * X_tangent / (X * X));
+  });
+
+  z.set_hvp([a](gretl::UpstreamStates& upstreams, const gretl::DownstreamState& downstream) {
+    const double& Z_dual = downstream.get_dual<double, double>();
+    const double& Z_dual_tangent = downstream.get_dual_tangent<double, double>();
+    const double& X = upstreams[0].get<double>();
+    const double& X_tangent = upstreams[0].get_tangent<double, double>();
+    upstreams[0].get_dual_tangent<double, double>() +=
+        -a * Z_dual_tangent / (X * X) + 2.0 * a * Z_dual * X_tangent / (X * X * X);
+  });
+
   return z.finalize();
 }
 
 inline State<double> operator*(const State<double>& x, const State<double>& y)
 {
-  return clone_state([](const double& a, const double& b) { return a * b; },
-                     [](const double& a, const double& b, const double&, double& a_, double& b_, const double& c_) {
-                       a_ += b * c_;
-                       b_ += a * c_;
-                     },
-                     x, y);
+  auto z = x.clone({x, y});
+
+  z.set_eval([](const gretl::UpstreamStates& upstreams, gretl::DownstreamState& downstream) {
+    downstream.set(upstreams[0].get<double>() * upstreams[1].get<double>());
+  });
+
+  z.set_vjp([](gretl::UpstreamStates& upstreams, const gretl::DownstreamState& downstream) {
+    const double& Z_dual = downstream.get_dual<double, double>();
+    const double& X = upstreams[0].get<double>();
+    const double& Y = upstreams[1].get<double>();
+    upstreams[0].get_dual<double, double>() += Y * Z_dual;
+    upstreams[1].get_dual<double, double>() += X * Z_dual;
+  });
+
+  z.set_jvp([](const gretl::UpstreamStates& upstreams, gretl::DownstreamState& downstream) {
+    const double& X = upstreams[0].get<double>();
+    const double& Y = upstreams[1].get<double>();
+    const double& X_tangent = upstreams[0].get_tangent<double, double>();
+    const double& Y_tangent = upstreams[1].get_tangent<double, double>();
+    downstream.set_tangent(X_tangent * Y + X * Y_tangent);
+  });
+
+  z.set_hvp([](gretl::UpstreamStates& upstreams, const gretl::DownstreamState& downstream) {
+    const double& Z_dual = downstream.get_dual<double, double>();
+    const double& Z_dual_tangent = downstream.get_dual_tangent<double, double>();
+    const double& X = upstreams[0].get<double>();
+    const double& Y = upstreams[1].get<double>();
+    const double& X_tangent = upstreams[0].get_tangent<double, double>();
+    const double& Y_tangent = upstreams[1].get_tangent<double, double>();
+    upstreams[0].get_dual_tangent<double, double>() += Y_tangent * Z_dual + Y * Z_dual_tangent;
+    upstreams[1].get_dual_tangent<double, double>() += X_tangent * Z_dual + X * Z_dual_tangent;
+  });
+
+  return z.finalize();
 }
 
 }  // namespace gretl
\ No newline at end of file
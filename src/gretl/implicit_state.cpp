@@ -0,0 +1,135 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "implicit_state.hpp"
+#include "vector_algebra.hpp"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+
+namespace gretl {
+
+using detail::axpy;
+using detail::dot;
+using detail::norm;
+
+Vector solve_linear_system(const std::function<Vector(const Vector&)>& action, const Vector& b,
+                           const ImplicitSolveOptions& options)
+{
+  const size_t n = b.size();
+  Vector x(n, 0.0);
+  const double target = std::max(options.relativeTolerance * norm(b), options.absoluteTolerance);
+  const size_t restart = std::max<size_t>(1, std::min(options.restart, n));
+
+  size_t iterations = 0;
+  while (true) {
+    Vector r = action(x);
+    gretl_assert_msg(r.size() == n, "the operator action returned a vector of the wrong size");
+    for (size_t i = 0; i < n; ++i) {
+      r[i] = b[i] - r[i];
+    }
+    double beta = norm(r);
+    if (beta <= target) {
+      return x;
+    }
+    gretl_assert_msg(iterations < options.maxIterations,
+                     "adjoint solve did not converge in " + std::to_string(options.maxIterations) +
+                         " iterations, residual norm " + std::to_string(beta));
+
+    // Arnoldi with modified Gram-Schmidt, the Hessenberg matrix kept upper triangular by Givens rotations
+    std::vector<Vector> V(restart + 1);
+    std::vector<Vector> H(restart, Vector(restart + 1, 0.0));  // H[k] is column k
+    Vector cs(restart, 0.0);
+    Vector sn(restart, 0.0);
+    Vector g(restart + 1, 0.0);
+    V[0] = std::move(r);
+    for (auto& v : V[0]) {
+      v /= beta;
+    }
+    g[0] = beta;
+
+    size_t k = 0;
+    while (k < restart && iterations < options.maxIterations) {
+      Vector w = action(V[k]);
+      auto& h = H[k];
+      for (size_t j = 0; j <= k; ++j) {
+        h[j] = dot(w, V[j]);
+        axpy(-h[j], V[j], w);
+      }
+      double subdiagonal = norm(w);
+      h[k + 1] = subdiagonal;
+
+      for (size_t j = 0; j < k; ++j) {
+        double rotated = cs[j] * h[j] + sn[j] * h[j + 1];
+        h[j + 1] = -sn[j] * h[j] + cs[j] * h[j + 1];
+        h[j] = rotated;
+      }
+      double denominator = std::hypot(h[k], h[k + 1]);
+      gretl_assert_msg(denominator > 0.0, "adjoint system is singular");
+      cs[k] = h[k] / denominator;
+      sn[k] = h[k + 1] / denominator;
+      h[k] = denominator;
+      h[k + 1] = 0.0;
+      g[k + 1] = -sn[k] * g[k];
+      g[k] = cs[k] * g[k];
+
+      ++k;
+      ++iterations;
+      if (std::abs(g[k]) <= target || subdiagonal == 0.0) {
+        break;
+      }
+      V[k] = std::move(w);
+      for (auto& v : V[k]) {
+        v /= subdiagonal;
+      }
+    }
+
+    // x += V y, with H y = g
+    Vector y(k, 0.0);
+    for (size_t i = k; i-- > 0;) {
+      double sum = g[i];
+      for (size_t j = i + 1; j < k; ++j) {
+        sum -= H[j][i] * y[j];
+      }
+      y[i] = sum / H[i][i];
+    }
+    for (size_t j = 0; j < k; ++j) {
+      axpy(y[j], V[j], x);
+    }
+  }
+}
+
+VectorState implicit_solve(const VectorState& guess, const VectorState& p, ImplicitSolver solve,
+                           ResidualJacobianTranspose dFdxT, ResidualJacobianTranspose dFdpT,
+                           const ImplicitSolveOptions& options)
+{
+  VectorState x = guess.clone({guess, p});
+
+  x.set_eval([solve](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    const Vector& Guess = upstreams[0].get<Vector>();
+    const Vector& P = upstreams[1].get<Vector>();
+    downstream.set(solve(P, Guess));
+  });
+
+  x.set_vjp([dFdxT, dFdpT, options](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    const Vector& X = downstream.get<Vector>();
+    const Vector& P = upstreams[1].get<Vector>();
+    const Vector& Xbar = downstream.get_dual<Vector, Vector>();
+
+    // (dF/dx)^T lambda = xbar, then pbar -= (dF/dp)^T lambda
+    Vector lambda = solve_linear_system([&](const Vector& v) { return dFdxT(X, P, v); }, Xbar, options);
+    Vector pContribution = dFdpT(X, P, lambda);
+    Vector& Pbar = upstreams[1].get_dual<Vector, Vector>();
+    gretl_assert_msg(pContribution.size() == Pbar.size(),
+                     "the parameter Jacobian action returned a vector of the wrong size");
+    axpy(-1.0, pContribution, Pbar);
+  });
+
+  return x.finalize();
+}
+
+}  // namespace gretl
@@ -0,0 +1,58 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file implicit_state.hpp
+ * @brief States defined implicitly by a residual equation F(x, p) = 0, differentiated through the implicit function
+ * theorem instead of taping the iterations of the solver.
+ */
+
+#pragma once
+
+#include <functional>
+#include "vector_state.hpp"
+
+namespace gretl {
+
+/// @brief Solves F(x, p) = 0 for x, given the parameters p and an initial guess, e.g. by Newton or fixed-point
+/// iterations
+using ImplicitSolver = std::function<Vector(const Vector& p, const Vector& guess)>;
+
+/// @brief Action of a transposed Jacobian of the residual at a solution, (dF/dx)^T v or (dF/dp)^T v
+using ResidualJacobianTranspose = std::function<Vector(const Vector& x, const Vector& p, const Vector& v)>;
+
+/// @brief Settings of the adjoint solves of an implicit state
+struct ImplicitSolveOptions {
+  double relativeTolerance = 1e-12;  ///< residual reduction of the adjoint solve, relative to its right hand side
+  double absoluteTolerance = 1e-14;  ///< residual norm below which the adjoint solve stops regardless
+  size_t maxIterations = 500;        ///< Krylov iterations before the adjoint solve is declared to have failed
+  size_t restart = 50;               ///< Krylov iterations between two restarts of GMRES
+};
+
+/// @brief Solve A y = b with restarted GMRES, given only the action of A, e.g. a transposed Jacobian for an adjoint
+/// solve.  Throws if the tolerances of the options are not met within maxIterations.
+/// @param action action of A
+/// @param b right hand side
+/// @param options tolerances and iteration limits
+Vector solve_linear_system(const std::function<Vector(const Vector&)>& action, const Vector& b,
+                           const ImplicitSolveOptions& options = {});
+
+/// @brief A state x defined implicitly by F(x, p) = 0, which stays a single step of the graph however many iterations
+/// the solver takes.  Its vjp applies the implicit function theorem: it solves the adjoint system
+/// (dF/dx)^T lambda = xbar with GMRES, using only the transposed Jacobian actions, and adds -(dF/dp)^T lambda into the
+/// dual of p.  The guess is an upstream so a previous solution can warm start the solver, but x does not depend on it,
+/// and its dual is left untouched.  Tangents and Hessian-vector products are not supported.
+/// @param guess initial guess of the solver
+/// @param p parameters of the residual
+/// @param solve solver of F(x, p) = 0, which should converge tightly for the gradient to be accurate
+/// @param dFdxT action of (dF/dx)^T at a solution
+/// @param dFdpT action of (dF/dp)^T at a solution
+/// @param options settings of the adjoint solve
+VectorState implicit_solve(const VectorState& guess, const VectorState& p, ImplicitSolver solve,
+                           ResidualJacobianTranspose dFdxT, ResidualJacobianTranspose dFdpT,
+                           const ImplicitSolveOptions& options = {});
+
+}  // namespace gretl
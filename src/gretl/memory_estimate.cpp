@@ -0,0 +1,190 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "memory_estimate.hpp"
+#include "state.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace gretl {
+
+namespace {
+
+constexpr size_t noBuffer = std::numeric_limits<size_t>::max();
+
+/// @brief Replays the liveness bookkeeping of the DataStore over one sweep, recording when each buffer is allocated
+/// and released instead of evaluating anything
+class SweepSimulator {
+ public:
+  SweepSimulator(const DataStore& store, CheckpointStrategy& strategy, SweepMemoryEstimate& estimate)
+      : store_(store),
+        strategy_(strategy),
+        estimate_(estimate),
+        size_(static_cast<Int>(store.states_.size())),
+        active_(size_, false),
+        usage_(size_, 0),
+        primal_(size_, noBuffer),
+        dual_(size_, noBuffer)
+  {
+  }
+
+  void run()
+  {
+    // as after reset(): only the persistent steps are in memory
+    for (Int step = 0; step < size_; ++step) {
+      if (store_.is_persistent(step)) {
+        active_[step] = true;
+        estimate_.persistentBytes += bytes(step);
+        strategy_.add_checkpoint_and_get_index_to_remove(step, true);
+      }
+    }
+
+    // reset_for_backprop, and seeding the objective
+    recompute_from(static_cast<Int>(strategy_.last_checkpoint_step()), size_ - 1);
+    dual_[size_ - 1] = allocate(size_ - 1, true);
+
+    // back_prop
+    strategy_.erase_step(size_ - 1);
+    for (Int step = size_; step-- > 0;) {
+      if (!store_.is_persistent(step)) {
+        if (store_.requires_vjp_[step]) {
+          recompute_from(static_cast<Int>(strategy_.last_checkpoint_step()), step - 1);
+          for (Int upstream : store_.upstreamSteps_[step]) {
+            if (dual_[upstream] == noBuffer) {
+              dual_[upstream] = allocate(upstream, true);
+            }
+          }
+        }
+        clear_usage(step);
+        strategy_.erase_step(step - 1);
+      }
+      estimate_.reverseLiveBytes.push_back(liveBytes_);
+    }
+
+    // the duals of the persistent steps are the results of the sweep
+    for (size_t& buffer : dual_) {
+      release(buffer);
+    }
+  }
+
+ private:
+  /// @brief size of a step's buffers
+  size_t bytes(Int step) const
+  {
+    return store_.is_persistent(step) ? store_.primal_bytes(step) : store_.evaluatedPrimalBytes_[step];
+  }
+
+  size_t allocate(Int step, bool dual)
+  {
+    size_t size = bytes(step) * (dual ? store_.num_dual_seeds() : 1);
+    estimate_.buffers.push_back(SweepBuffer{step, dual, size, event_++, noBuffer});
+    liveBytes_ += size;
+    estimate_.peakBytes = std::max(estimate_.peakBytes, liveBytes_);
+    return estimate_.buffers.size() - 1;
+  }
+
+  void release(size_t& buffer)
+  {
+    if (buffer != noBuffer) {
+      estimate_.buffers[buffer].end = event_++;
+      liveBytes_ -= estimate_.buffers[buffer].bytes;
+      buffer = noBuffer;
+    }
+  }
+
+  /// @brief as for_each_active_upstream in data_store.cpp
+  template <typename Func>
+  void for_each_active_upstream(Int step, const Func& func) const
+  {
+    if (!store_.live_cut_checkpoints()) {
+      for (Int upstream : store_.upstreamSteps_[step]) {
+        if (!store_.is_persistent(upstream)) {
+          func(upstream);
+        }
+      }
+    }
+    for (Int upstream : store_.passthroughs_[step]) {
+      func(upstream);
+    }
+  }
+
+  void try_to_free(Int step)
+  {
+    if (!store_.is_persistent(step) && usage_[step] == 0 && !active_[step]) {
+      release(primal_[step]);
+      release(dual_[step]);
+    }
+  }
+
+  void release_upstreams(Int step)
+  {
+    for_each_active_upstream(step, [&](Int upstream) {
+      usage_[upstream]--;
+      try_to_free(upstream);
+    });
+  }
+
+  void evict(Int step)
+  {
+    active_[step] = false;
+    try_to_free(step);
+    release_upstreams(step);
+  }
+
+  void clear_usage(Int step)
+  {
+    active_[step] = false;
+    usage_[step] = 0;
+    release(primal_[step]);
+    try_to_free(step);
+    release_upstreams(step);
+  }
+
+  void recompute_from(Int checkpoint, Int stepIndex)
+  {
+    for (Int step = checkpoint + 1; step <= stepIndex; ++step) {
+      for_each_active_upstream(step, [&](Int upstream) { usage_[upstream]++; });
+      active_[step] = true;
+      if (store_.is_persistent(step)) {
+        continue;
+      }
+      if (primal_[step] == noBuffer) {
+        primal_[step] = allocate(step, false);
+        estimate_.recomputations++;
+      }
+      size_t evicted = strategy_.add_checkpoint_and_get_index_to_remove(step);
+      if (CheckpointStrategy::valid_checkpoint_index(evicted)) {
+        evict(static_cast<Int>(evicted));
+      }
+    }
+  }
+
+  const DataStore& store_;
+  CheckpointStrategy& strategy_;
+  SweepMemoryEstimate& estimate_;
+  Int size_;
+  std::vector<bool> active_;
+  std::vector<Int> usage_;
+  std::vector<size_t> primal_;  ///< live primal buffer of each step
+  std::vector<size_t> dual_;    ///< live dual buffer of each step
+  size_t event_ = 0;
+  size_t liveBytes_ = 0;
+};
+
+}  // namespace
+
+SweepMemoryEstimate estimate_sweep_memory(const DataStore& store, CheckpointStrategy& strategy)
+{
+  gretl_assert_msg(!store.stillConstructingGraph_, "the graph must be finalized before estimating its memory");
+  gretl_assert_msg(!store.streaming() && !store.states_.empty(), "there is no recorded graph to estimate");
+  gretl_assert_msg(strategy.size() == 0, "estimate_sweep_memory expects a freshly constructed checkpoint strategy");
+
+  SweepMemoryEstimate estimate;
+  SweepSimulator(store, strategy, estimate).run();
+  return estimate;
+}
+
+}  // namespace gretl
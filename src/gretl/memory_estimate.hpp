@@ -0,0 +1,50 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file memory_estimate.hpp
+ * @brief Estimates the primal and dual memory of a repeated reverse sweep of a finalized graph, and its peak, before
+ * running it.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "checkpoint_strategy.hpp"
+#include "data_store.hpp"
+
+namespace gretl {
+
+/// @brief A primal or dual buffer and the part of the sweep during which it is allocated
+struct SweepBuffer {
+  Int step;      ///< step the buffer belongs to
+  bool dual;     ///< dual (including every dual seed) rather than primal
+  size_t bytes;  ///< size of the buffer
+  size_t begin;  ///< event at which it is allocated
+  size_t end;    ///< event at which it is released
+};
+
+/// @brief Result of estimate_sweep_memory
+struct SweepMemoryEstimate {
+  std::vector<SweepBuffer> buffers;      ///< non-persistent primals and all duals, in allocation order
+  std::vector<size_t> reverseLiveBytes;  ///< bytes of the buffers live after each step of back_prop, last step first
+  size_t persistentBytes = 0;            ///< primals of the persistent steps, held throughout
+  size_t peakBytes = 0;                  ///< largest bytes of the buffers live at once
+  size_t recomputations = 0;             ///< forward evaluations of the sweep, reset_for_backprop included
+};
+
+/// @brief Estimate the memory of a repeated sweep of a finalized graph, i.e. store.reset(), store.reset_for_backprop(),
+/// seeding the dual of the last step, then store.back_prop(), without evaluating anything.  The sweep is simulated
+/// from the graph topology (upstreamSteps_ and passthroughs_) with the same liveness rules as the DataStore, driving a
+/// freshly constructed strategy of the same kind and budget as the store's, which is given the persistent steps first.
+/// This is an estimate only: the DataStore still allocates every primal and dual on the heap when the sweep runs.
+///
+/// Buffer sizes are the primal_bytes of each step when last evaluated, and a dual is assumed as large as its primal.
+/// Handles held outside the graph, memory monitors and checkpoint compression are not modeled.
+SweepMemoryEstimate estimate_sweep_memory(const DataStore& store, CheckpointStrategy& strategy);
+
+}  // namespace gretl
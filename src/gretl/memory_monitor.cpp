@@ -0,0 +1,161 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "memory_monitor.hpp"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "checkpoint.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRETL_HAVE_SYSCONF
+#include <unistd.h>
+#endif
+
+namespace gretl {
+
+namespace {
+
+/// cgroup v1 reports an effectively unlimited limit as a huge page-aligned number
+constexpr size_t unlimitedCgroupV1 = size_t{1} << 60;
+
+/// read a single number of bytes from a file, false if the file is missing, "max" or not a number
+bool read_bytes(const std::string& path, size_t& bytes)
+{
+  std::ifstream in(path);
+  std::string value;
+  if (!(in >> value) || value == "max") {
+    return false;
+  }
+  try {
+    bytes = static_cast<size_t>(std::stoull(value));
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
+/// the path of this process's cgroup in the v2 hierarchy ("0::/path"), or in the v1 hierarchy of the memory controller
+/// ("N:controllers:/path" with memory among the controllers), without a trailing slash
+bool find_cgroup_path(const std::string& procCgroupFile, bool v2, std::string& path)
+{
+  std::ifstream in(procCgroupFile);
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t first = line.find(':');
+    size_t second = first == std::string::npos ? std::string::npos : line.find(':', first + 1);
+    if (second == std::string::npos) {
+      continue;
+    }
+    std::string controllers = line.substr(first + 1, second - first - 1);
+    bool matches = v2 ? line.compare(0, first, "0") == 0 && controllers.empty()
+                      : ("," + controllers + ",").find(",memory,") != std::string::npos;
+    if (matches) {
+      path = line.substr(second + 1);
+      while (!path.empty() && path.back() == '/') {
+        path.pop_back();
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+/// the limit and usage of the nearest cgroup with a limit, from the given one up to the root of the hierarchy, as a job
+/// scheduler may limit the job's cgroup and not the cgroup of each of its steps
+bool read_nearest_limit(const std::string& hierarchy, std::string path, const char* limitFile, const char* usageFile,
+                        size_t unlimited, MemoryReading& reading)
+{
+  while (true) {
+    std::string directory = hierarchy + path + "/";
+    size_t limit = 0;
+    if (read_bytes(directory + limitFile, limit) && limit < unlimited &&
+        read_bytes(directory + usageFile, reading.used)) {
+      reading.limit = limit;
+      return true;
+    }
+    if (path.empty()) {
+      return false;
+    }
+    path.erase(path.find_last_of('/'));
+  }
+}
+
+}  // namespace
+
+MemoryReading read_cgroup_memory(const std::string& procCgroupFile, const std::string& cgroupRoot)
+{
+  MemoryReading reading;
+  std::string path;
+  if (find_cgroup_path(procCgroupFile, true, path) &&
+      read_nearest_limit(cgroupRoot, path, "memory.max", "memory.current", std::numeric_limits<size_t>::max(),
+                         reading)) {
+    return reading;
+  }
+  if (find_cgroup_path(procCgroupFile, false, path) &&
+      read_nearest_limit(cgroupRoot + "/memory", path, "memory.limit_in_bytes", "memory.usage_in_bytes",
+                         unlimitedCgroupV1, reading)) {
+    return reading;
+  }
+  return MemoryReading{};
+}
+
+MemoryReading read_process_memory()
+{
+  MemoryReading reading = read_cgroup_memory();
+  if (reading.limit > 0) {
+    return reading;
+  }
+
+#ifdef GRETL_HAVE_SYSCONF
+  long pageSize = ::sysconf(_SC_PAGESIZE);
+  long physicalPages = ::sysconf(_SC_PHYS_PAGES);
+  std::ifstream statm("/proc/self/statm");
+  size_t totalPages = 0;
+  size_t residentPages = 0;
+  if (pageSize > 0 && physicalPages > 0 && statm >> totalPages >> residentPages) {
+    reading.limit = static_cast<size_t>(physicalPages) * static_cast<size_t>(pageSize);
+    reading.used = residentPages * static_cast<size_t>(pageSize);
+    return reading;
+  }
+#endif
+  return MemoryReading{};
+}
+
+MemoryMonitor::MemoryMonitor(Options options, std::function<MemoryReading()> source)
+    : options_(options), source_(std::move(source))
+{
+  gretl_assert_msg(source_, "a memory monitor needs a memory source");
+  gretl_assert_msg(options_.targetFraction > 0.0 && options_.targetFraction <= 1.0,
+                   "the target fraction of a memory monitor must be in (0, 1]");
+  gretl_assert_msg(options_.minCapacity >= 1, "a memory monitor must leave at least one checkpoint");
+  gretl_assert_msg(options_.interval >= 1, "a memory monitor must poll at least every store");
+}
+
+size_t MemoryMonitor::recommend_capacity(size_t heldCheckpoints, size_t bytesPerCheckpoint, size_t maxCapacity) const
+{
+  size_t upper = std::max(options_.maxCapacity ? options_.maxCapacity : maxCapacity, options_.minCapacity);
+  lastReading_ = source_();
+  if (lastReading_.limit == 0 || bytesPerCheckpoint == 0) {
+    return upper;
+  }
+
+  double target = options_.targetFraction * static_cast<double>(lastReading_.limit);
+  double headroom = (target - static_cast<double>(lastReading_.used)) / static_cast<double>(bytesPerCheckpoint);
+  double recommended = static_cast<double>(heldCheckpoints) + headroom;
+  if (recommended <= static_cast<double>(options_.minCapacity)) {
+    return options_.minCapacity;
+  }
+  if (recommended >= static_cast<double>(upper)) {
+    return upper;
+  }
+  return static_cast<size_t>(recommended);
+}
+
+}  // namespace gretl
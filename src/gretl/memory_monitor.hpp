@@ -0,0 +1,84 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file memory_monitor.hpp
+ * @brief Adjusting the checkpoint budget of a DataStore to the memory available, so long runs recompute more instead of
+ * running out of memory.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace gretl {
+
+/// @brief A reading of the memory available to the process
+struct MemoryReading {
+  size_t limit = 0;  ///< bytes the process may use, 0 if unknown
+  size_t used = 0;   ///< bytes currently used
+};
+
+/// @brief Read the memory limit and usage of the cgroup of this process, as enforced by the kernel's out of memory
+/// killer.  The cgroup is found in procCgroupFile, from its v2 entry (memory.max and memory.current) or else its v1
+/// memory controller entry (memory.limit_in_bytes and memory.usage_in_bytes), and the reading is that of the nearest
+/// cgroup with a limit, from the process's own up to the root of the hierarchy, e.g. the job's cgroup when a scheduler
+/// limits the job and not each of its steps.
+/// @param procCgroupFile cgroup membership of the process
+/// @param cgroupRoot mount point of the cgroup hierarchies, the v1 memory controller being under its memory directory
+/// @return the reading, with a limit of 0 if no cgroup in the hierarchy is limited
+MemoryReading read_cgroup_memory(const std::string& procCgroupFile = "/proc/self/cgroup",
+                                 const std::string& cgroupRoot = "/sys/fs/cgroup");
+
+/// @brief Read the memory limit and usage of this process.  The limit is that of its cgroup with the cgroup's usage,
+/// see read_cgroup_memory.  Without a cgroup limit, it is the physical memory with the resident set size of the
+/// process.  On platforms where neither is available, the reading is all zeros.
+MemoryReading read_process_memory();
+
+/// @brief Recommends a checkpoint budget from the memory available, see DataStore::set_memory_monitor
+class MemoryMonitor {
+ public:
+  /// @brief Settings of a monitor
+  struct Options {
+    /// @brief fraction of the limit the process should stay below, leaving room for what is allocated between polls
+    double targetFraction = 0.8;
+    /// @brief smallest budget recommended, however little memory is left
+    size_t minCapacity = 1;
+    /// @brief largest budget recommended, 0 for the budget of the checkpoint strategy when the monitor is attached
+    size_t maxCapacity = 0;
+    /// @brief number of checkpoint stores between two polls of the memory source
+    size_t interval = 16;
+  };
+
+  /// @brief Construct with the settings and where memory is read from, by default read_process_memory
+  explicit MemoryMonitor(Options options, std::function<MemoryReading()> source = read_process_memory);
+
+  /// @brief Construct with default settings, reading the memory of this process
+  MemoryMonitor() : MemoryMonitor(Options{}) {}
+
+  /// @brief Settings of this monitor
+  const Options& options() const { return options_; }
+
+  /// @brief Read the memory source and recommend a budget of non-persistent checkpoints: those held now plus as many
+  /// more of the given size as fit below the target, or fewer when above it.  Clamped to [minCapacity, maxCapacity],
+  /// and maxCapacity when the limit is unknown.
+  /// @param heldCheckpoints number of non-persistent checkpoints currently held
+  /// @param bytesPerCheckpoint estimated size of one checkpoint
+  /// @param maxCapacity largest budget, used when the option is 0
+  size_t recommend_capacity(size_t heldCheckpoints, size_t bytesPerCheckpoint, size_t maxCapacity) const;
+
+  /// @brief The last reading taken
+  const MemoryReading& last_reading() const { return lastReading_; }
+
+ private:
+  Options options_;                        ///< settings
+  std::function<MemoryReading()> source_;  ///< memory source
+  mutable MemoryReading lastReading_;      ///< last reading taken
+};
+
+}  // namespace gretl
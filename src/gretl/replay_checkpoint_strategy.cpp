@@ -0,0 +1,251 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "replay_checkpoint_strategy.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace gretl {
+
+ReplayCheckpointStrategy::ReplayCheckpointStrategy(std::unique_ptr<CheckpointStrategy> strategy)
+    : strategy_(std::move(strategy))
+{
+  assert(strategy_);
+}
+
+bool ReplayCheckpointStrategy::next_action_matches(Action::Kind kind, size_t step)
+{
+  if (cursor_ < schedule_.size() && schedule_[cursor_].kind == kind && schedule_[cursor_].step == step) {
+    ++cursor_;
+    return true;
+  }
+  return false;
+}
+
+void ReplayCheckpointStrategy::resync()
+{
+  // the wrapped strategy was reset at the start of this cycle and has not been consulted since
+  recording_.assign(schedule_.begin(), schedule_.begin() + static_cast<std::ptrdiff_t>(cursor_));
+  for (const auto& action : recording_) {
+    if (action.kind == Action::Kind::Store) {
+      strategy_->add_checkpoint_and_get_index_to_remove(action.step);
+    } else if (action.kind == Action::Kind::Erase) {
+      strategy_->erase_step(action.step);
+    }
+  }
+  replaying_ = false;
+}
+
+void ReplayCheckpointStrategy::record(const Action& action) { recording_.push_back(action); }
+
+void ReplayCheckpointStrategy::apply_store(size_t step, size_t evicted)
+{
+  stored_.insert(step);
+  if (valid_checkpoint_index(evicted)) {
+    stored_.erase(evicted);
+  }
+  metrics_.stores++;
+  if (valid_checkpoint_index(evicted)) {
+    metrics_.evictions++;
+  }
+}
+
+size_t ReplayCheckpointStrategy::add_checkpoint_and_get_index_to_remove(size_t step, bool persistent)
+{
+  if (persistent) {
+    // persistent checkpoints outlive reset(), so they are not part of any recorded cycle
+    if (replaying_) {
+      resync();
+    }
+    size_t evicted = strategy_->add_checkpoint_and_get_index_to_remove(step, true);
+    persistentSteps_.insert(step);
+    metrics_.stores++;
+    if (valid_checkpoint_index(evicted)) {
+      stored_.erase(evicted);
+      metrics_.evictions++;
+    }
+    return evicted;
+  }
+
+  size_t evicted = invalidCheckpointIndex;
+  if (replaying_ && next_action_matches(Action::Kind::Store, step)) {
+    evicted = schedule_[cursor_ - 1].evicted;
+  } else {
+    if (replaying_) {
+      resync();
+    }
+    evicted = strategy_->add_checkpoint_and_get_index_to_remove(step);
+    record({Action::Kind::Store, step, evicted});
+  }
+  apply_store(step, evicted);
+  return evicted;
+}
+
+size_t ReplayCheckpointStrategy::last_checkpoint_step() const
+{
+  if (!replaying_) {
+    return strategy_->last_checkpoint_step();
+  }
+  // replay is only entered when every stored step is above every persistent step, so the latest stored step is the
+  // last checkpoint for any strategy
+  assert(!stored_.empty() || !persistentSteps_.empty());
+  return stored_.empty() ? *persistentSteps_.rbegin() : *stored_.rbegin();
+}
+
+bool ReplayCheckpointStrategy::erase_step(size_t stepIndex)
+{
+  if (replaying_ && next_action_matches(Action::Kind::Erase, stepIndex)) {
+    return stored_.erase(stepIndex) > 0;
+  }
+  if (replaying_) {
+    resync();
+  }
+  bool erased = strategy_->erase_step(stepIndex);
+  if (erased) {
+    stored_.erase(stepIndex);
+  }
+  record({Action::Kind::Erase, stepIndex, invalidCheckpointIndex});
+  return erased;
+}
+
+bool ReplayCheckpointStrategy::contains_step(size_t stepIndex) const
+{
+  return stored_.count(stepIndex) > 0 || persistentSteps_.count(stepIndex) > 0;
+}
+
+void ReplayCheckpointStrategy::reset()
+{
+  if (!replaying_) {
+    schedule_ = std::move(recording_);
+  }
+  recording_.clear();
+  cursor_ = 0;
+  strategy_->reset();
+  stored_.clear();
+
+  // only replay when all stored steps come after the persistent ones, which makes last_checkpoint_step unambiguous
+  size_t firstStored = invalidCheckpointIndex;
+  for (const auto& action : schedule_) {
+    if (action.kind == Action::Kind::Store) {
+      firstStored = std::min(firstStored, action.step);
+    }
+  }
+  replaying_ = !schedule_.empty() && (persistentSteps_.empty() || *persistentSteps_.rbegin() < firstStored);
+}
+
+void ReplayCheckpointStrategy::clear_schedule()
+{
+  if (replaying_) {
+    resync();
+  }
+  schedule_.clear();
+  cursor_ = 0;
+}
+
+size_t ReplayCheckpointStrategy::capacity() const { return strategy_->capacity(); }
+
+std::vector<size_t> ReplayCheckpointStrategy::set_capacity(size_t maxStates)
+{
+  if (replaying_) {
+    resync();
+  }
+  std::vector<size_t> evicted = strategy_->set_capacity(maxStates);
+  for (size_t step : evicted) {
+    stored_.erase(step);
+  }
+  metrics_.evictions += evicted.size();
+  // neither the last schedule nor this cycle's decisions so far hold for the new capacity.  What is recorded from here
+  // on starts mid-cycle, so the next cycle will not match it and records afresh.
+  schedule_.clear();
+  recording_.clear();
+  cursor_ = 0;
+  return evicted;
+}
+
+bool ReplayCheckpointStrategy::supports_renumbering() const { return strategy_->supports_renumbering(); }
+
+void ReplayCheckpointStrategy::renumber_steps(const std::vector<size_t>& newSteps)
+{
+  if (replaying_) {
+    resync();
+  }
+  strategy_->renumber_steps(newSteps);
+  auto renumber = [&](std::set<size_t>& steps) {
+    std::set<size_t> renumbered;
+    for (size_t step : steps) {
+      if (valid_checkpoint_index(newSteps[step])) {
+        renumbered.insert(newSteps[step]);
+      }
+    }
+    steps = std::move(renumbered);
+  };
+  renumber(stored_);
+  renumber(persistentSteps_);
+  // the recorded steps no longer exist, so recording starts over as after set_capacity
+  schedule_.clear();
+  recording_.clear();
+  cursor_ = 0;
+}
+
+void ReplayCheckpointStrategy::make_persistent(size_t step)
+{
+  // persistent checkpoints outlive reset(), so they are not part of any recorded cycle
+  if (replaying_) {
+    resync();
+  }
+  strategy_->make_persistent(step);
+  stored_.erase(step);
+  persistentSteps_.insert(step);
+}
+
+size_t ReplayCheckpointStrategy::size() const { return stored_.size() + persistentSteps_.size(); }
+
+void ReplayCheckpointStrategy::print(std::ostream& os) const
+{
+  os << "CHECKPOINTS (Replay): " << (replaying_ ? "replaying" : "recording") << ", schedule position " << cursor_
+     << " of " << schedule_.size() << std::endl;
+  if (!replaying_) {
+    strategy_->print(os);
+    return;
+  }
+  for (size_t s : stored_) {
+    os << "   step=" << s << "\n";
+  }
+  for (size_t s : persistentSteps_) {
+    os << "   step=" << s << " (persistent)\n";
+  }
+}
+
+CheckpointMetrics ReplayCheckpointStrategy::metrics() const { return metrics_; }
+
+void ReplayCheckpointStrategy::reset_metrics() { metrics_ = {}; }
+
+void ReplayCheckpointStrategy::record_recomputation()
+{
+  metrics_.recomputations++;
+  if (replaying_ && next_action_matches(Action::Kind::Recompute, invalidCheckpointIndex)) {
+    return;
+  }
+  if (replaying_) {
+    resync();
+  }
+  record({Action::Kind::Recompute, invalidCheckpointIndex, invalidCheckpointIndex});
+}
+
+void ReplayCheckpointStrategy::set_eviction_oracle(EvictionOracle oracle)
+{
+  if (replaying_) {
+    resync();
+  }
+  strategy_->set_eviction_oracle(std::move(oracle));
+  // the recorded evictions were chosen with the previous oracle, so recording starts over as after set_capacity
+  schedule_.clear();
+  recording_.clear();
+  cursor_ = 0;
+}
+
+}  // namespace gretl
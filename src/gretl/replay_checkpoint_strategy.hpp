@@ -0,0 +1,103 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file replay_checkpoint_strategy.hpp
+ * @brief Records the checkpoint schedule of one sweep and replays it on subsequent sweeps.
+ */
+
+#pragma once
+
+#include "checkpoint_strategy.hpp"
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace gretl {
+
+/// @brief Wraps another checkpoint strategy, recording the sequence of actions it takes between two calls to reset()
+/// (one forward + reverse sweep) and replaying that sequence on later sweeps without consulting the wrapped strategy.
+///
+/// DataStore calls reset() before every repeated sweep of the same graph (reset + reset_for_backprop + back_prop), and
+/// the eviction decisions of a deterministic strategy only depend on the sequence of calls it receives.  So once a
+/// cycle is recorded, every later cycle issuing the same calls can be answered directly from the recording.  Each
+/// incoming call is checked against the recording; on the first mismatch (e.g. after reset_graph or a change in graph
+/// topology), the wrapped strategy is brought up to date by feeding it the matched prefix and recording starts over.
+class ReplayCheckpointStrategy final : public CheckpointStrategy {
+ public:
+  /// @brief A single recorded checkpoint action.
+  struct Action {
+    /// @brief kind of action
+    enum class Kind
+    {
+      Store,     ///< a checkpoint was added at step, possibly evicting another step
+      Erase,     ///< the checkpoint at step was removed (reverse sweep passed it)
+      Recompute  ///< a forward recomputation was recorded
+    };
+    Kind kind;                                ///< kind
+    size_t step = invalidCheckpointIndex;     ///< step stored or erased
+    size_t evicted = invalidCheckpointIndex;  ///< step evicted by a store, if any
+  };
+
+  /// @brief Construct by wrapping the strategy whose decisions are to be recorded.
+  explicit ReplayCheckpointStrategy(std::unique_ptr<CheckpointStrategy> strategy);
+
+  size_t add_checkpoint_and_get_index_to_remove(size_t step, bool persistent = false) override;
+  size_t last_checkpoint_step() const override;
+  bool erase_step(size_t stepIndex) override;
+  bool contains_step(size_t stepIndex) const override;
+  void reset() override;
+  size_t capacity() const override;
+  std::vector<size_t> set_capacity(size_t maxStates) override;
+  bool supports_renumbering() const override;
+  void renumber_steps(const std::vector<size_t>& newSteps) override;
+  void make_persistent(size_t step) override;
+  size_t size() const override;
+  void print(std::ostream& os) const override;
+  CheckpointMetrics metrics() const override;
+  void reset_metrics() override;
+  void record_recomputation() override;
+  void set_eviction_oracle(EvictionOracle oracle) override;
+
+  /// @brief True when actions are currently being served from a recorded schedule.
+  bool replaying() const { return replaying_; }
+
+  /// @brief The most recently completed recorded schedule.  Steps which will be recomputed, and when, can be read from
+  /// it ahead of time, e.g. to plan prefetching.
+  const std::vector<Action>& schedule() const { return schedule_; }
+
+  /// @brief Position of the next action within schedule() while replaying.
+  size_t schedule_position() const { return cursor_; }
+
+  /// @brief Drop any recorded schedule and go back to recording.
+  void clear_schedule();
+
+ private:
+  /// @brief Check if the next recorded action matches, and if so advance past it.
+  bool next_action_matches(Action::Kind kind, size_t step);
+
+  /// @brief Leave replay mode: bring the wrapped strategy up to date with the actions replayed so far, and continue
+  /// recording from there.
+  void resync();
+
+  /// @brief Record an action while not replaying.
+  void record(const Action& action);
+
+  /// @brief Update the stored steps after a store which evicted a step.
+  void apply_store(size_t step, size_t evicted);
+
+  std::unique_ptr<CheckpointStrategy> strategy_;  ///< wrapped strategy
+  std::vector<Action> schedule_;                  ///< last complete schedule
+  std::vector<Action> recording_;                 ///< schedule being recorded for the current cycle
+  size_t cursor_ = 0;                             ///< position in schedule_ while replaying
+  bool replaying_ = false;                        ///< replay mode flag
+
+  std::set<size_t> stored_;           ///< non-persistent steps currently checkpointed
+  std::set<size_t> persistentSteps_;  ///< persistent steps
+  CheckpointMetrics metrics_;         ///< metrics, counted identically to the built-in strategies
+};
+
+}  // namespace gretl
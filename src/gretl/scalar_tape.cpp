@@ -0,0 +1,393 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "scalar_tape.hpp"
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace gretl {
+
+/// @brief statement opcodes
+enum class ScalarOp : std::uint8_t
+{
+  Input,     ///< read from an upstream
+  Axpby,     ///< c0 * x + c1 * y
+  Axpb,      ///< c0 * x + c1
+  Multiply,  ///< x * y
+  Divide     ///< c0 / x
+};
+
+struct ScalarTape::Data {
+  /// @brief where an input statement is read from
+  struct Input {
+    std::uint32_t statement;  ///< input statement
+    std::uint32_t upstream;   ///< upstream of the step
+    std::uint32_t component;  ///< entry of a VectorState upstream
+  };
+
+  std::vector<ScalarOp> ops;            ///< opcode of each statement
+  std::vector<std::uint32_t> operands;  ///< two operand statements per statement
+  std::vector<double> constants;        ///< two constants per statement
+  std::vector<double> values;           ///< value of each statement
+  std::vector<double> partials;         ///< partial derivative with respect to each operand
+  std::vector<Input> inputs;            ///< input statements
+  std::vector<bool> upstreamIsVector;   ///< type of each upstream, VectorState or State<double>
+  std::vector<std::uint32_t> outputs;   ///< output statements
+  bool fresh = true;                    ///< values are those of the recording, not yet used by an evaluation
+
+  std::vector<double> adjoints;  ///< scratch space of the reverse sweeps
+  std::vector<double> tangents;  ///< scratch space of the tangent sweeps
+
+  std::uint32_t record(ScalarOp op, std::uint32_t x, std::uint32_t y, double c0, double c1, double value, double px,
+                       double py)
+  {
+    gretl_assert_msg(ops.size() < std::numeric_limits<std::uint32_t>::max(), "too many statements on a scalar tape");
+    ops.push_back(op);
+    operands.push_back(x);
+    operands.push_back(y);
+    constants.push_back(c0);
+    constants.push_back(c1);
+    values.push_back(value);
+    partials.push_back(px);
+    partials.push_back(py);
+    return static_cast<std::uint32_t>(ops.size() - 1);
+  }
+
+  /// @brief read the inputs from the upstreams, returns true if any changed since the last sweep
+  bool load_inputs(const UpstreamStates& upstreams)
+  {
+    bool changed = false;
+    for (const auto& input : inputs) {
+      double value = upstreamIsVector[input.upstream] ? upstreams[input.upstream].get<Vector>()[input.component]
+                                                      : upstreams[input.upstream].get<double>();
+      changed = changed || value != values[input.statement];
+      values[input.statement] = value;
+    }
+    return changed;
+  }
+
+  /// @brief replay the statements, updating values and the partials which depend on them
+  void forward()
+  {
+    const size_t size = ops.size();
+    for (size_t i = 0; i < size; ++i) {
+      const std::uint32_t* o = &operands[2 * i];
+      const double* c = &constants[2 * i];
+      switch (ops[i]) {
+        case ScalarOp::Input:
+          break;
+        case ScalarOp::Axpby:
+          values[i] = c[0] * values[o[0]] + c[1] * values[o[1]];
+          break;
+        case ScalarOp::Axpb:
+          values[i] = c[0] * values[o[0]] + c[1];
+          break;
+        case ScalarOp::Multiply:
+          values[i] = values[o[0]] * values[o[1]];
+          partials[2 * i] = values[o[1]];
+          partials[2 * i + 1] = values[o[0]];
+          break;
+        case ScalarOp::Divide:
+          values[i] = c[0] / values[o[0]];
+          partials[2 * i] = -values[i] / values[o[0]];
+          break;
+      }
+    }
+  }
+
+  /// @brief bring values up to date with the upstreams before a derivative sweep
+  void update(const UpstreamStates& upstreams)
+  {
+    if (load_inputs(upstreams)) {
+      forward();
+    }
+  }
+
+  /// @brief number of operands of a statement
+  static int arity(ScalarOp op)
+  {
+    return op == ScalarOp::Input ? 0 : (op == ScalarOp::Axpby || op == ScalarOp::Multiply) ? 2 : 1;
+  }
+
+  /// @brief propagate the tangents of the inputs to every statement
+  void forward_tangents(const UpstreamStates& upstreams)
+  {
+    tangents.assign(ops.size(), 0.0);
+    for (const auto& input : inputs) {
+      tangents[input.statement] = upstreamIsVector[input.upstream]
+                                      ? upstreams[input.upstream].get_tangent<Vector, Vector>()[input.component]
+                                      : upstreams[input.upstream].get_tangent<double, double>();
+    }
+    const size_t size = ops.size();
+    for (size_t i = 0; i < size; ++i) {
+      int n = arity(ops[i]);
+      const std::uint32_t* o = &operands[2 * i];
+      const double* p = &partials[2 * i];
+      if (n == 1) {
+        tangents[i] = p[0] * tangents[o[0]];
+      } else if (n == 2) {
+        tangents[i] = p[0] * tangents[o[0]] + p[1] * tangents[o[1]];
+      }
+    }
+  }
+
+  /// @brief add the adjoints of the input statements into the upstream duals (or dual tangents)
+  template <bool dualTangent>
+  void accumulate_inputs(UpstreamStates& upstreams, const std::vector<double>& inputAdjoints) const
+  {
+    for (const auto& input : inputs) {
+      double adjoint = inputAdjoints[input.statement];
+      if (upstreamIsVector[input.upstream]) {
+        auto& dual = dualTangent ? upstreams[input.upstream].get_dual_tangent<Vector, Vector>()
+                                 : upstreams[input.upstream].get_dual<Vector, Vector>();
+        dual[input.component] += adjoint;
+      } else {
+        auto& dual = dualTangent ? upstreams[input.upstream].get_dual_tangent<double, double>()
+                                 : upstreams[input.upstream].get_dual<double, double>();
+        dual += adjoint;
+      }
+    }
+  }
+};
+
+namespace {
+
+/// @brief read the output values of a tape
+template <typename T>
+T output_values(const ScalarTape::Data& data);
+
+template <>
+double output_values<double>(const ScalarTape::Data& data)
+{
+  return data.values[data.outputs[0]];
+}
+
+template <>
+Vector output_values<Vector>(const ScalarTape::Data& data)
+{
+  Vector outputs(data.outputs.size());
+  for (size_t k = 0; k < outputs.size(); ++k) {
+    outputs[k] = data.values[data.outputs[k]];
+  }
+  return outputs;
+}
+
+/// @brief entry k of a downstream dual
+inline double entry(double dual, size_t) { return dual; }
+inline double entry(const Vector& dual, size_t k) { return dual[k]; }
+
+/// @brief set the eval, vjp, jvp and hvp of the step computing a tape's outputs
+template <typename T>
+State<T> finalize_tape(State<T> z, std::shared_ptr<ScalarTape::Data> data)
+{
+  using Data = ScalarTape::Data;
+
+  z.set_eval([data](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    // the recording already evaluated the statements once
+    if (!data->fresh) {
+      data->load_inputs(upstreams);
+      data->forward();
+    }
+    data->fresh = false;
+    downstream.set(output_values<T>(*data));
+  });
+
+  z.set_vjp([data](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    data->update(upstreams);
+    const T& zDual = downstream.get_dual<T, T>();
+    auto& adjoints = data->adjoints;
+    adjoints.assign(data->ops.size(), 0.0);
+    for (size_t k = 0; k < data->outputs.size(); ++k) {
+      adjoints[data->outputs[k]] += entry(zDual, k);
+    }
+    for (size_t i = data->ops.size(); i-- > 0;) {
+      double adjoint = adjoints[i];
+      int n = Data::arity(data->ops[i]);
+      if (n == 0 || adjoint == 0.0) continue;
+      const std::uint32_t* o = &data->operands[2 * i];
+      const double* p = &data->partials[2 * i];
+      adjoints[o[0]] += p[0] * adjoint;
+      if (n == 2) {
+        adjoints[o[1]] += p[1] * adjoint;
+      }
+    }
+    data->template accumulate_inputs<false>(upstreams, adjoints);
+  });
+
+  z.set_jvp([data](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    data->update(upstreams);
+    data->forward_tangents(upstreams);
+    T zTangent = output_values<T>(*data);
+    if constexpr (std::is_same_v<T, double>) {
+      zTangent = data->tangents[data->outputs[0]];
+    } else {
+      for (size_t k = 0; k < zTangent.size(); ++k) {
+        zTangent[k] = data->tangents[data->outputs[k]];
+      }
+    }
+    downstream.set_tangent(std::move(zTangent));
+  });
+
+  z.set_hvp([data](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    data->update(upstreams);
+    data->forward_tangents(upstreams);
+    const T& zDual = downstream.get_dual<T, T>();
+    const T& zDualTangent = downstream.get_dual_tangent<T, T>();
+    const size_t size = data->ops.size();
+    std::vector<double> adjoints(size, 0.0);
+    std::vector<double> adjointTangents(size, 0.0);
+    for (size_t k = 0; k < data->outputs.size(); ++k) {
+      adjoints[data->outputs[k]] += entry(zDual, k);
+      adjointTangents[data->outputs[k]] += entry(zDualTangent, k);
+    }
+    const auto& values = data->values;
+    const auto& tangents = data->tangents;
+    for (size_t i = size; i-- > 0;) {
+      int n = Data::arity(data->ops[i]);
+      if (n == 0) continue;
+      double a = adjoints[i];
+      double aT = adjointTangents[i];
+      const std::uint32_t* o = &data->operands[2 * i];
+      const double* p = &data->partials[2 * i];
+      // the tangents of the partials: only those of the nonlinear statements are nonzero
+      double dp0 = 0.0;
+      double dp1 = 0.0;
+      if (data->ops[i] == ScalarOp::Multiply) {
+        dp0 = tangents[o[1]];
+        dp1 = tangents[o[0]];
+      } else if (data->ops[i] == ScalarOp::Divide) {
+        dp0 = -2.0 * p[0] * tangents[o[0]] / values[o[0]];
+      }
+      adjoints[o[0]] += p[0] * a;
+      adjointTangents[o[0]] += p[0] * aT + dp0 * a;
+      if (n == 2) {
+        adjoints[o[1]] += p[1] * a;
+        adjointTangents[o[1]] += p[1] * aT + dp1 * a;
+      }
+    }
+    data->template accumulate_inputs<true>(upstreams, adjointTangents);
+  });
+
+  return z.finalize();
+}
+
+}  // namespace
+
+ScalarTape::ScalarTape() : data_(std::make_shared<Data>()) {}
+
+ScalarTape::~ScalarTape() = default;
+
+std::uint32_t ScalarTape::operand(Scalar x) const
+{
+  gretl_assert_msg(x.tape_ == this, "scalars from different tapes cannot be combined");
+  gretl_assert_msg(!finalized_, "cannot record on a scalar tape after it is finalized");
+  return x.index_;
+}
+
+std::uint32_t ScalarTape::add_upstream(const StateBase& state, bool isVector)
+{
+  gretl_assert_msg(!finalized_, "cannot record on a scalar tape after it is finalized");
+  for (size_t u = 0; u < upstreams_.size(); ++u) {
+    if (upstreams_[u].step() == state.step()) {
+      return static_cast<std::uint32_t>(u);
+    }
+  }
+  gretl_assert_msg(upstreams_.empty() || &upstreams_[0].data_store() == &state.data_store(),
+                   "the inputs of a scalar tape must be states of the same DataStore");
+  upstreams_.push_back(state);
+  data_->upstreamIsVector.push_back(isVector);
+  return static_cast<std::uint32_t>(upstreams_.size() - 1);
+}
+
+Scalar ScalarTape::input(const State<double>& x)
+{
+  std::uint32_t upstream = add_upstream(x, false);
+  std::uint32_t statement = data_->record(ScalarOp::Input, 0, 0, 0.0, 0.0, x.get(), 0.0, 0.0);
+  data_->inputs.push_back(Data::Input{statement, upstream, 0});
+  return Scalar(this, statement);
+}
+
+std::vector<Scalar> ScalarTape::input(const VectorState& x)
+{
+  std::uint32_t upstream = add_upstream(x, true);
+  const Vector& values = x.get();
+  std::vector<Scalar> scalars;
+  scalars.reserve(values.size());
+  for (size_t k = 0; k < values.size(); ++k) {
+    std::uint32_t statement = data_->record(ScalarOp::Input, 0, 0, 0.0, 0.0, values[k], 0.0, 0.0);
+    data_->inputs.push_back(Data::Input{statement, upstream, static_cast<std::uint32_t>(k)});
+    scalars.push_back(Scalar(this, statement));
+  }
+  return scalars;
+}
+
+Scalar ScalarTape::axpby(double a, Scalar x, double b, Scalar y)
+{
+  std::uint32_t i = operand(x);
+  std::uint32_t j = operand(y);
+  const auto& values = data_->values;
+  return Scalar(this, data_->record(ScalarOp::Axpby, i, j, a, b, a * values[i] + b * values[j], a, b));
+}
+
+Scalar ScalarTape::axpb(double a, Scalar x, double b)
+{
+  std::uint32_t i = operand(x);
+  return Scalar(this, data_->record(ScalarOp::Axpb, i, 0, a, b, a * data_->values[i] + b, a, 0.0));
+}
+
+Scalar ScalarTape::multiply(Scalar x, Scalar y)
+{
+  std::uint32_t i = operand(x);
+  std::uint32_t j = operand(y);
+  double X = data_->values[i];
+  double Y = data_->values[j];
+  return Scalar(this, data_->record(ScalarOp::Multiply, i, j, 0.0, 0.0, X * Y, Y, X));
+}
+
+Scalar ScalarTape::divide(double a, Scalar x)
+{
+  std::uint32_t i = operand(x);
+  double X = data_->values[i];
+  double Z = a / X;
+  return Scalar(this, data_->record(ScalarOp::Divide, i, 0, a, 0.0, Z, -Z / X, 0.0));
+}
+
+void ScalarTape::close(const std::vector<Scalar>& outputs)
+{
+  gretl_assert_msg(!finalized_, "a scalar tape can only be finalized once");
+  gretl_assert_msg(!upstreams_.empty(), "a scalar tape needs at least one input");
+  gretl_assert_msg(!outputs.empty(), "a scalar tape needs at least one output");
+  for (const auto& output : outputs) {
+    data_->outputs.push_back(operand(output));
+  }
+  finalized_ = true;
+}
+
+State<double> ScalarTape::finalize(Scalar output)
+{
+  close({output});
+  auto upstreams = std::move(upstreams_);
+  return finalize_tape(upstreams[0].create_state<double, double>(upstreams), data_);
+}
+
+VectorState ScalarTape::finalize(const std::vector<Scalar>& outputs)
+{
+  close(outputs);
+  auto upstreams = std::move(upstreams_);
+  return finalize_tape(upstreams[0].create_state<Vector, Vector>(upstreams, vec::initialize_zero_dual), data_);
+}
+
+size_t ScalarTape::size() const { return data_->ops.size(); }
+
+double ScalarTape::value(Scalar x) const
+{
+  gretl_assert_msg(x.tape_ == this, "the scalar is not recorded on this tape");
+  return data_->values[x.index_];
+}
+
+}  // namespace gretl
@@ -0,0 +1,136 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file scalar_tape.hpp
+ * @brief Recording long sequences of scalar operations into flat arrays, evaluated and differentiated as a single step
+ * of the graph.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "double_state.hpp"
+#include "vector_state.hpp"
+
+namespace gretl {
+
+class ScalarTape;
+
+/// @brief A scalar value recorded on a ScalarTape
+class Scalar {
+ public:
+  /// @brief Value computed while recording
+  double value() const;
+
+  /// @brief Tape the scalar is recorded on
+  ScalarTape& tape() const { return *tape_; }
+
+ private:
+  friend class ScalarTape;
+
+  /// @brief Construct from the tape and the index of the statement computing it
+  Scalar(ScalarTape* tape, std::uint32_t index) : tape_(tape), index_(index) {}
+
+  ScalarTape* tape_;     ///< tape
+  std::uint32_t index_;  ///< statement computing the scalar
+};
+
+/// @brief Records scalar operations as statements in flat arrays of opcodes, operand indices, constants and partial
+/// derivatives, in the manner of operator overloading tapes such as Adept and CoDiPack, instead of adding a step to the
+/// graph for every operation as the State<double> operations of double_state.hpp do.
+///
+/// Inputs are read from State<double> and VectorState handles, and finalize turns the recording into one step of the
+/// graph, producing a State<double> or a VectorState, with the inputs as its upstreams.  The step's eval replays the
+/// statements forward, and its vjp sweeps them in reverse, so checkpoint strategies see the whole recording as a single
+/// step: a long scalar computation is best split into several tapes to give them steps to choose from.  jvp and hvp
+/// are supported as well.  The arrays of a finalized tape are kept by its step, about 50 bytes per statement.
+///
+/// The same functions and operators as in double_state.hpp work on Scalar, so scalar code can be written once for
+/// both, e.g. as a template.
+class ScalarTape {
+ public:
+  /// @brief Construct an empty tape
+  ScalarTape();
+
+  /// @brief Destructor
+  ~ScalarTape();
+
+  ScalarTape(const ScalarTape&) = delete;             ///< not copyable, scalars refer to their tape
+  ScalarTape& operator=(const ScalarTape&) = delete;  ///< not copyable, scalars refer to their tape
+
+  /// @brief Record a State<double> as an input
+  Scalar input(const State<double>& x);
+
+  /// @brief Record every entry of a VectorState as an input
+  std::vector<Scalar> input(const VectorState& x);
+
+  /// @brief Record a * x + b * y
+  Scalar axpby(double a, Scalar x, double b, Scalar y);
+
+  /// @brief Record a * x + b
+  Scalar axpb(double a, Scalar x, double b);
+
+  /// @brief Record x * y
+  Scalar multiply(Scalar x, Scalar y);
+
+  /// @brief Record a / x
+  Scalar divide(double a, Scalar x);
+
+  /// @brief Add the recording to the graph as one step computing a single output.  Nothing more can be recorded.
+  State<double> finalize(Scalar output);
+
+  /// @brief Add the recording to the graph as one step computing several outputs.  Nothing more can be recorded.
+  VectorState finalize(const std::vector<Scalar>& outputs);
+
+  /// @brief Number of statements recorded, inputs included
+  size_t size() const;
+
+  /// @brief Value of a recorded scalar
+  double value(Scalar x) const;
+
+  /// @brief Statements and the arrays holding them, shared with the step created by finalize.  Defined in the source
+  /// file.
+  struct Data;
+
+ private:
+  /// @brief Check that a scalar can be used in a new statement
+  std::uint32_t operand(Scalar x) const;
+
+  /// @brief Record the inputs of a tape as upstreams, returning the index of an upstream
+  std::uint32_t add_upstream(const StateBase& state, bool isVector);
+
+  /// @brief Check that outputs can be taken from this tape, and close it
+  void close(const std::vector<Scalar>& outputs);
+
+  std::shared_ptr<Data> data_;         ///< recording
+  std::vector<StateBase> upstreams_;   ///< states the inputs are read from, until finalized
+  bool finalized_ = false;             ///< finalize was called
+};
+
+inline double Scalar::value() const { return tape_->value(*this); }
+
+/// @brief a * x + b * y
+inline Scalar axpby(double a, Scalar x, double b, Scalar y) { return x.tape().axpby(a, x, b, y); }
+
+/// @brief a * x + b
+inline Scalar axpb(double a, Scalar x, double b) { return x.tape().axpb(a, x, b); }
+
+inline Scalar operator+(Scalar x, Scalar y) { return axpby(1.0, x, 1.0, y); }   ///< addition
+inline Scalar operator-(Scalar x, Scalar y) { return axpby(1.0, x, -1.0, y); }  ///< subtraction
+inline Scalar operator+(Scalar x, double b) { return axpb(1.0, x, b); }          ///< addition
+inline Scalar operator+(double b, Scalar x) { return axpb(1.0, x, b); }          ///< addition
+inline Scalar operator-(Scalar x, double b) { return axpb(1.0, x, -b); }         ///< subtraction
+inline Scalar operator-(double a, Scalar x) { return axpb(-1.0, x, a); }         ///< subtraction
+inline Scalar operator*(double a, Scalar x) { return axpb(a, x, 0.0); }          ///< multiplication
+inline Scalar operator*(Scalar x, double a) { return axpb(a, x, 0.0); }          ///< multiplication
+inline Scalar operator/(Scalar x, double a) { return axpb(1.0 / a, x, 0.0); }    ///< division
+inline Scalar operator/(double a, Scalar x) { return x.tape().divide(a, x); }    ///< division
+inline Scalar operator*(Scalar x, Scalar y) { return x.tape().multiply(x, y); }  ///< multiplication
+
+}  // namespace gretl
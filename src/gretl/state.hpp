@@ -39,6 +39,18 @@ struct State : public StateBase {
   /// @brief Get dual value of correct type
   inline const D& get_dual() const { return data_store().template get_dual<D, T>(step()); }
 
+  /// @brief Get dual value of correct type for one seed of a batched reverse sweep
+  inline const D& get_seed_dual(size_t seed) const { return data_store().template get_seed_dual<D, T>(step(), seed); }
+
+  /// @brief Get tangent value of correct type
+  inline const D& get_tangent() const { return data_store().template get_tangent<D, T>(step()); }
+
+  /// @brief Set tangent value of correct type, this also turns on tangent propagation for the graph
+  inline void set_tangent(const D& d) { StateBase::set_tangent<D, T>(d); }
+
+  /// @brief Get dual tangent value of correct type
+  inline const D& get_dual_tangent() const { return data_store().template get_dual_tangent<D, T>(step()); }
+
   /// @brief Set the std::functions which evaluates downstream primals given upstream primals
   void set_eval(const std::function<void(const UpstreamStates& upstreams, DownstreamState& downstream)>& e)
   {
@@ -56,6 +68,29 @@ struct State : public StateBase {
     }
   }
 
+  /// @brief Set the std::functions which computes the action of the jacobian on the upstream tangents, and sets the
+  /// downstream tangent.  This is optional, and only required when forward-mode tangents are propagated.
+  void set_jvp(const std::function<void(const UpstreamStates& upstreams, DownstreamState& downstream)>& j)
+  {
+    if (!data_store().gradients_enabled()) {
+      data_store().jvps_[step()] = [](const UpstreamStates&, DownstreamState&) {};
+    } else {
+      data_store().jvps_[step()] = j;
+    }
+  }
+
+  /// @brief Set the std::functions which computes the tangent of this state's vjp (forward-over-reverse): given the
+  /// upstream tangents, and the downstream dual and dual tangent, plus-equals into the upstream dual tangents.  This is
+  /// optional, and only required for Hessian-vector products.
+  void set_hvp(const std::function<void(UpstreamStates& upstreams, const DownstreamState& downstream)>& h)
+  {
+    if (!data_store().gradients_enabled()) {
+      data_store().hvps_[step()] = [](UpstreamStates&, const DownstreamState&) {};
+    } else {
+      data_store().hvps_[step()] = h;
+    }
+  }
+
   /// @brief Helper function to clone an existing state (keeping its type).
   /// Allocates default-constructed primal storage; finalize() will overwrite it
   /// via evaluate_forward(), so copying the source primal is unnecessary.
@@ -65,7 +100,7 @@ struct State : public StateBase {
     gretl_assert(!upstreams.empty());
     auto new_val = std::make_shared<std::any>(T{});
     gretl_assert_msg(!data_.get()->lifetimeToken_.expired(), "Attempted to clone a state with an expired DataStore");
-    State<T, D> state(data_.get()->dataStore_, data_.get()->lifetimeToken_, data_store().states_.size(), new_val,
+    State<T, D> state(data_.get()->dataStore_, data_.get()->lifetimeToken_, data_store().next_step(), new_val,
                       initialize_zero_dual_);
     data_store().add_state(std::make_unique<State<T, D>>(state), upstreams);
     return state;
@@ -79,6 +114,9 @@ struct State : public StateBase {
     return *this;
   }
 
+  /// @brief std::function which initializes and zeroes a dual value of this state
+  const InitializeZeroDual<T, D>& initialize_zero_dual() const { return initialize_zero_dual_; }
+
   friend class DataStore;
 
  protected:
@@ -113,4 +151,28 @@ inline State<double> set_as_objective(State<double> o)
   return o;
 }
 
+/// @brief Seeds the tangent of an input state and re-evaluates the graph forward, propagating tangents to all
+/// downstream states.  Additional inputs can be seeded with set_tangent before calling.
+/// @param input state to seed, typically persistent
+/// @param seed tangent direction for the input
+template <typename T, typename D>
+void forward_tangent(State<T, D> input, const D& seed)
+{
+  input.set_tangent(seed);
+  input.data_store().forward_tangent();
+}
+
+/// @brief Computes the gradient and the Hessian-vector product of a scalar objective using one forward tangent sweep
+/// and one second-order reverse sweep under the existing checkpoint strategy.  The direction is given by tangents
+/// previously seeded on the inputs with set_tangent.  Afterwards, input.get_dual() is the gradient and
+/// input.get_dual_tangent() is the Hessian-vector product.
+/// @param objective the final state on the graph
+inline void hessian_vector_product(State<double> objective)
+{
+  DataStore& dataStore = objective.data_store();
+  dataStore.forward_tangent();
+  set_as_objective(objective);
+  dataStore.back_prop_hvp();
+}
+
 }  // namespace gretl
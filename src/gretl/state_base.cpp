@@ -10,11 +10,25 @@
 namespace gretl {
 
 void StateBase::evaluate_forward()
+{
+  if (data_store().restoring()) {
+    data_store().restore_step(step());
+    data_store().erase_step_state_data(step());
+    return;
+  }
+  evaluate_primal();
+  data_store().erase_step_state_data(step());
+}
+
+void StateBase::evaluate_primal()
 {
   DownstreamState ds(&data_store(), step());
   UpstreamStates upstreams(data_store(), data_store().upstreamSteps_[step()]);
   data_store().evals_[step()](upstreams, ds);
-  data_store().erase_step_state_data(step());
+  data_store().evaluatedPrimalBytes_[step()] = data_store().primal_bytes(step());
+  if (data_store().tangents_enabled()) {
+    data_store().jvp(*this);
+  }
 }
 
 void StateBase::evaluate_vjp()
@@ -24,4 +38,20 @@ void StateBase::evaluate_vjp()
   data_store().vjps_[step()](upstreams, ds);
 }
 
+void StateBase::evaluate_jvp()
+{
+  // clear any stale tangent so no-op jvps (stop-gradient states) leave a zero tangent behind
+  data_store().clear_tangent(step());
+  DownstreamState ds(&data_store(), step());
+  UpstreamStates upstreams(data_store(), data_store().upstreamSteps_[step()]);
+  data_store().jvps_[step()](upstreams, ds);
+}
+
+void StateBase::evaluate_hvp()
+{
+  const DownstreamState ds(&data_store(), step());
+  UpstreamStates upstreams(data_store(), data_store().upstreamSteps_[step()]);
+  data_store().hvps_[step()](upstreams, ds);
+}
+
 }  // namespace gretl
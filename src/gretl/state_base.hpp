@@ -23,10 +23,11 @@ struct StateData {
       : dataStore_(dataStore), lifetimeToken_(std::move(lifetimeToken)), primal_(primal)
   {
   }
-  DataStore* dataStore_;                        ///< datastore
-  std::weak_ptr<void> lifetimeToken_;           ///< datastore lifetime token
-  std::shared_ptr<std::any> primal_;            ///< value, stores as shared_ptr to std::any
-  Int step_ = std::numeric_limits<Int>::max();  ///< step
+  DataStore* dataStore_;                                ///< datastore
+  std::weak_ptr<void> lifetimeToken_;                   ///< datastore lifetime token
+  std::shared_ptr<std::any> primal_;                    ///< value, stores as shared_ptr to std::any
+  Int step_ = std::numeric_limits<Int>::max();          ///< step
+  std::shared_ptr<const PrimalCodec> checkpointCodec_;  ///< codec of this state's checkpoints, if not the DataStore's
 };
 
 /// @brief Baseclass for State.  State stores type-erased value and step number in the graph.
@@ -92,6 +93,50 @@ struct StateBase {
   /// @brief method to clear out the memory usage for state's dual value
   void clear_dual() { data_store().clear_dual(step()); }
 
+  /// @brief Opt this state in to storing its checkpoints with a given codec (e.g. make_float32_codec()), instead of the
+  /// DataStore's checkpoint compression.  Passing nullptr goes back to the DataStore's setting.
+  void set_checkpoint_codec(std::shared_ptr<const PrimalCodec> codec)
+  {
+    data_store().decompress_primal(step());
+    data_->checkpointCodec_ = std::move(codec);
+  }
+
+  /// @brief get the underlying dual value for one seed of a batched reverse sweep, dual template type comes first
+  template <typename D, typename T = D>
+  const D& get_seed_dual(size_t seed) const
+  {
+    return data_store().get_seed_dual<D, T>(step(), seed);
+  }
+
+  /// @brief set the underlying dual value for one seed of a batched reverse sweep, dual template type comes first
+  template <typename D, typename T = D>
+  void set_seed_dual(size_t seed, const D& d)
+  {
+    data_store().set_seed_dual<D>(step(), seed, d);
+  }
+
+  /// @brief get the underlying tangent value, dual template type comes first
+  template <typename D, typename T = D>
+  const D& get_tangent() const
+  {
+    return data_store().get_tangent<D, T>(step());
+  }
+
+  /// @brief set the underlying tangent value and turn on tangent propagation, dual template type comes first
+  template <typename D, typename T = D>
+  void set_tangent(const D& d)
+  {
+    data_store().set_tangent(step(), d);
+    data_store().set_tangents_enabled(true);
+  }
+
+  /// @brief get the underlying dual tangent value (the Hessian-vector product for inputs after back_prop_hvp)
+  template <typename D, typename T = D>
+  const D& get_dual_tangent() const
+  {
+    return data_store().get_dual_tangent<D, T>(step());
+  }
+
   /// @brief create a new state, given the upstream input dependencies and a function specifying how to initial the dual
   /// value to zero.
   template <typename T, typename D = T>
@@ -110,12 +155,25 @@ struct StateBase {
   friend class DataStore;
   friend class DynamicDataStore;
 
+  template <typename T, typename D>
+  friend class WeakState;
+
   /// @brief Evaluate graph one step forward, compute primal value at this new state
   void evaluate_forward();
 
+  /// @brief Compute the primal value at this state, and its tangent when tangents are enabled, without handing the
+  /// step to the checkpoint strategy
+  void evaluate_primal();
+
   /// @brief Evaluate graph one step backward, contribute sensitivity to the upstream duals
   void evaluate_vjp();
 
+  /// @brief Propagate the upstream tangents one step forward, computing the tangent at this state
+  void evaluate_jvp();
+
+  /// @brief Evaluate the tangent of the vjp one step backward, contribute to the upstream dual tangents
+  void evaluate_hvp();
+
   /// @brief Datastore accessor
   DataStore& data_store() const
   {
@@ -5,13 +5,312 @@
 // SPDX-License-Identifier: (BSD-3-Clause)
 
 #include "strumm_walther_checkpoint_strategy.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <limits>
+#include <random>
+#include <utility>
+#include <vector>
 
 namespace gretl {
 
-StrummWaltherCheckpointStrategy::StrummWaltherCheckpointStrategy(size_t maxStates) : maxNumSlots_(maxStates) {}
+namespace {
+
+/// @brief Treap keyed by Key, which keeps an order-dependent Summary of the values in every subtree.  Summary needs a
+/// static leaf(key, value) and an associative static combine(left, right), with a default constructed identity.
+template <typename Key, typename Value, typename Summary>
+class SummaryTreap {
+ public:
+  static constexpr size_t nil = std::numeric_limits<size_t>::max();
+
+  /// @brief tree node
+  struct Node {
+    Key key;
+    Value value;
+    Summary summary;
+    uint32_t priority;
+    size_t left;
+    size_t right;
+  };
+
+  size_t size() const { return size_; }
+  size_t root() const { return root_; }
+  const Node& node(size_t n) const { return nodes_[n]; }
+  Summary summary(size_t n) const { return n == nil ? Summary{} : nodes_[n].summary; }
+
+  void clear()
+  {
+    nodes_.clear();
+    free_.clear();
+    root_ = nil;
+    size_ = 0;
+  }
+
+  void insert(const Key& key, const Value& value)
+  {
+    size_t n = allocate(key, value);
+    auto [lo, hi] = split(root_, key, false);
+    root_ = merge(merge(lo, n), hi);
+    ++size_;
+  }
+
+  bool erase(const Key& key)
+  {
+    auto [lo, rest] = split(root_, key, false);
+    auto [mid, hi] = split(rest, key, true);
+    bool found = mid != nil;
+    if (found) {
+      assert(nodes_[mid].left == nil && nodes_[mid].right == nil);
+      free_.push_back(mid);
+      --size_;
+    }
+    root_ = merge(lo, hi);
+    return found;
+  }
+
+  const Node* find(const Key& key) const
+  {
+    size_t n = root_;
+    while (n != nil) {
+      if (key < nodes_[n].key) {
+        n = nodes_[n].left;
+      } else if (nodes_[n].key < key) {
+        n = nodes_[n].right;
+      } else {
+        return &nodes_[n];
+      }
+    }
+    return nullptr;
+  }
+
+  /// @brief node with the largest key less than key
+  const Node* below(const Key& key) const
+  {
+    const Node* best = nullptr;
+    for (size_t n = root_; n != nil;) {
+      if (nodes_[n].key < key) {
+        best = &nodes_[n];
+        n = nodes_[n].right;
+      } else {
+        n = nodes_[n].left;
+      }
+    }
+    return best;
+  }
+
+  /// @brief node with the smallest key greater than key
+  const Node* above(const Key& key) const
+  {
+    const Node* best = nullptr;
+    for (size_t n = root_; n != nil;) {
+      if (key < nodes_[n].key) {
+        best = &nodes_[n];
+        n = nodes_[n].left;
+      } else {
+        n = nodes_[n].right;
+      }
+    }
+    return best;
+  }
+
+  const Node* last() const
+  {
+    if (root_ == nil) return nullptr;
+    size_t n = root_;
+    while (nodes_[n].right != nil) {
+      n = nodes_[n].right;
+    }
+    return &nodes_[n];
+  }
+
+  /// @brief summary of the keys in [lo, hi)
+  Summary range(const Key& lo, const Key& hi)
+  {
+    auto [a, rest] = split(root_, lo, false);
+    auto [mid, c] = split(rest, hi, false);
+    Summary result = summary(mid);
+    root_ = merge(merge(a, mid), c);
+    return result;
+  }
+
+  template <typename Visit>
+  void for_each(Visit&& visit) const
+  {
+    for_each(root_, visit);
+  }
+
+ private:
+  size_t allocate(const Key& key, const Value& value)
+  {
+    Node node{key, value, Summary::leaf(key, value), static_cast<uint32_t>(random_()), nil, nil};
+    if (free_.empty()) {
+      nodes_.push_back(node);
+      return nodes_.size() - 1;
+    }
+    size_t n = free_.back();
+    free_.pop_back();
+    nodes_[n] = node;
+    return n;
+  }
+
+  void update(size_t n)
+  {
+    Node& node = nodes_[n];
+    Summary own = Summary::leaf(node.key, node.value);
+    node.summary = Summary::combine(Summary::combine(summary(node.left), own), summary(node.right));
+  }
+
+  /// @brief split into keys before key and the rest, where key itself goes before when inclusive
+  std::pair<size_t, size_t> split(size_t n, const Key& key, bool inclusive)
+  {
+    if (n == nil) return {nil, nil};
+    bool before = inclusive ? !(key < nodes_[n].key) : nodes_[n].key < key;
+    if (before) {
+      auto [lo, hi] = split(nodes_[n].right, key, inclusive);
+      nodes_[n].right = lo;
+      update(n);
+      return {n, hi};
+    }
+    auto [lo, hi] = split(nodes_[n].left, key, inclusive);
+    nodes_[n].left = hi;
+    update(n);
+    return {lo, n};
+  }
+
+  size_t merge(size_t a, size_t b)
+  {
+    if (a == nil) return b;
+    if (b == nil) return a;
+    if (nodes_[a].priority > nodes_[b].priority) {
+      nodes_[a].right = merge(nodes_[a].right, b);
+      update(a);
+      return a;
+    }
+    nodes_[b].left = merge(a, nodes_[b].left);
+    update(b);
+    return b;
+  }
+
+  template <typename Visit>
+  void for_each(size_t n, Visit& visit) const
+  {
+    if (n == nil) return;
+    for_each(nodes_[n].left, visit);
+    visit(nodes_[n].key, nodes_[n].value);
+    for_each(nodes_[n].right, visit);
+  }
+
+  std::vector<Node> nodes_;
+  std::vector<size_t> free_;
+  size_t root_ = nil;
+  size_t size_ = 0;
+  std::minstd_rand random_;
+};
+
+/// @brief weights of the non-persistent slots in a range of steps
+struct WeightSummary {
+  bool any = false;
+  size_t minWeight = 0;
+  size_t maxWeight = 0;
+  bool increases = false;  ///< some slot has a lower weight than a later slot
+
+  template <typename Slot>
+  static WeightSummary leaf(size_t, const Slot& slot)
+  {
+    if (slot.persistent) return {};
+    return {true, slot.weight, slot.weight, false};
+  }
+
+  static WeightSummary combine(const WeightSummary& a, const WeightSummary& b)
+  {
+    if (!a.any) return b;
+    if (!b.any) return a;
+    return {true, std::min(a.minWeight, b.minWeight), std::max(a.maxWeight, b.maxWeight),
+            a.increases || b.increases || a.minWeight < b.maxWeight};
+  }
+
+  /// @brief does the range contain a slot with a lower weight than a later slot, or than maxAfter
+  bool has_dispensable(size_t maxAfter) const { return any && (minWeight < maxAfter || increases); }
+};
+
+/// @brief smallest gap product among non-persistent slots in a range of (weight, step), leftmost step on ties
+struct GapSummary {
+  bool any = false;
+  size_t product = 0;
+  size_t step = 0;
+
+  static GapSummary leaf(const std::pair<size_t, size_t>& weightStep, size_t product)
+  {
+    return {true, product, weightStep.second};
+  }
+
+  static GapSummary combine(const GapSummary& a, const GapSummary& b)
+  {
+    if (!a.any) return b;
+    if (!b.any) return a;
+    return std::make_pair(b.product, b.step) < std::make_pair(a.product, a.step) ? b : a;
+  }
+};
+
+}  // namespace
+
+struct StrummWaltherCheckpointStrategy::Index {
+  SummaryTreap<size_t, Slot, WeightSummary> byStep;
+  SummaryTreap<std::pair<size_t, size_t>, size_t, GapSummary> byWeight;  ///< non-persistent slots only
+
+  /// @brief (step - previous step) * (next step - step), with 0 before the first slot and last step + 1 after the last
+  size_t gap_product(size_t step) const
+  {
+    auto prev = byStep.below(step);
+    auto next = byStep.above(step);
+    size_t leftStep = prev ? prev->key : 0;
+    size_t rightStep = next ? next->key : step + 1;
+    return (step - leftStep) * (rightStep - step);
+  }
+
+  Slot slot(size_t step) const
+  {
+    auto n = byStep.find(step);
+    assert(n);
+    return n ? n->value : Slot{step, false, 0};
+  }
+
+  void refresh_gap_product(const typename SummaryTreap<size_t, Slot, WeightSummary>::Node* n)
+  {
+    if (!n || n->value.persistent) return;
+    byWeight.erase({n->value.weight, n->key});
+    byWeight.insert({n->value.weight, n->key}, gap_product(n->key));
+  }
+
+  void insert(const Slot& slot)
+  {
+    byStep.insert(slot.step, slot);
+    if (!slot.persistent) {
+      byWeight.insert({slot.weight, slot.step}, gap_product(slot.step));
+    }
+    refresh_gap_product(byStep.below(slot.step));
+    refresh_gap_product(byStep.above(slot.step));
+  }
+
+  void erase(Slot slot)
+  {
+    byStep.erase(slot.step);
+    if (!slot.persistent) {
+      byWeight.erase({slot.weight, slot.step});
+    }
+    refresh_gap_product(byStep.below(slot.step));
+    refresh_gap_product(byStep.above(slot.step));
+  }
+};
+
+StrummWaltherCheckpointStrategy::StrummWaltherCheckpointStrategy(size_t maxStates)
+    : maxNumSlots_(maxStates), index_(std::make_unique<Index>())
+{
+}
+
+StrummWaltherCheckpointStrategy::~StrummWaltherCheckpointStrategy() = default;
 
 size_t StrummWaltherCheckpointStrategy::find_dispensable() const
 {
@@ -24,69 +323,111 @@ size_t StrummWaltherCheckpointStrategy::find_dispensable() const
   // weight, choose the one whose removal minimizes the increase in total
   // recomputation cost (gap_left * gap_right). This spacing-aware tiebreaker
   // can outperform Wang's arbitrary "first found" selection.
+  //
+  // Both searches descend the augmented trees instead of scanning the slots.
+  const auto& byStep = index_->byStep;
+  constexpr size_t nil = SummaryTreap<size_t, Slot, WeightSummary>::nil;
 
-  // First pass: find the dispensable weight threshold
+  // First: the dispensable weight threshold, from the rightmost slot with a lower weight than a later slot
   size_t maxWeight = 0;
   size_t dispensableWeight = std::numeric_limits<size_t>::max();
-  for (size_t i = slots_.size(); i > 0; --i) {
-    size_t idx = i - 1;
-    if (slots_[idx].persistent) continue;
-
-    if (slots_[idx].weight < maxWeight) {
-      dispensableWeight = slots_[idx].weight;
-      break;
+  for (size_t n = byStep.root(); n != nil;) {
+    const auto& node = byStep.node(n);
+    auto right = byStep.summary(node.right);
+    if (right.has_dispensable(maxWeight)) {
+      n = node.right;
+      continue;
     }
-    maxWeight = std::max(maxWeight, slots_[idx].weight);
+    if (right.any) {
+      maxWeight = std::max(maxWeight, right.maxWeight);
+    }
+    if (!node.value.persistent) {
+      if (node.value.weight < maxWeight) {
+        dispensableWeight = node.value.weight;
+        break;
+      }
+      maxWeight = std::max(maxWeight, node.value.weight);
+    }
+    n = node.left;
   }
 
   if (dispensableWeight == std::numeric_limits<size_t>::max()) {
-    return slots_.size();  // none found
+    return invalidCheckpointIndex;  // none found
   }
 
-  // Second pass: among all slots at dispensableWeight, pick the one with
+  // Second: among slots at dispensableWeight which have a higher-weight slot at a higher step, pick the one with
   // minimum gap_left * gap_right (minimum delta recomputation cost).
-  size_t bestIdx = slots_.size();
-  size_t bestProduct = std::numeric_limits<size_t>::max();
-
-  for (size_t i = 0; i < slots_.size(); ++i) {
-    if (slots_[i].persistent) continue;
-    if (slots_[i].weight != dispensableWeight) continue;
-
-    // Check that this slot is actually in a dispensable position
-    // (there must be a higher-weight slot at a higher step)
-    bool hasHigherWeightAfter = false;
-    for (size_t j = i + 1; j < slots_.size(); ++j) {
-      if (!slots_[j].persistent && slots_[j].weight > dispensableWeight) {
-        hasHigherWeightAfter = true;
-        break;
-      }
+  size_t lastHigherStep = 0;
+  for (size_t n = byStep.root(); n != nil;) {
+    const auto& node = byStep.node(n);
+    auto right = byStep.summary(node.right);
+    if (right.any && right.maxWeight > dispensableWeight) {
+      n = node.right;
+    } else if (!node.value.persistent && node.value.weight > dispensableWeight) {
+      lastHigherStep = node.key;
+      break;
+    } else {
+      n = node.left;
     }
-    if (!hasHigherWeightAfter) continue;
-
-    size_t leftStep = (i > 0) ? slots_[i - 1].step : 0;
-    size_t rightStep = (i + 1 < slots_.size()) ? slots_[i + 1].step : slots_.back().step + 1;
-
-    size_t gapLeft = slots_[i].step - leftStep;
-    size_t gapRight = rightStep - slots_[i].step;
-    size_t product = gapLeft * gapRight;
+  }
 
-    if (product < bestProduct) {
-      bestProduct = product;
-      bestIdx = i;
+  auto best = index_->byWeight.range({dispensableWeight, 0}, {dispensableWeight, lastHigherStep});
+  assert(best.any);
+  if (evictionOracle_ && evictionOracle_(best.step) == 0) {
+    // pinned, only evicted if no other dispensable slot releases memory
+    size_t releasing = find_dispensable_releasing_memory();
+    if (valid_checkpoint_index(releasing)) {
+      return releasing;
     }
   }
+  return best.step;
+}
 
-  return bestIdx;
+size_t StrummWaltherCheckpointStrategy::find_dispensable_releasing_memory() const
+{
+  // visit the slots from the highest step down, skipping the subtrees without a dispensable slot, so the oracle is
+  // only asked about dispensable slots, each found in O(log S)
+  const auto& byStep = index_->byStep;
+  size_t maxWeight = 0;
+  auto search = [&](auto& self, size_t n) -> size_t {
+    auto summary = byStep.summary(n);
+    if (!summary.has_dispensable(maxWeight)) {
+      if (summary.any) {
+        maxWeight = std::max(maxWeight, summary.maxWeight);
+      }
+      return invalidCheckpointIndex;
+    }
+    const auto& node = byStep.node(n);
+    size_t found = self(self, node.right);
+    if (valid_checkpoint_index(found)) {
+      return found;
+    }
+    if (!node.value.persistent) {
+      if (node.value.weight < maxWeight && evictionOracle_(node.key) > 0) {
+        return node.key;
+      }
+      maxWeight = std::max(maxWeight, node.value.weight);
+    }
+    return self(self, node.left);
+  };
+  return search(search, byStep.root());
 }
 
 size_t StrummWaltherCheckpointStrategy::find_rightmost_nonpersistent() const
 {
-  for (size_t i = slots_.size(); i > 0; --i) {
-    if (!slots_[i - 1].persistent) {
-      return i - 1;
+  const auto& byStep = index_->byStep;
+  constexpr size_t nil = SummaryTreap<size_t, Slot, WeightSummary>::nil;
+  for (size_t n = byStep.root(); n != nil;) {
+    const auto& node = byStep.node(n);
+    if (byStep.summary(node.right).any) {
+      n = node.right;
+    } else if (!node.value.persistent) {
+      return node.key;
+    } else {
+      n = node.left;
     }
   }
-  return slots_.size();
+  return invalidCheckpointIndex;
 }
 
 size_t StrummWaltherCheckpointStrategy::add_checkpoint_and_get_index_to_remove(size_t step, bool persistent)
@@ -97,37 +438,34 @@ size_t StrummWaltherCheckpointStrategy::add_checkpoint_and_get_index_to_remove(s
 
   if (persistent) {
     maxNumSlots_++;
-    assert(slots_.size() < maxNumSlots_);
+    assert(index_->byStep.size() < maxNumSlots_);
   }
 
-  if (slots_.size() < maxNumSlots_) {
+  if (index_->byStep.size() < maxNumSlots_) {
     // Space available — insert directly
   } else {
     // At capacity — must evict
-    size_t dispensableIdx = find_dispensable();
+    size_t dispensableStep = find_dispensable();
 
-    if (dispensableIdx < slots_.size()) {
+    if (valid_checkpoint_index(dispensableStep)) {
       // Found a dispensable slot: evict it, new checkpoint gets weight 0
-      nextEraseStep = slots_[dispensableIdx].step;
-      slots_.erase(slots_.begin() + static_cast<ptrdiff_t>(dispensableIdx));
+      nextEraseStep = dispensableStep;
     } else {
       // No dispensable slot (all weights equal): evict the rightmost
       // non-persistent and PROMOTE the replacement to a higher weight.
       // This is the key self-organizing mechanism: it creates a weight
       // hierarchy that forces future evictions to target older, lower-weight
       // checkpoints, producing near-logarithmic checkpoint distributions.
-      size_t rightmostIdx = find_rightmost_nonpersistent();
-      assert(rightmostIdx < slots_.size());
-      newWeight = slots_[rightmostIdx].weight + 1;
-      nextEraseStep = slots_[rightmostIdx].step;
-      slots_.erase(slots_.begin() + static_cast<ptrdiff_t>(rightmostIdx));
+      size_t rightmostStep = find_rightmost_nonpersistent();
+      assert(valid_checkpoint_index(rightmostStep));
+      newWeight = index_->slot(rightmostStep).weight + 1;
+      nextEraseStep = rightmostStep;
     }
+    index_->erase(index_->slot(nextEraseStep));
   }
 
   // Insert new slot in sorted order
-  Slot newSlot{step, persistent, persistent ? std::numeric_limits<size_t>::max() : newWeight};
-  auto it = std::lower_bound(slots_.begin(), slots_.end(), step, [](const Slot& s, size_t st) { return s.step < st; });
-  slots_.insert(it, newSlot);
+  index_->insert(Slot{step, persistent, persistent ? std::numeric_limits<size_t>::max() : newWeight});
 
   metrics_.stores++;
   if (valid_checkpoint_index(nextEraseStep)) {
@@ -139,48 +477,103 @@ size_t StrummWaltherCheckpointStrategy::add_checkpoint_and_get_index_to_remove(s
 
 size_t StrummWaltherCheckpointStrategy::last_checkpoint_step() const
 {
-  assert(!slots_.empty());
-  return slots_.back().step;
+  auto last = index_->byStep.last();
+  assert(last);
+  return last ? last->key : invalidCheckpointIndex;
 }
 
 bool StrummWaltherCheckpointStrategy::erase_step(size_t stepIndex)
 {
-  for (auto it = slots_.begin(); it != slots_.end(); ++it) {
-    if (it->step == stepIndex) {
-      if (!it->persistent) {
-        slots_.erase(it);
-        return true;
-      }
-    }
+  auto node = index_->byStep.find(stepIndex);
+  if (node && !node->value.persistent) {
+    index_->erase(node->value);
+    return true;
   }
   return false;
 }
 
 bool StrummWaltherCheckpointStrategy::contains_step(size_t stepIndex) const
 {
-  for (const auto& s : slots_) {
-    if (s.step == stepIndex) {
-      return true;
-    }
-  }
-  return false;
+  return index_->byStep.find(stepIndex) != nullptr;
 }
 
 void StrummWaltherCheckpointStrategy::reset()
 {
-  slots_.erase(std::remove_if(slots_.begin(), slots_.end(), [](const Slot& s) { return !s.persistent; }), slots_.end());
+  std::vector<Slot> persistentSlots;
+  index_->byStep.for_each([&](size_t, const Slot& s) {
+    if (s.persistent) {
+      persistentSlots.push_back(s);
+    }
+  });
+  index_->byStep.clear();
+  index_->byWeight.clear();
+  for (const auto& s : persistentSlots) {
+    index_->insert(s);
+  }
 }
 
 size_t StrummWaltherCheckpointStrategy::capacity() const { return maxNumSlots_; }
 
-size_t StrummWaltherCheckpointStrategy::size() const { return slots_.size(); }
+std::vector<size_t> StrummWaltherCheckpointStrategy::set_capacity(size_t maxStates)
+{
+  // byWeight holds the non-persistent slots only
+  maxNumSlots_ = maxStates + index_->byStep.size() - index_->byWeight.size();
+
+  std::vector<size_t> evicted;
+  while (index_->byStep.size() > maxNumSlots_) {
+    size_t step = find_dispensable();
+    if (!valid_checkpoint_index(step)) {
+      step = find_rightmost_nonpersistent();
+    }
+    assert(valid_checkpoint_index(step));
+    index_->erase(index_->slot(step));
+    evicted.push_back(step);
+    metrics_.evictions++;
+  }
+  return evicted;
+}
+
+bool StrummWaltherCheckpointStrategy::supports_renumbering() const { return true; }
+
+void StrummWaltherCheckpointStrategy::renumber_steps(const std::vector<size_t>& newSteps)
+{
+  std::vector<Slot> slots;
+  index_->byStep.for_each([&](size_t, const Slot& s) { slots.push_back(s); });
+  index_->byStep.clear();
+  index_->byWeight.clear();
+  // the gaps between the slots are recomputed as they are inserted again
+  for (Slot s : slots) {
+    s.step = newSteps[s.step];
+    if (valid_checkpoint_index(s.step)) {
+      index_->insert(s);
+    } else if (s.persistent) {
+      // a persistent slot takes its capacity with it
+      maxNumSlots_--;
+    }
+  }
+}
+
+void StrummWaltherCheckpointStrategy::make_persistent(size_t step)
+{
+  auto node = index_->byStep.find(step);
+  if (node) {
+    if (node->value.persistent) {
+      return;
+    }
+    index_->erase(node->value);
+  }
+  maxNumSlots_++;
+  index_->insert(Slot{step, true, std::numeric_limits<size_t>::max()});
+}
+
+size_t StrummWaltherCheckpointStrategy::size() const { return index_->byStep.size(); }
 
 void StrummWaltherCheckpointStrategy::print(std::ostream& os) const
 {
   os << "CHECKPOINTS (StrummWalther): capacity = " << maxNumSlots_ << std::endl;
-  for (const auto& s : slots_) {
+  index_->byStep.for_each([&](size_t, const Slot& s) {
     os << "   step=" << s.step << " weight=" << s.weight << (s.persistent ? " (persistent)" : "") << "\n";
-  }
+  });
 }
 
 CheckpointMetrics StrummWaltherCheckpointStrategy::metrics() const { return metrics_; }
@@ -189,4 +582,9 @@ void StrummWaltherCheckpointStrategy::reset_metrics() { metrics_ = {}; }
 
 void StrummWaltherCheckpointStrategy::record_recomputation() { metrics_.recomputations++; }
 
+void StrummWaltherCheckpointStrategy::set_eviction_oracle(EvictionOracle oracle)
+{
+  evictionOracle_ = std::move(oracle);
+}
+
 }  // namespace gretl
@@ -16,8 +16,7 @@
 #pragma once
 
 #include "checkpoint_strategy.hpp"
-#include <vector>
-#include <algorithm>
+#include <memory>
 
 namespace gretl {
 
@@ -33,22 +32,31 @@ namespace gretl {
 /// - No level concept; eviction is based on spacing analysis
 /// - Works online: total number of steps need not be known a priori
 /// - Achieves near-optimal checkpoint distribution for unknown-length runs
+/// - Eviction, insertion and erasure are O(log S) in the number of slots S
 class StrummWaltherCheckpointStrategy final : public CheckpointStrategy {
  public:
   /// @brief Construct with a given number of non-persistent checkpoint slots.
   explicit StrummWaltherCheckpointStrategy(size_t maxStates);
 
+  /// @brief Destructor
+  ~StrummWaltherCheckpointStrategy() override;
+
   size_t add_checkpoint_and_get_index_to_remove(size_t step, bool persistent = false) override;
   size_t last_checkpoint_step() const override;
   bool erase_step(size_t stepIndex) override;
   bool contains_step(size_t stepIndex) const override;
   void reset() override;
   size_t capacity() const override;
+  std::vector<size_t> set_capacity(size_t maxStates) override;
+  bool supports_renumbering() const override;
+  void renumber_steps(const std::vector<size_t>& newSteps) override;
+  void make_persistent(size_t step) override;
   size_t size() const override;
   void print(std::ostream& os) const override;
   CheckpointMetrics metrics() const override;
   void reset_metrics() override;
   void record_recomputation() override;
+  void set_eviction_oracle(EvictionOracle oracle) override;
 
  private:
   /// @brief A checkpoint slot: stores step, persistent flag, and weight.
@@ -58,18 +66,28 @@ class StrummWaltherCheckpointStrategy final : public CheckpointStrategy {
     size_t weight;  ///< Importance weight; increases via promotion (like Wang levels)
   };
 
+  /// @brief Slots indexed by step, and non-persistent slots indexed by (weight, step), both augmented so that the
+  /// eviction candidate is found in O(log S).  Defined in the source file.
+  struct Index;
+
   /// @brief Find a "dispensable" slot using weight-based priority.
   /// Iterates from highest to lowest step; a slot is dispensable if its
   /// weight is less than the running maximum weight seen so far.
-  /// @return Index of the dispensable slot, or slots_.size() if none found.
+  /// @return Step of the dispensable slot, or invalidCheckpointIndex if none found.
   size_t find_dispensable() const;
 
-  /// @brief Find the index of the rightmost non-persistent slot.
+  /// @brief Find the rightmost dispensable slot whose eviction releases memory according to the eviction oracle.
+  /// Only the dispensable slots are visited, so it is only used when the preferred dispensable slot releases nothing.
+  /// @return Step of the slot, or invalidCheckpointIndex if none found.
+  size_t find_dispensable_releasing_memory() const;
+
+  /// @brief Find the step of the rightmost non-persistent slot.
   size_t find_rightmost_nonpersistent() const;
 
   size_t maxNumSlots_;
-  std::vector<Slot> slots_;  ///< Sorted by step number
+  std::unique_ptr<Index> index_;
   CheckpointMetrics metrics_;
+  EvictionOracle evictionOracle_;
 };
 
 }  // namespace gretl
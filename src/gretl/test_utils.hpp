@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cmath>
 #include "gtest/gtest.h"
 #include "data_store.hpp"
 #include "vector_state.hpp"
@@ -25,22 +26,30 @@ inline double rand_in_range(double x0, double xf)
   return x0 + static_cast<double>(rand()) / static_cast<double>(RAND_MAX) * (xf - x0);
 }
 
-/// @brief Performs a gradient check
+/// @brief Result of a finite difference check of the gradient with respect to one input, along a random direction
+struct GradientError {
+  double directionalDerivative;  ///< back propagated gradient dotted with the direction
+  double finiteDifference;       ///< finite difference of the objective along the direction
+
+  /// @brief absolute difference between the two
+  double error() const { return std::abs(directionalDerivative - finiteDifference); }
+};
+
+/// @brief Computes the gradient errors, e.g. to report the accuracy impact of approximate checkpoint storage
 /// @param objectiveState The double state corresponding to the objective
 /// @param inputStates The persistent states in the graph which can be perturbed for finite differencing
 /// @param eps Vector of finite difference pertubations (one per input state)
-/// @param tol Vector of tolerances for finite difference check (one per input state)
-void check_array_gradients(gretl::State<double>& objectiveState, std::vector<gretl::VectorState> inputStates,
-                           std::vector<double> eps, std::vector<double> tol)
+/// @return One gradient error per input state
+std::vector<GradientError> array_gradient_errors(gretl::State<double>& objectiveState,
+                                                 std::vector<gretl::VectorState> inputStates, std::vector<double> eps)
 {
   double objectiveBase = objectiveState.get();
   srand(5);
 
   size_t num_inputs = inputStates.size();
   gretl_assert(num_inputs == eps.size());
-  gretl_assert(num_inputs == tol.size());
   std::vector<std::vector<double> > perturbedInputs(num_inputs);
-  std::vector<double> directionalDerivs(num_inputs);
+  std::vector<GradientError> errors(num_inputs);
 
   for (size_t iInput = 0; iInput < num_inputs; ++iInput) {
     auto& inputState = inputStates[iInput];
@@ -56,7 +65,7 @@ void check_array_gradients(gretl::State<double>& objectiveState, std::vector<gre
     for (size_t i = 0; i < S; ++i) {
       directionDeriv += pert[i] * grad[i];
     }
-    directionalDerivs[iInput] = directionDeriv;
+    errors[iInput].directionalDerivative = directionDeriv;
     perturbedInput = inputState.get();
     for (size_t i = 0; i < S; ++i) {
       perturbedInput[i] += eps[iInput] * pert[i];
@@ -71,9 +80,25 @@ void check_array_gradients(gretl::State<double>& objectiveState, std::vector<gre
     objectiveState.data_store().reset();
     inputState.set(perturbedInput);
     double objectivePlus = objectiveState.get();
-    EXPECT_NEAR(directionalDerivs[iInput], (objectivePlus - objectiveBase) / eps[iInput], tol[iInput]);
+    errors[iInput].finiteDifference = (objectivePlus - objectiveBase) / eps[iInput];
     inputState.set(s0);
   }
+  return errors;
+}
+
+/// @brief Performs a gradient check
+/// @param objectiveState The double state corresponding to the objective
+/// @param inputStates The persistent states in the graph which can be perturbed for finite differencing
+/// @param eps Vector of finite difference pertubations (one per input state)
+/// @param tol Vector of tolerances for finite difference check (one per input state)
+void check_array_gradients(gretl::State<double>& objectiveState, std::vector<gretl::VectorState> inputStates,
+                           std::vector<double> eps, std::vector<double> tol)
+{
+  gretl_assert(inputStates.size() == tol.size());
+  auto errors = array_gradient_errors(objectiveState, inputStates, eps);
+  for (size_t iInput = 0; iInput < errors.size(); ++iInput) {
+    EXPECT_NEAR(errors[iInput].directionalDerivative, errors[iInput].finiteDifference, tol[iInput]);
+  }
 }
 
 }  // namespace gretl
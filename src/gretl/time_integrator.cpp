@@ -0,0 +1,184 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include "time_integrator.hpp"
+#include "vector_algebra.hpp"
+#include <algorithm>
+#include <string>
+#include <utility>
+
+namespace gretl {
+
+using detail::axpy;
+using detail::norm;
+
+namespace {
+
+/// @brief stage inputs ys and stage rates ks of an explicit Runge-Kutta step
+void compute_stages(const Vector& s0, const Vector& P, double time, double dt, const RateFunction& rate,
+                    const ExplicitTableau& tableau, std::vector<Vector>& ys, std::vector<Vector>& ks)
+{
+  const size_t numStages = tableau.b.size();
+  ys.resize(numStages);
+  ks.resize(numStages);
+  for (size_t i = 0; i < numStages; ++i) {
+    ys[i] = s0;
+    for (size_t j = 0; j < i; ++j) {
+      axpy(dt * tableau.a[i][j], ks[j], ys[i]);
+    }
+    ks[i] = rate(ys[i], P, time + tableau.c[i] * dt);
+    gretl_assert_msg(ks[i].size() == s0.size(), "the rate returned a vector of the wrong size");
+  }
+}
+
+}  // namespace
+
+VectorState explicit_rk_step(const VectorState& s, const VectorState& p, double time, double dt, RateFunction rate,
+                             RateVjp rateVjp, const ExplicitTableau& tableau)
+{
+  const size_t numStages = tableau.b.size();
+  gretl_assert_msg(numStages > 0 && tableau.a.size() == numStages && tableau.c.size() == numStages,
+                   "inconsistent Butcher tableau");
+  for (size_t i = 0; i < numStages; ++i) {
+    gretl_assert_msg(tableau.a[i].size() == i, "an explicit Butcher tableau must be strictly lower triangular");
+  }
+
+  VectorState s1 = s.clone({s, p});
+
+  s1.set_eval([time, dt, rate, tableau](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    const Vector& s0 = upstreams[0].get<Vector>();
+    const Vector& P = upstreams[1].get<Vector>();
+    std::vector<Vector> ys, ks;
+    compute_stages(s0, P, time, dt, rate, tableau, ys, ks);
+    Vector next = s0;
+    for (size_t i = 0; i < ks.size(); ++i) {
+      axpy(dt * tableau.b[i], ks[i], next);
+    }
+    downstream.set(std::move(next));
+  });
+
+  s1.set_vjp([time, dt, rate, rateVjp, tableau](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    const Vector& s0 = upstreams[0].get<Vector>();
+    const Vector& P = upstreams[1].get<Vector>();
+    const Vector& s1Bar = downstream.get_dual<Vector, Vector>();
+    Vector& s0Bar = upstreams[0].get_dual<Vector, Vector>();
+    Vector& pBar = upstreams[1].get_dual<Vector, Vector>();
+
+    // the stages are recomputed rather than stored on the graph
+    std::vector<Vector> ys, ks;
+    compute_stages(s0, P, time, dt, rate, tableau, ys, ks);
+
+    std::vector<Vector> kBars(ks.size());
+    for (size_t i = 0; i < ks.size(); ++i) {
+      kBars[i].assign(s1Bar.size(), 0.0);
+      axpy(dt * tableau.b[i], s1Bar, kBars[i]);
+    }
+    axpy(1.0, s1Bar, s0Bar);
+    for (size_t i = ks.size(); i-- > 0;) {
+      Vector yBar(s0.size(), 0.0);
+      rateVjp(ys[i], P, time + tableau.c[i] * dt, kBars[i], yBar, pBar);
+      axpy(1.0, yBar, s0Bar);
+      for (size_t j = 0; j < i; ++j) {
+        axpy(dt * tableau.a[i][j], yBar, kBars[j]);
+      }
+    }
+  });
+
+  return s1.finalize();
+}
+
+VectorState rk4_step(const VectorState& s, const VectorState& p, double time, double dt, RateFunction rate,
+                     RateVjp rateVjp)
+{
+  static const ExplicitTableau rk4{
+      {{}, {0.5}, {0.0, 0.5}, {0.0, 0.0, 1.0}}, {1.0 / 6.0, 1.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0}, {0.0, 0.5, 0.5, 1.0}};
+  return explicit_rk_step(s, p, time, dt, std::move(rate), std::move(rateVjp), rk4);
+}
+
+VectorState heun_step(const VectorState& s, const VectorState& p, double time, double dt, RateFunction rate,
+                      RateVjp rateVjp)
+{
+  static const ExplicitTableau heun{{{}, {1.0}}, {0.5, 0.5}, {0.0, 1.0}};
+  return explicit_rk_step(s, p, time, dt, std::move(rate), std::move(rateVjp), heun);
+}
+
+VectorState implicit_euler_step(const VectorState& s, const VectorState& p, double time, double dt, RateFunction rate,
+                                RateVjp rateVjp, const ImplicitEulerOptions& options)
+{
+  const double t1 = time + dt;
+  VectorState s1 = s.clone({s, p});
+
+  s1.set_eval([t1, dt, rate, options](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    const Vector& s0 = upstreams[0].get<Vector>();
+    const Vector& P = upstreams[1].get<Vector>();
+    const double target = std::max(options.relativeTolerance * norm(s0), options.absoluteTolerance);
+    ImplicitSolveOptions newtonLinearSolve = options.linearSolve;
+    newtonLinearSolve.relativeTolerance = options.newtonLinearTolerance;
+
+    Vector x = s0;
+    for (size_t iteration = 0;; ++iteration) {
+      Vector f = rate(x, P, t1);
+      gretl_assert_msg(f.size() == x.size(), "the rate returned a vector of the wrong size");
+      Vector residual = x;
+      axpy(-1.0, s0, residual);
+      axpy(-dt, f, residual);
+      double residualNorm = norm(residual);
+      if (residualNorm <= target) {
+        break;
+      }
+      gretl_assert_msg(iteration < options.maxNewtonIterations,
+                       "implicit Euler step did not converge in " + std::to_string(options.maxNewtonIterations) +
+                           " Newton iterations, residual norm " + std::to_string(residualNorm));
+
+      // GMRES only needs the action of the operator, here the finite differenced I - dt d rate/ds
+      const double scale = options.differencingStep * std::max(1.0, norm(x));
+      auto jacobianAction = [&](const Vector& v) {
+        double vNorm = norm(v);
+        Vector Jv = v;
+        if (vNorm == 0.0) {
+          return Jv;
+        }
+        double h = scale / vNorm;
+        Vector perturbed = x;
+        axpy(h, v, perturbed);
+        Vector fPerturbed = rate(perturbed, P, t1);
+        axpy(-dt / h, fPerturbed, Jv);
+        axpy(dt / h, f, Jv);
+        return Jv;
+      };
+      Vector dx = solve_linear_system(jacobianAction, residual, newtonLinearSolve);
+      axpy(-1.0, dx, x);
+    }
+    downstream.set(std::move(x));
+  });
+
+  s1.set_vjp([t1, dt, rateVjp, options](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    const Vector& X = downstream.get<Vector>();
+    const Vector& P = upstreams[1].get<Vector>();
+    const Vector& s1Bar = downstream.get_dual<Vector, Vector>();
+
+    // (I - dt d rate/ds)^T lambda = s1Bar, then s0Bar += lambda and pBar += dt (d rate/dp)^T lambda
+    auto transposeAction = [&](const Vector& v) {
+      Vector sBar(X.size(), 0.0);
+      Vector unusedPBar(P.size(), 0.0);
+      rateVjp(X, P, t1, v, sBar, unusedPBar);
+      Vector result = v;
+      axpy(-dt, sBar, result);
+      return result;
+    };
+    Vector lambda = solve_linear_system(transposeAction, s1Bar, options.linearSolve);
+
+    Vector unusedSBar(X.size(), 0.0);
+    Vector pContribution(P.size(), 0.0);
+    rateVjp(X, P, t1, lambda, unusedSBar, pContribution);
+    axpy(1.0, lambda, upstreams[0].get_dual<Vector, Vector>());
+    axpy(dt, pContribution, upstreams[1].get_dual<Vector, Vector>());
+  });
+
+  return s1.finalize();
+}
+
+}  // namespace gretl
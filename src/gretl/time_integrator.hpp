@@ -0,0 +1,83 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file time_integrator.hpp
+ * @brief Time steps of an ode ds/dt = rate(s, p, t) recorded as a single step of the graph, with the stages recomputed
+ * inside the step's vjp instead of being stored.
+ */
+
+#pragma once
+
+#include <functional>
+#include "implicit_state.hpp"
+#include "vector_state.hpp"
+
+namespace gretl {
+
+/// @brief Rate of an ode, ds/dt = rate(s, p, t)
+using RateFunction = std::function<Vector(const Vector& s, const Vector& p, double t)>;
+
+/// @brief Vector-Jacobian product of a rate: given the dual rBar of the rate, plus-equals (d rate/ds)^T rBar into sBar
+/// and (d rate/dp)^T rBar into pBar
+using RateVjp = std::function<void(const Vector& s, const Vector& p, double t, const Vector& rBar, Vector& sBar,
+                                   Vector& pBar)>;
+
+/// @brief Settings of the Newton solve of an implicit Euler step
+struct ImplicitEulerOptions {
+  double relativeTolerance = 1e-12;     ///< residual norm of the step equation, relative to the norm of the state
+  double absoluteTolerance = 1e-14;     ///< residual norm below which the Newton iterations stop regardless
+  size_t maxNewtonIterations = 50;      ///< Newton iterations before the step is declared to have failed
+  double differencingStep = 1e-7;       ///< relative step of the finite differenced Jacobian actions of the rate
+  double newtonLinearTolerance = 1e-6;  ///< relative tolerance of the GMRES solves of the Newton updates, which only
+                                        ///< need to be inexact
+  ImplicitSolveOptions linearSolve;     ///< settings of the GMRES solves of the vjp, and iteration limits of the Newton
+                                        ///< updates
+};
+
+/// @brief Butcher tableau of an explicit Runge-Kutta method
+struct ExplicitTableau {
+  std::vector<std::vector<double>> a;  ///< stage coefficients, a[i] has i entries
+  std::vector<double> b;               ///< weights of the stages
+  std::vector<double> c;               ///< nodes, fractions of the time step at which the stages are evaluated
+};
+
+/// @brief One step of an explicit Runge-Kutta method as a single step of the graph.  Only the new state is stored; the
+/// vjp recomputes the stages and back propagates through them.  Tangents and Hessian-vector products are not
+/// supported.
+/// @param s state at the start of the step
+/// @param p parameters of the rate
+/// @param time time at the start of the step
+/// @param dt time step
+/// @param rate rate of the ode
+/// @param rateVjp vector-Jacobian product of the rate
+/// @param tableau coefficients of the method
+VectorState explicit_rk_step(const VectorState& s, const VectorState& p, double time, double dt, RateFunction rate,
+                             RateVjp rateVjp, const ExplicitTableau& tableau);
+
+/// @brief Classical fourth order Runge-Kutta step, see explicit_rk_step
+VectorState rk4_step(const VectorState& s, const VectorState& p, double time, double dt, RateFunction rate,
+                     RateVjp rateVjp);
+
+/// @brief Heun's second order step (explicit trapezoidal rule), see explicit_rk_step
+VectorState heun_step(const VectorState& s, const VectorState& p, double time, double dt, RateFunction rate,
+                      RateVjp rateVjp);
+
+/// @brief Implicit Euler step, s1 - s - dt rate(s1, p, time + dt) = 0, as a single step of the graph.  The step is
+/// solved by Newton iterations warm started from s, with GMRES on finite differenced Jacobian actions of the rate.  The
+/// vjp solves the adjoint system (I - dt d rate/ds)^T lambda = s1Bar with the exact rateVjp, as implicit_solve does.
+/// Tangents and Hessian-vector products are not supported.
+/// @param s state at the start of the step
+/// @param p parameters of the rate
+/// @param time time at the start of the step
+/// @param dt time step
+/// @param rate rate of the ode
+/// @param rateVjp vector-Jacobian product of the rate
+/// @param options settings of the Newton and GMRES solves
+VectorState implicit_euler_step(const VectorState& s, const VectorState& p, double time, double dt, RateFunction rate,
+                                RateVjp rateVjp, const ImplicitEulerOptions& options = {});
+
+}  // namespace gretl
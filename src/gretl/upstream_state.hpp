@@ -34,6 +34,20 @@ struct UpstreamState {
   {
     return dataStore_->get_dual<D, T>(step_);
   }
+
+  /// @brief get underlying tangent value
+  template <typename D, typename T>
+  const D& get_tangent() const
+  {
+    return dataStore_->get_tangent<D, T>(step_);
+  }
+
+  /// @brief get underlying dual tangent value
+  template <typename D, typename T>
+  D& get_dual_tangent() const
+  {
+    return dataStore_->get_dual_tangent<D, T>(step_);
+  }
 };
 
 /// @brief UpstreamStates is a wrapper for a vector of states.  Its used in external-facing interfaces to ensure const
@@ -110,6 +124,27 @@ struct DownstreamState {
     return dataStore_->get_dual<D, T>(step_);
   }
 
+  /// @brief set underlying tangent value
+  template <typename D>
+  void set_tangent(D&& d)
+  {
+    dataStore_->set_tangent(step_, std::forward<D>(d));
+  }
+
+  /// @brief get underlying tangent value
+  template <typename D, typename T = D>
+  const D& get_tangent() const
+  {
+    return dataStore_->get_tangent<D, T>(step_);
+  }
+
+  /// @brief get underlying dual tangent value
+  template <typename D, typename T = D>
+  const D& get_dual_tangent() const
+  {
+    return dataStore_->get_dual_tangent<D, T>(step_);
+  }
+
   friend class DataStore;
 
  private:
@@ -0,0 +1,45 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file vector_algebra.hpp
+ * @brief Dense vector operations shared by the implicit solves and the time integrators, for internal use.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include "vector_state.hpp"
+
+namespace gretl {
+
+namespace detail {
+
+/// @brief inner product of a and b
+inline double dot(const Vector& a, const Vector& b)
+{
+  double d = 0.0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    d += a[i] * b[i];
+  }
+  return d;
+}
+
+/// @brief Euclidean norm of a
+inline double norm(const Vector& a) { return std::sqrt(dot(a, a)); }
+
+/// @brief a += s * b
+inline void axpy(double s, const Vector& b, Vector& a)
+{
+  for (size_t i = 0; i < a.size(); ++i) {
+    a[i] += s * b[i];
+  }
+}
+
+}  // namespace detail
+
+}  // namespace gretl
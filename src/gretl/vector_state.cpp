@@ -35,6 +35,24 @@ VectorState testing_update(const VectorState& a)
     }
   });
 
+  b.set_jvp([](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    Vector Bdot = upstreams[0].get_tangent<Vector, Vector>();
+    for (auto& v : Bdot) {
+      v /= 3.0;
+    }
+    downstream.set_tangent(std::move(Bdot));
+  });
+
+  b.set_hvp([](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    Vector& Abardot = upstreams[0].get_dual_tangent<Vector, Vector>();
+    const Vector& Bbardot = downstream.get_dual_tangent<Vector, Vector>();
+    const size_t sz = Bbardot.size();
+
+    for (size_t i = 0; i < sz; ++i) {
+      Abardot[i] += Bbardot[i] / 3.0;
+    }
+  });
+
   return b.finalize();
 }
 
@@ -67,6 +85,31 @@ VectorState operator+(const VectorState& a, const VectorState& b)
     }
   });
 
+  c.set_jvp([](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    Vector Cdot = upstreams[0].get_tangent<Vector, Vector>();
+    const Vector& Bdot = upstreams[1].get_tangent<Vector, Vector>();
+    size_t sz = Cdot.size();
+    for (size_t i = 0; i < sz; ++i) {
+      Cdot[i] += Bdot[i];
+    }
+    downstream.set_tangent(std::move(Cdot));
+  });
+
+  c.set_hvp([](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    const Vector& Cbardot = downstream.get_dual_tangent<Vector, Vector>();
+    size_t sz = Cbardot.size();
+
+    Vector& Abardot = upstreams[0].get_dual_tangent<Vector, Vector>();
+    for (size_t i = 0; i < sz; ++i) {
+      Abardot[i] += Cbardot[i];
+    }
+
+    Vector& Bbardot = upstreams[1].get_dual_tangent<Vector, Vector>();
+    for (size_t i = 0; i < sz; ++i) {
+      Bbardot[i] += Cbardot[i];
+    }
+  });
+
   return c.finalize();
 }
 
@@ -91,6 +134,22 @@ VectorState operator*(const VectorState& a, double b)
     }
   });
 
+  c.set_jvp([b](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    Vector Cdot = upstreams[0].get_tangent<Vector, Vector>();
+    for (auto& v : Cdot) {
+      v *= b;
+    }
+    downstream.set_tangent(std::move(Cdot));
+  });
+
+  c.set_hvp([b](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    const Vector& Cbardot = downstream.get_dual_tangent<Vector, Vector>();
+    Vector& Abardot = upstreams[0].get_dual_tangent<Vector, Vector>();
+    for (size_t i = 0; i < Abardot.size(); ++i) {
+      Abardot[i] += b * Cbardot[i];
+    }
+  });
+
   return c.finalize();
 }
 
@@ -132,6 +191,43 @@ State<double> inner_product(const VectorState& a, const VectorState& b)
     }
   });
 
+  c.set_jvp([](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    const Vector& A = upstreams[0].get<Vector>();
+    const Vector& B = upstreams[1].get<Vector>();
+    const Vector& Adot = upstreams[0].get_tangent<Vector, Vector>();
+    const Vector& Bdot = upstreams[1].get_tangent<Vector, Vector>();
+    size_t sz = get_same_size<double>({&A, &B});
+    double prodDot = 0.0;
+    for (size_t i = 0; i < sz; ++i) {
+      prodDot += Adot[i] * B[i] + A[i] * Bdot[i];
+    }
+    downstream.set_tangent(prodDot);
+  });
+
+  c.set_hvp([](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    double Cbar = downstream.get_dual<double, double>();
+    double Cbardot = downstream.get_dual_tangent<double, double>();
+
+    auto a_ = upstreams[0];
+    auto b_ = upstreams[1];
+
+    const Vector& A = a_.get<Vector>();
+    const Vector& B = b_.get<Vector>();
+    const Vector& Adot = a_.get_tangent<Vector, Vector>();
+    const Vector& Bdot = b_.get_tangent<Vector, Vector>();
+    size_t sz = get_same_size<double>({&A, &B});
+
+    Vector& Abardot = a_.get_dual_tangent<Vector, Vector>();
+    for (size_t i = 0; i < sz; ++i) {
+      Abardot[i] += Bdot[i] * Cbar + B[i] * Cbardot;
+    }
+
+    Vector& Bbardot = b_.get_dual_tangent<Vector, Vector>();
+    for (size_t i = 0; i < sz; ++i) {
+      Bbardot[i] += Adot[i] * Cbar + A[i] * Cbardot;
+    }
+  });
+
   return c.finalize();
 }
 
@@ -171,6 +267,43 @@ VectorState operator*(const VectorState& a, const VectorState& b)
     }
   });
 
+  c.set_jvp([](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    const Vector& A = upstreams[0].get<Vector>();
+    const Vector& B = upstreams[1].get<Vector>();
+    const Vector& Adot = upstreams[0].get_tangent<Vector, Vector>();
+    const Vector& Bdot = upstreams[1].get_tangent<Vector, Vector>();
+    size_t sz = get_same_size<double>({&A, &B});
+    Vector Cdot(Adot);  // copy-construct (avoids zero-init of Vector(sz))
+    for (size_t i = 0; i < sz; ++i) {
+      Cdot[i] = Adot[i] * B[i] + A[i] * Bdot[i];
+    }
+    downstream.set_tangent(std::move(Cdot));
+  });
+
+  c.set_hvp([](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    const Vector& Cbar = downstream.get_dual<Vector, Vector>();
+    const Vector& Cbardot = downstream.get_dual_tangent<Vector, Vector>();
+
+    auto a_ = upstreams[0];
+    auto b_ = upstreams[1];
+
+    const Vector& A = a_.get<Vector>();
+    const Vector& B = b_.get<Vector>();
+    const Vector& Adot = a_.get_tangent<Vector, Vector>();
+    const Vector& Bdot = b_.get_tangent<Vector, Vector>();
+    size_t sz = get_same_size<double>({&A, &B});
+
+    Vector& Abardot = a_.get_dual_tangent<Vector, Vector>();
+    for (size_t i = 0; i < sz; ++i) {
+      Abardot[i] += Bdot[i] * Cbar[i] + B[i] * Cbardot[i];
+    }
+
+    Vector& Bbardot = b_.get_dual_tangent<Vector, Vector>();
+    for (size_t i = 0; i < sz; ++i) {
+      Bbardot[i] += Adot[i] * Cbar[i] + A[i] * Cbardot[i];
+    }
+  });
+
   return c.finalize();
 }
 
@@ -190,6 +323,18 @@ VectorState copy(const VectorState& a)
     }
   });
 
+  b.set_jvp([](const UpstreamStates& upstreams, DownstreamState& downstream) {
+    downstream.set_tangent(upstreams[0].get_tangent<Vector, Vector>());
+  });
+
+  b.set_hvp([](UpstreamStates& upstreams, const DownstreamState& downstream) {
+    const Vector& Bbardot = downstream.get_dual_tangent<Vector, Vector>();
+    Vector& Abardot = upstreams[0].get_dual_tangent<Vector, Vector>();
+    for (size_t i = 0; i < Abardot.size(); ++i) {
+      Abardot[i] += Bbardot[i];
+    }
+  });
+
   return b.finalize();
 }
 
@@ -7,6 +7,7 @@
 #include "wang_checkpoint_strategy.hpp"
 #include <cassert>
 #include <iostream>
+#include <utility>
 
 namespace gretl {
 
@@ -16,13 +17,20 @@ std::set<WangCheckpointStrategy::Checkpoint, WangCheckpointStrategy::CheckpointC
 WangCheckpointStrategy::most_dispensable() const
 {
   size_t maxHigherTimeLevel = 0;
+  auto firstDispensable = cps_.end();
   for (auto rIter = cps_.begin(); rIter != cps_.end(); ++rIter) {
     if (rIter->level < maxHigherTimeLevel) {
-      return rIter;
+      if (!evictionOracle_ || evictionOracle_(rIter->step) > 0) {
+        return rIter;
+      }
+      // pinned, only evicted if no other dispensable checkpoint releases memory
+      if (firstDispensable == cps_.end()) {
+        firstDispensable = rIter;
+      }
     }
     maxHigherTimeLevel = std::max(rIter->level, maxHigherTimeLevel);
   }
-  return cps_.end();
+  return firstDispensable;
 }
 
 size_t WangCheckpointStrategy::add_checkpoint_and_get_index_to_remove(size_t step, bool persistent)
@@ -101,6 +109,61 @@ void WangCheckpointStrategy::reset()
 
 size_t WangCheckpointStrategy::capacity() const { return maxNumStates_; }
 
+std::vector<size_t> WangCheckpointStrategy::set_capacity(size_t maxStates)
+{
+  size_t numPersistent = 0;
+  for (auto cp = cps_.rbegin(); cp != cps_.rend() && cp->level == Checkpoint::infinity(); ++cp) {
+    ++numPersistent;
+  }
+  maxNumStates_ = maxStates + numPersistent;
+
+  // evict as add_checkpoint_and_get_index_to_remove would, without a new checkpoint to promote
+  std::vector<size_t> evicted;
+  while (cps_.size() > maxNumStates_) {
+    auto iterToEvict = most_dispensable();
+    if (iterToEvict == cps_.end()) {
+      iterToEvict = cps_.begin();
+    }
+    evicted.push_back(iterToEvict->step);
+    cps_.erase(iterToEvict);
+    metrics_.evictions++;
+  }
+  return evicted;
+}
+
+bool WangCheckpointStrategy::supports_renumbering() const { return true; }
+
+void WangCheckpointStrategy::renumber_steps(const std::vector<size_t>& newSteps)
+{
+  // the map keeps the order of the steps, so the levels stay where they were
+  std::set<Checkpoint, CheckpointCompare> renumbered;
+  for (const auto& cp : cps_) {
+    size_t step = newSteps[cp.step];
+    if (valid_checkpoint_index(step)) {
+      renumbered.insert(Checkpoint{.level = cp.level, .step = step});
+    } else if (cp.level == Checkpoint::infinity()) {
+      // a persistent checkpoint takes its slot with it
+      maxNumStates_--;
+    }
+  }
+  cps_ = std::move(renumbered);
+}
+
+void WangCheckpointStrategy::make_persistent(size_t step)
+{
+  for (auto it = cps_.begin(); it != cps_.end(); ++it) {
+    if (it->step == step) {
+      if (it->level == Checkpoint::infinity()) {
+        return;
+      }
+      cps_.erase(it);
+      break;
+    }
+  }
+  maxNumStates_++;
+  cps_.insert(Checkpoint{.level = Checkpoint::infinity(), .step = step});
+}
+
 size_t WangCheckpointStrategy::size() const { return cps_.size(); }
 
 void WangCheckpointStrategy::print(std::ostream& os) const
@@ -117,4 +180,6 @@ void WangCheckpointStrategy::reset_metrics() { metrics_ = {}; }
 
 void WangCheckpointStrategy::record_recomputation() { metrics_.recomputations++; }
 
+void WangCheckpointStrategy::set_eviction_oracle(EvictionOracle oracle) { evictionOracle_ = std::move(oracle); }
+
 }  // namespace gretl
@@ -33,11 +33,16 @@ class WangCheckpointStrategy final : public CheckpointStrategy {
   bool contains_step(size_t stepIndex) const override;
   void reset() override;
   size_t capacity() const override;
+  std::vector<size_t> set_capacity(size_t maxStates) override;
+  bool supports_renumbering() const override;
+  void renumber_steps(const std::vector<size_t>& newSteps) override;
+  void make_persistent(size_t step) override;
   size_t size() const override;
   void print(std::ostream& os) const override;
   CheckpointMetrics metrics() const override;
   void reset_metrics() override;
   void record_recomputation() override;
+  void set_eviction_oracle(EvictionOracle oracle) override;
 
  private:
   /// @brief Checkpoint with level for eviction priority (Wang-specific).
@@ -61,12 +66,14 @@ class WangCheckpointStrategy final : public CheckpointStrategy {
     }
   };
 
-  /// @brief Find the most dispensable checkpoint per the Wang algorithm.
+  /// @brief Find the most dispensable checkpoint per the Wang algorithm.  With an eviction oracle, the first
+  /// dispensable checkpoint whose eviction releases memory is preferred.
   std::set<Checkpoint, CheckpointCompare>::const_iterator most_dispensable() const;
 
   size_t maxNumStates_;
   std::set<Checkpoint, CheckpointCompare> cps_;
   CheckpointMetrics metrics_;
+  EvictionOracle evictionOracle_;
 };
 
 }  // namespace gretl
@@ -0,0 +1,85 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file weak_state.hpp
+ * @brief Handles which observe the value of a state without keeping it in memory.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "state.hpp"
+
+namespace gretl {
+
+/// @brief Observes a State without pinning its primal, e.g. for keeping a log of intermediate states for diagnostics.
+/// Every State handle held outside the graph keeps its primal in memory, so logging handles to every step defeats
+/// checkpointing.  A WeakState does not: its state's primal is freed as usual once the checkpoint strategy evicts it.
+/// Reading it after the graph is finalized recomputes it from the last checkpoint if needed, like State::get.  While
+/// building the graph, a freed primal cannot be recomputed, see in_memory.
+/// @tparam T Primal type
+/// @tparam D Dual type
+template <typename T, typename D = T>
+class WeakState {
+ public:
+  /// @brief Construct observing nothing
+  WeakState() = default;
+
+  /// @brief Construct observing a state
+  WeakState(const State<T, D>& state) : data_(state.data_) {}
+
+  /// @brief Check if the observed state is gone: removed from its graph (e.g. by reset_graph), or its DataStore
+  /// destroyed
+  bool expired() const
+  {
+    auto data = data_.lock();
+    return !data || data->lifetimeToken_.expired();
+  }
+
+  /// @brief Step of the observed state
+  Int step() const { return locked()->step_; }
+
+  /// @brief Check if the primal of the observed state is in memory, so get does not recompute it
+  bool in_memory() const { return locked()->primal_ != nullptr; }
+
+  /// @brief Get the primal value, recomputing it from the closest earlier checkpoint if it was freed after the graph
+  /// was finalized.  The reference is valid until the primal is freed again, so copy it to keep it.
+  const T& get() const
+  {
+    DataStore* dataStore;
+    Int step;
+    bool freed;
+    {
+      // not held while recomputing, which may evict the observed step
+      auto data = locked();
+      dataStore = data->dataStore_;
+      step = data->step_;
+      freed = !data->primal_;
+    }
+    if (freed) {
+      gretl_assert_msg(!dataStore->stillConstructingGraph_,
+                       "the primal of step " + std::to_string(step) +
+                           " observed by a WeakState was freed, and cannot be recomputed while building the graph");
+      dataStore->recompute_primal(step);
+    }
+    return dataStore->template get_primal<T>(step);
+  }
+
+ private:
+  /// @brief the observed state's data, asserting it is not expired
+  std::shared_ptr<StateData> locked() const
+  {
+    auto data = data_.lock();
+    gretl_assert_msg(data && !data->lifetimeToken_.expired(), "the state observed by a WeakState no longer exists");
+    return data;
+  }
+
+  std::weak_ptr<StateData> data_;  ///< data shared by the handles of the observed state
+};
+
+}  // namespace gretl
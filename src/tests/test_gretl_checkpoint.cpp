@@ -7,11 +7,13 @@
 #include <stdio.h>
 #include <cmath>
 #include <iostream>
+#include <map>
 #include "gtest/gtest.h"
 #include "gretl/checkpoint.hpp"
 #include "gretl/checkpoint_strategy.hpp"
 #include "gretl/wang_checkpoint_strategy.hpp"
 #include "gretl/strumm_walther_checkpoint_strategy.hpp"
+#include "gretl/replay_checkpoint_strategy.hpp"
 #include "gretl/state.hpp"
 #include "gretl/data_store.hpp"
 
@@ -304,6 +306,45 @@ TEST_P(CheckpointStrategyTest, Functional)
   count = 0;
 }
 
+TEST_P(CheckpointStrategyTest, FunctionalInPlaceVector)
+{
+  using Vector = std::vector<double>;
+  constexpr size_t numSteps = 25;
+
+  Vector x0 = {0.0, 1.0, -2.0};
+  std::vector<Vector> states(numSteps + 1, x0);
+  for (size_t n = 0; n < numSteps; ++n) {
+    for (size_t i = 0; i < x0.size(); ++i) {
+      states[n + 1][i] = advance_solution(states[n][i]);
+    }
+  }
+
+  std::vector<Vector> reverseStates(numSteps + 1);
+  std::vector<size_t> reverseOrder;
+
+  Vector xf = gretl::advance_and_reverse_steps<Vector>(
+      numSteps, x0,
+      [&](size_t, const Vector& x, Vector& xNext) {
+        ASSERT_EQ(x.size(), xNext.size());  // slots keep the shape of the initial condition
+        for (size_t i = 0; i < x.size(); ++i) {
+          xNext[i] = advance_solution(x[i]);
+        }
+      },
+      [&](size_t n, const Vector& x) {
+        reverseStates[n] = x;
+        reverseOrder.push_back(n);
+      },
+      make_strategy(GetParam(), 4));
+
+  EXPECT_EQ(states[numSteps], xf);
+  ASSERT_EQ(reverseOrder.size(), numSteps + 1);
+  for (size_t n = 0; n < numSteps + 1; ++n) {
+    EXPECT_EQ(reverseOrder[n], numSteps - n);
+    ASSERT_EQ(states[n], reverseStates[n]) << strategy_name(GetParam()) << " step " << n << "\n";
+  }
+  count = 0;
+}
+
 TEST_P(CheckpointStrategyTest, Automated)
 {
   double x = 0.0;
@@ -346,6 +387,88 @@ TEST_P(CheckpointStrategyTest, Automated)
   count = 0;
 }
 
+TEST_P(CheckpointStrategyTest, ReplayMatchesWrappedStrategy)
+{
+  constexpr size_t numSteps = 40;
+  constexpr size_t sweeps = 4;
+
+  struct SweepResult {
+    double gradient;
+    size_t recomputations;
+  };
+
+  auto run_sweeps = [&](std::unique_ptr<gretl::CheckpointStrategy> strategy, size_t length,
+                        const gretl::ReplayCheckpointStrategy* replay) {
+    gretl::DataStore dataStore(std::move(strategy));
+    auto X0 = dataStore.create_state<double, double>(1.0);
+    auto X = X0;
+    for (size_t n = 0; n < length; ++n) {
+      X = advance_solution(X);
+    }
+    X = set_as_objective(X);
+    dataStore.back_prop();
+
+    std::vector<SweepResult> results;
+    for (size_t sweep = 0; sweep < sweeps; ++sweep) {
+      dataStore.reset();
+      dataStore.checkpointStrategy_->reset_metrics();
+      X0.set(1.0 + 0.1 * static_cast<double>(sweep));
+      dataStore.reset_for_backprop();
+      X.set_dual(1.0);
+      dataStore.back_prop();
+      results.push_back({X0.get_dual(), dataStore.checkpointStrategy_->metrics().recomputations});
+    }
+    if (replay) {
+      EXPECT_TRUE(replay->replaying());
+      EXPECT_EQ(replay->schedule_position(), replay->schedule().size());
+    }
+    return results;
+  };
+
+  auto expected = run_sweeps(make_strategy(GetParam(), S), numSteps, nullptr);
+
+  auto replay = std::make_unique<gretl::ReplayCheckpointStrategy>(make_strategy(GetParam(), S));
+  auto replayPtr = replay.get();
+  auto replayed = run_sweeps(std::move(replay), numSteps, replayPtr);
+
+  for (size_t sweep = 0; sweep < sweeps; ++sweep) {
+    EXPECT_EQ(expected[sweep].gradient, replayed[sweep].gradient) << strategy_name(GetParam()) << " sweep " << sweep;
+    EXPECT_EQ(expected[sweep].recomputations, replayed[sweep].recomputations)
+        << strategy_name(GetParam()) << " sweep " << sweep;
+  }
+  std::cout << strategy_name(GetParam()) << " replay: schedule length=" << replayPtr->schedule().size()
+            << " recomps/sweep=" << replayed.back().recomputations << std::endl;
+}
+
+TEST_P(CheckpointStrategyTest, ReplayFallsBackWhenGraphChanges)
+{
+  auto replay = std::make_unique<gretl::ReplayCheckpointStrategy>(make_strategy(GetParam(), S));
+  auto replayPtr = replay.get();
+  gretl::DataStore dataStore(std::move(replay));
+  auto X0 = dataStore.create_state<double, double>(1.0);
+
+  for (size_t length : {30, 30, 30, 17, 17, 17}) {
+    dataStore.reset_graph();
+    auto X = X0;
+    for (size_t n = 0; n < length; ++n) {
+      X = advance_solution(X);
+    }
+    X = set_as_objective(X);
+    dataStore.back_prop();
+    ASSERT_NEAR(X0.get_dual(), std::pow(1.0 / 3.0, length), 1e-14) << strategy_name(GetParam()) << " " << length;
+
+    // repeated sweeps of the same graph are replayed, including the first one after a topology change
+    for (size_t sweep = 0; sweep < 3; ++sweep) {
+      dataStore.reset();
+      dataStore.reset_for_backprop();
+      X.set_dual(1.0);
+      dataStore.back_prop();
+      ASSERT_NEAR(X0.get_dual(), std::pow(1.0 / 3.0, length), 1e-14) << strategy_name(GetParam()) << " " << length;
+    }
+    EXPECT_TRUE(replayPtr->replaying());
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(AllStrategies, CheckpointStrategyTest,
                          ::testing::Values(StrategyType::Wang, StrategyType::StrummWalther),
                          [](const ::testing::TestParamInfo<StrategyType>& param_info) {
@@ -7,17 +7,23 @@
 /// @file test_gretl_checkpoint_compare.cpp
 /// @brief Side-by-side comparison of Wang and StrummWalther checkpointing strategies.
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <map>
 #include <iomanip>
+#include <chrono>
 #include <memory>
 #include "gtest/gtest.h"
+#include "gretl/adaptive_checkpoint_strategy.hpp"
 #include "gretl/checkpoint.hpp"
 #include "gretl/checkpoint_strategy.hpp"
+#include "gretl/checkpoint_strategy_registry.hpp"
 #include "gretl/wang_checkpoint_strategy.hpp"
 #include "gretl/strumm_walther_checkpoint_strategy.hpp"
 #include "gretl/state.hpp"
 #include "gretl/data_store.hpp"
+#include "gretl/vector_state.hpp"
 
 namespace {
 
@@ -101,6 +107,43 @@ AlgorithmResult run_datastore_test(std::unique_ptr<gretl::CheckpointStrategy> st
   return {name, dataStore.checkpointStrategy_->metrics(), grad};
 }
 
+using Vector = std::vector<double>;
+
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/// nonlinear pointwise update so that the adjoint depends on the recovered states
+double chain_step(double x) { return 0.5 * std::sin(x) + x / 3.0; }
+
+double chain_step_derivative(double x) { return 0.5 * std::cos(x) + 1.0 / 3.0; }
+
+gretl::VectorState chain_step_state(const gretl::VectorState& a)
+{
+  auto b = a.clone({a});
+
+  b.set_eval([](const gretl::UpstreamStates& upstreams, gretl::DownstreamState& downstream) {
+    Vector B(upstreams[0].get<Vector>());
+    for (auto& v : B) {
+      v = chain_step(v);
+    }
+    downstream.set(std::move(B));
+  });
+
+  b.set_vjp([](gretl::UpstreamStates& upstreams, const gretl::DownstreamState& downstream) {
+    const Vector& A = upstreams[0].get<Vector>();
+    Vector& Abar = upstreams[0].get_dual<Vector, Vector>();
+    const Vector& Bbar = downstream.get_dual<Vector, Vector>();
+    for (size_t i = 0; i < A.size(); ++i) {
+      Abar[i] += Bbar[i] * chain_step_derivative(A[i]);
+    }
+  });
+
+  return b.finalize();
+}
+
 }  // namespace
 
 TEST(CheckpointCompare, ProceduralComparison)
@@ -117,21 +160,21 @@ TEST(CheckpointCompare, ProceduralComparison)
                                  {1000, 50}, {5000, 10}, {5000, 50}, {5000, 100}, {5000, 200}, {5000, 500}};
 
   std::cout << "\n--- Procedural Checkpoint Algorithm Comparison ---\n";
-  std::cout << std::setw(6) << "N" << std::setw(8) << "Budget" << " | " << std::setw(10) << "Algorithm" << std::setw(10)
+  std::cout << std::setw(6) << "N" << std::setw(8) << "Budget" << " | " << std::setw(16) << "Algorithm" << std::setw(10)
             << "stores" << std::setw(10) << "evictions" << std::setw(12) << "recomps" << std::setw(14) << "ratio(r/N)"
             << "\n";
-  std::cout << std::string(72, '-') << "\n";
+  std::cout << std::string(78, '-') << "\n";
 
   for (const auto& cfg : configs) {
-    auto wang_result = run_procedural_test(std::make_unique<gretl::WangCheckpointStrategy>(cfg.budget), "Wang", cfg.N);
-    auto r2_result = run_procedural_test(std::make_unique<gretl::StrummWaltherCheckpointStrategy>(cfg.budget),
-                                         "StrummWalther", cfg.N);
-
-    ASSERT_NEAR(wang_result.gradient, r2_result.gradient, 1e-14)
-        << "Gradient mismatch at N=" << cfg.N << " budget=" << cfg.budget;
+    std::vector<AlgorithmResult> results;
+    for (const auto& name : gretl::registered_checkpoint_strategies()) {
+      results.push_back(run_procedural_test(gretl::make_checkpoint_strategy(name, cfg.budget), name, cfg.N));
+      ASSERT_NEAR(results.front().gradient, results.back().gradient, 1e-14)
+          << "Gradient mismatch for " << name << " at N=" << cfg.N << " budget=" << cfg.budget;
+    }
 
-    for (const auto& r : {wang_result, r2_result}) {
-      std::cout << std::setw(6) << cfg.N << std::setw(8) << cfg.budget << " | " << std::setw(10) << r.name
+    for (const auto& r : results) {
+      std::cout << std::setw(6) << cfg.N << std::setw(8) << cfg.budget << " | " << std::setw(16) << r.name
                 << std::setw(10) << r.metrics.stores << std::setw(10) << r.metrics.evictions << std::setw(12)
                 << r.metrics.recomputations << std::setw(14) << std::fixed << std::setprecision(3)
                 << static_cast<double>(r.metrics.recomputations) / static_cast<double>(cfg.N) << "\n";
@@ -153,22 +196,21 @@ TEST(CheckpointCompare, DataStoreComparison)
                                  {1000, 50}, {5000, 10}, {5000, 50}, {5000, 100}, {5000, 200}, {5000, 500}};
 
   std::cout << "\n--- DataStore Checkpoint Algorithm Comparison ---\n";
-  std::cout << std::setw(6) << "N" << std::setw(8) << "Budget" << " | " << std::setw(10) << "Algorithm" << std::setw(10)
+  std::cout << std::setw(6) << "N" << std::setw(8) << "Budget" << " | " << std::setw(16) << "Algorithm" << std::setw(10)
             << "stores" << std::setw(10) << "evictions" << std::setw(12) << "recomps" << std::setw(14) << "ratio(r/N)"
             << "\n";
-  std::cout << std::string(72, '-') << "\n";
+  std::cout << std::string(78, '-') << "\n";
 
   for (const auto& cfg : configs) {
-    auto wang_result = run_datastore_test(std::make_unique<gretl::WangCheckpointStrategy>(cfg.budget), "Wang", cfg.N);
-    auto r2_result = run_datastore_test(std::make_unique<gretl::StrummWaltherCheckpointStrategy>(cfg.budget),
-                                        "StrummWalther", cfg.N);
-
     double expected_grad = std::pow(1.0 / 3.0, cfg.N);
-    ASSERT_NEAR(wang_result.gradient, expected_grad, 1e-14) << "Wang gradient wrong at N=" << cfg.N;
-    ASSERT_NEAR(r2_result.gradient, expected_grad, 1e-14) << "StrummWalther gradient wrong at N=" << cfg.N;
+    std::vector<AlgorithmResult> results;
+    for (const auto& name : gretl::registered_checkpoint_strategies()) {
+      results.push_back(run_datastore_test(gretl::make_checkpoint_strategy(name, cfg.budget), name, cfg.N));
+      ASSERT_NEAR(results.back().gradient, expected_grad, 1e-14) << name << " gradient wrong at N=" << cfg.N;
+    }
 
-    for (const auto& r : {wang_result, r2_result}) {
-      std::cout << std::setw(6) << cfg.N << std::setw(8) << cfg.budget << " | " << std::setw(10) << r.name
+    for (const auto& r : results) {
+      std::cout << std::setw(6) << cfg.N << std::setw(8) << cfg.budget << " | " << std::setw(16) << r.name
                 << std::setw(10) << r.metrics.stores << std::setw(10) << r.metrics.evictions << std::setw(12)
                 << r.metrics.recomputations << std::setw(14) << std::fixed << std::setprecision(3)
                 << static_cast<double>(r.metrics.recomputations) / static_cast<double>(cfg.N) << "\n";
@@ -176,3 +218,134 @@ TEST(CheckpointCompare, DataStoreComparison)
   }
   std::cout << std::endl;
 }
+
+TEST(CheckpointCompare, AdaptiveTracksBetterStrategy)
+{
+  struct Config {
+    size_t N;
+    size_t budget;
+  };
+
+  std::vector<Config> configs = {{10, 6}, {20, 8}, {50, 20}, {100, 20}, {500, 20}, {1000, 50}, {5000, 200}};
+  constexpr size_t sweeps = 3;
+
+  // recomputations of each repeated sweep (reset + reset_for_backprop + back_prop) of the same graph
+  auto sweep_recomputations = [&](std::unique_ptr<gretl::CheckpointStrategy> strategy, size_t N) {
+    gretl::DataStore dataStore(std::move(strategy));
+    gretl::State<double> X0 = dataStore.create_state<double, double>(0.0);
+    auto X = X0;
+    for (size_t n = 0; n < N; ++n) {
+      X = forward_step_state(X);
+    }
+    X = set_as_objective(X);
+    dataStore.back_prop();
+
+    std::vector<size_t> recomputations;
+    for (size_t sweep = 0; sweep < sweeps; ++sweep) {
+      dataStore.reset();
+      dataStore.checkpointStrategy_->reset_metrics();
+      dataStore.reset_for_backprop();
+      X.set_dual(1.0);
+      dataStore.back_prop();
+      EXPECT_NEAR(X0.get_dual(), std::pow(1.0 / 3.0, N), 1e-14);
+      recomputations.push_back(dataStore.checkpointStrategy_->metrics().recomputations);
+    }
+    return recomputations;
+  };
+
+  std::cout << "\n--- Adaptive Strategy, recomputations per repeated DataStore sweep ---\n";
+  std::cout << std::setw(6) << "N" << std::setw(8) << "Budget" << " | " << std::setw(10) << "wang" << std::setw(16)
+            << "strumm_walther" << std::setw(20) << "adaptive (sweeps)" << "\n";
+  std::cout << std::string(66, '-') << "\n";
+
+  for (const auto& cfg : configs) {
+    auto wang = sweep_recomputations(gretl::make_checkpoint_strategy("wang", cfg.budget), cfg.N);
+    auto strummWalther = sweep_recomputations(gretl::make_checkpoint_strategy("strumm_walther", cfg.budget), cfg.N);
+    auto adaptive = sweep_recomputations(std::make_unique<gretl::AdaptiveCheckpointStrategy>(cfg.budget), cfg.N);
+
+    // once a sweep has been measured, the adaptive strategy runs the better policy
+    EXPECT_EQ(adaptive.back(), std::min(wang.back(), strummWalther.back()))
+        << "N=" << cfg.N << " budget=" << cfg.budget;
+
+    std::cout << std::setw(6) << cfg.N << std::setw(8) << cfg.budget << " | " << std::setw(10) << wang.back()
+              << std::setw(16) << strummWalther.back() << std::setw(8);
+    for (auto r : adaptive) {
+      std::cout << " " << r;
+    }
+    std::cout << "\n";
+  }
+  std::cout << std::endl;
+}
+
+TEST(CheckpointCompare, LinearChainDriverVersusDataStore)
+{
+  struct Config {
+    size_t N;
+    size_t budget;
+    size_t size;
+  };
+
+  std::vector<Config> configs = {{100, 5, 10000}, {500, 10, 10000}, {2000, 20, 1000}, {5000, 50, 100}};
+
+  std::cout << "\n--- Linear Chain: advance_and_reverse_steps vs DataStore (Wang) ---\n";
+  std::cout << std::setw(6) << "N" << std::setw(8) << "Budget" << std::setw(8) << "Size" << " | " << std::setw(14)
+            << "driver(ms)" << std::setw(14) << "datastore(ms)" << std::setw(10) << "speedup" << "\n";
+  std::cout << std::string(64, '-') << "\n";
+
+  for (const auto& cfg : configs) {
+    Vector x0(cfg.size);
+    for (size_t i = 0; i < cfg.size; ++i) {
+      x0[i] = std::sin(static_cast<double>(i));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Vector adjoint(cfg.size, 1.0);
+    gretl::advance_and_reverse_steps<Vector>(
+        cfg.N, x0,
+        [](size_t, const Vector& x, Vector& xNext) {
+          for (size_t i = 0; i < x.size(); ++i) {
+            xNext[i] = chain_step(x[i]);
+          }
+        },
+        [&](size_t n, const Vector& x) {
+          if (n == cfg.N) {
+            return;
+          }
+          for (size_t i = 0; i < x.size(); ++i) {
+            adjoint[i] *= chain_step_derivative(x[i]);
+          }
+        },
+        std::make_unique<gretl::WangCheckpointStrategy>(cfg.budget));
+    double driverMs = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(cfg.budget));
+    auto X0 = dataStore.create_state(x0, gretl::vec::initialize_zero_dual);
+    auto X = X0;
+    for (size_t n = 0; n < cfg.N; ++n) {
+      X = chain_step_state(X);
+    }
+    auto objective = gretl::inner_product(X, gretl::copy(X));
+    gretl::set_as_objective(objective);
+    dataStore.back_prop();
+    double dataStoreMs = elapsed_ms(start);
+
+    // d/dx0 of x_N . x_N is 2 x_N * dx_N/dx0, so rescale the driver's adjoint to compare
+    const Vector& dataStoreGradient = X0.get_dual();
+    Vector xN = x0;
+    for (size_t n = 0; n < cfg.N; ++n) {
+      for (auto& v : xN) {
+        v = chain_step(v);
+      }
+    }
+    for (size_t i = 0; i < cfg.size; ++i) {
+      ASSERT_NEAR(dataStoreGradient[i], 2.0 * xN[i] * adjoint[i], 1e-12 * std::max(1.0, std::abs(adjoint[i])))
+          << "gradient mismatch at N=" << cfg.N << " i=" << i;
+    }
+
+    std::cout << std::setw(6) << cfg.N << std::setw(8) << cfg.budget << std::setw(8) << cfg.size << " | "
+              << std::setw(14) << std::fixed << std::setprecision(2) << driverMs << std::setw(14) << dataStoreMs
+              << std::setw(10) << dataStoreMs / driverMs << "\n";
+  }
+  std::cout << std::endl;
+}
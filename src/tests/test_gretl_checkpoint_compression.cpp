@@ -0,0 +1,197 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gretl/checkpoint_compression.hpp"
+#include "gretl/data_store.hpp"
+#include "gretl/state.hpp"
+#include "gretl/vector_state.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+
+namespace {
+
+gretl::Vector smooth_field(size_t size)
+{
+  gretl::Vector v(size);
+  for (size_t i = 0; i < size; ++i) {
+    v[i] = 1.0 + 0.25 * std::sin(0.01 * static_cast<double>(i));
+  }
+  return v;
+}
+
+gretl::Vector random_bits(size_t size)
+{
+  std::mt19937_64 random(7);
+  gretl::Vector v(size);
+  for (auto& x : v) {
+    std::uint64_t bits = random();
+    std::memcpy(&x, &bits, sizeof(x));
+  }
+  return v;
+}
+
+bool bitwise_equal(const gretl::Vector& a, const gretl::Vector& b)
+{
+  return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+}
+
+gretl::Vector round_trip(const gretl::PrimalCodec& codec, const gretl::Vector& v, double& ratio)
+{
+  gretl::CompressedPrimal compressed;
+  EXPECT_TRUE(codec.compress(v, compressed));
+  ratio = static_cast<double>(compressed.rawBytes) / static_cast<double>(compressed.bytes.size());
+  return std::any_cast<gretl::Vector>(codec.decompress(compressed));
+}
+
+}  // namespace
+
+TEST(CheckpointCompression, LosslessRoundTrip)
+{
+  gretl::FloatingPointCodec codec;
+  double ratio;
+
+  gretl::Vector smooth = smooth_field(10000);
+  EXPECT_TRUE(bitwise_equal(smooth, round_trip(codec, smooth, ratio)));
+  EXPECT_GT(ratio, 1.1);
+
+  gretl::Vector constant(1000, 3.5);
+  EXPECT_TRUE(bitwise_equal(constant, round_trip(codec, constant, ratio)));
+  EXPECT_GT(ratio, 50.0);
+
+  // incompressible data is left uncompressed
+  gretl::CompressedPrimal compressed;
+  EXPECT_FALSE(codec.compress(random_bits(1000), compressed));
+  EXPECT_FALSE(codec.compress(std::any(2.0), compressed));
+  EXPECT_FALSE(codec.compress(std::any(std::string("not a field")), compressed));
+}
+
+TEST(CheckpointCompression, LossyRoundTripRespectsErrorBound)
+{
+  gretl::Vector smooth = smooth_field(10000);
+  double previousRatio = 1.0;
+  int previousBits = std::numeric_limits<double>::digits;
+  for (double bound : {1e-12, 1e-8, 1e-4}) {
+    gretl::FloatingPointCodec codec(bound);
+    double ratio;
+    gretl::Vector restored = round_trip(codec, smooth, ratio);
+    for (size_t i = 0; i < smooth.size(); ++i) {
+      ASSERT_LE(std::abs(restored[i] - smooth[i]), bound * std::abs(smooth[i])) << "bound " << bound << " at " << i;
+    }
+    EXPECT_LT(codec.mantissa_bits(), previousBits);
+    EXPECT_GT(ratio, previousRatio);
+    previousBits = codec.mantissa_bits();
+    previousRatio = ratio;
+  }
+}
+
+TEST(CheckpointCompression, Float32RoundTrip)
+{
+  gretl::Float32Codec codec;
+  double ratio;
+  gretl::Vector field = random_bits(100);
+  for (auto& x : field) {
+    x = std::isfinite(x) ? std::fmod(x, 1e30) : 1.0;
+  }
+  gretl::Vector restored = round_trip(codec, field, ratio);
+  for (size_t i = 0; i < field.size(); ++i) {
+    EXPECT_EQ(static_cast<double>(static_cast<float>(field[i])), restored[i]);
+  }
+  EXPECT_NEAR(ratio, 800.0 / 408.0, 1e-12);
+}
+
+TEST(CheckpointCompression, Float32KeepsLargeMagnitudes)
+{
+  gretl::Float32Codec codec;
+  gretl::CompressedPrimal compressed;
+  gretl::Vector field = smooth_field(100);
+  field[40] = -1e39;
+  EXPECT_FALSE(codec.compress(field, compressed));
+
+  // a state beyond the float range keeps its double checkpoints, and the gradient stays exact
+  auto run = [](std::shared_ptr<const gretl::PrimalCodec> primalCodec) {
+    gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(4));
+    dataStore.set_checkpoint_compression(primalCodec);
+    gretl::Vector large = smooth_field(200);
+    for (auto& x : large) {
+      x *= 1e100;
+    }
+    auto x0 = dataStore.create_state(large, gretl::vec::initialize_zero_dual);
+    auto x = x0;
+    for (size_t n = 0; n < 30; ++n) {
+      x = x + 1e-104 * (x * x);
+    }
+    gretl::set_as_objective(gretl::inner_product(x, x));
+    dataStore.back_prop();
+    return x0.get_dual();
+  };
+  gretl::Vector expected = run(nullptr);
+  gretl::Vector gradient = run(gretl::make_float32_codec());
+  for (double g : gradient) {
+    EXPECT_TRUE(std::isfinite(g));
+  }
+  EXPECT_TRUE(bitwise_equal(expected, gradient));
+}
+
+TEST(CheckpointCompression, DataStoreGradients)
+{
+  constexpr size_t N = 60;
+  constexpr size_t budget = 8;
+  constexpr size_t size = 2000;
+
+  auto run = [&](std::shared_ptr<const gretl::PrimalCodec> codec, double bound, gretl::CompressionMetrics& metrics) {
+    gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+    dataStore.set_checkpoint_compression(codec);
+    auto x0 = dataStore.create_state(smooth_field(size), gretl::vec::initialize_zero_dual);
+    auto x = x0;
+    for (size_t n = 0; n < N; ++n) {
+      x = x + 0.01 * (x * x);
+    }
+    auto objective = gretl::set_as_objective(gretl::inner_product(x, x));
+    dataStore.back_prop();
+    gretl::Vector gradient = x0.get_dual();
+
+    // a repeated sweep recomputes, compresses and decompresses again
+    dataStore.reset();
+    dataStore.reset_for_backprop();
+    objective.set_dual(1.0);
+    dataStore.back_prop();
+    if (bound == 0.0) {
+      EXPECT_TRUE(bitwise_equal(gradient, x0.get_dual()));
+    } else {
+      for (size_t i = 0; i < size; ++i) {
+        EXPECT_NEAR(gradient[i], x0.get_dual()[i], 1e3 * bound * std::abs(gradient[i]));
+      }
+    }
+
+    metrics = dataStore.compression_metrics();
+    return gradient;
+  };
+
+  gretl::CompressionMetrics metrics;
+  gretl::Vector expected = run(nullptr, 0.0, metrics);
+  EXPECT_EQ(0u, metrics.compressions);
+
+  gretl::Vector lossless = run(gretl::make_floating_point_codec(), 0.0, metrics);
+  EXPECT_TRUE(bitwise_equal(expected, lossless));
+  EXPECT_GT(metrics.compressions, 0u);
+  EXPECT_GT(metrics.decompressions, 0u);
+  EXPECT_GT(metrics.ratio(), 1.1);
+  double losslessRatio = metrics.ratio();
+
+  constexpr double bound = 1e-10;
+  gretl::Vector lossy = run(gretl::make_floating_point_codec(bound), bound, metrics);
+  for (size_t i = 0; i < size; ++i) {
+    EXPECT_NEAR(expected[i], lossy[i], 1e3 * bound * std::abs(expected[i]));
+  }
+  EXPECT_GT(metrics.ratio(), losslessRatio);
+}
@@ -0,0 +1,225 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gretl/checkpoint_file.hpp"
+#include "gretl/checkpointed_call.hpp"
+#include "gretl/data_store.hpp"
+#include "gretl/state.hpp"
+#include "gretl/vector_state.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+
+namespace {
+
+size_t evaluations = 0;
+
+/// y = x + dt p[0] x^2, counting forward evaluations
+gretl::VectorState counted_step(const gretl::VectorState& x, const gretl::VectorState& p)
+{
+  auto y = x.clone({x, p});
+  y.set_eval([](const gretl::UpstreamStates& inputs, gretl::DownstreamState& output) {
+    ++evaluations;
+    const auto& xv = inputs[0].get<gretl::Vector>();
+    const auto& pv = inputs[1].get<gretl::Vector>();
+    gretl::Vector yv(xv.size());
+    for (size_t i = 0; i < xv.size(); ++i) {
+      yv[i] = xv[i] + 0.01 * pv[0] * xv[i] * xv[i];
+    }
+    output.set(std::move(yv));
+  });
+  y.set_vjp([](gretl::UpstreamStates& inputs, const gretl::DownstreamState& output) {
+    const auto& xv = inputs[0].get<gretl::Vector>();
+    const auto& pv = inputs[1].get<gretl::Vector>();
+    const auto& yBar = output.get_dual<gretl::Vector>();
+    auto& xBar = inputs[0].get_dual<gretl::Vector, gretl::Vector>();
+    auto& pBar = inputs[1].get_dual<gretl::Vector, gretl::Vector>();
+    for (size_t i = 0; i < xv.size(); ++i) {
+      xBar[i] += (1.0 + 0.02 * pv[0] * xv[i]) * yBar[i];
+      pBar[0] += 0.01 * xv[i] * xv[i] * yBar[i];
+    }
+  });
+  return y.finalize();
+}
+
+struct Graph {
+  gretl::VectorState x0;
+  gretl::VectorState p;
+  gretl::State<double> objective;
+};
+
+Graph build_graph(gretl::DataStore& dataStore, size_t numSteps)
+{
+  auto x0 = dataStore.create_state(gretl::Vector{0.3, -0.2, 0.5, 0.1}, gretl::vec::initialize_zero_dual);
+  auto p = dataStore.create_state(gretl::Vector{1.5}, gretl::vec::initialize_zero_dual);
+  auto x = x0;
+  for (size_t n = 0; n < numSteps; ++n) {
+    x = counted_step(x, p);
+  }
+  auto objective = gretl::set_as_objective(gretl::inner_product(x, x));
+  return Graph{x0, p, objective};
+}
+
+class CheckpointFileFixture : public ::testing::Test {
+ public:
+  void TearDown() override { std::filesystem::remove(path); }
+
+  std::string path = (std::filesystem::temp_directory_path() / "gretl_test_checkpoint_file.bin").string();
+  size_t numSteps = 50;
+  size_t budget = 6;
+};
+
+}  // namespace
+
+TEST_F(CheckpointFileFixture, RestoreBackPropagatesWithoutForwardPass)
+{
+  // first job: forward pass, save, back propagate
+  gretl::Vector x0Gradient;
+  gretl::Vector pGradient;
+  double objectiveValue;
+  size_t recomputations;
+  {
+    gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+    auto graph = build_graph(dataStore, numSteps);
+    objectiveValue = graph.objective.get();
+    gretl::save_checkpoint_file(dataStore, path);
+    dataStore.checkpointStrategy_->reset_metrics();
+    dataStore.back_prop();
+    x0Gradient = graph.x0.get_dual();
+    pGradient = graph.p.get_dual();
+    recomputations = dataStore.checkpointStrategy_->metrics().recomputations;
+  }
+
+  // later job: rebuild the graph from the file, nothing is evaluated until back propagation needs it
+  auto file = gretl::CheckpointFile::open(path);
+  EXPECT_EQ(numSteps + 3, file->num_steps());  // x0, p, the steps and the inner product
+  gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+  dataStore.restore_from(file);
+  evaluations = 0;
+  auto graph = build_graph(dataStore, numSteps);
+  EXPECT_EQ(0u, evaluations);
+  EXPECT_EQ(objectiveValue, graph.objective.get());
+
+  dataStore.back_prop();
+  EXPECT_EQ(x0Gradient, graph.x0.get_dual());
+  EXPECT_EQ(pGradient, graph.p.get_dual());
+  EXPECT_EQ(recomputations, dataStore.checkpointStrategy_->metrics().recomputations);
+  EXPECT_EQ(recomputations, evaluations);
+
+  // the restored graph behaves like any other on repeated sweeps
+  dataStore.reset();
+  dataStore.reset_for_backprop();
+  graph.objective.set_dual(1.0);
+  dataStore.back_prop();
+  EXPECT_EQ(x0Gradient, graph.x0.get_dual());
+}
+
+TEST_F(CheckpointFileFixture, RestoredCheckpointedCallIsNotEvaluated)
+{
+  auto build = [&](gretl::DataStore& dataStore, bool givenZeroDual) {
+    auto x0 = dataStore.create_state(gretl::Vector{0.3, -0.2, 0.5, 0.1}, gretl::vec::initialize_zero_dual);
+    auto p = dataStore.create_state(gretl::Vector{1.5}, gretl::vec::initialize_zero_dual);
+    auto x = x0;
+    for (size_t n = 0; n < numSteps; ++n) {
+      x = givenZeroDual ? gretl::checkpointed_call(counted_step, gretl::vec::initialize_zero_dual, x, p)
+                        : gretl::checkpointed_call(counted_step, x, p);
+    }
+    gretl::set_as_objective(gretl::inner_product(x, x));
+    return x0;
+  };
+
+  gretl::Vector x0Gradient;
+  {
+    gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+    auto x0 = build(dataStore, false);
+    gretl::save_checkpoint_file(dataStore, path);
+    dataStore.back_prop();
+    x0Gradient = x0.get_dual();
+  }
+
+  // the dual initializer of the output would otherwise be learned by evaluating the step
+  {
+    gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+    dataStore.restore_from(gretl::CheckpointFile::open(path));
+    EXPECT_THROW(build(dataStore, false), std::runtime_error);
+  }
+
+  gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+  dataStore.restore_from(gretl::CheckpointFile::open(path));
+  evaluations = 0;
+  auto x0 = build(dataStore, true);
+  EXPECT_EQ(0u, evaluations);
+  dataStore.back_prop();
+  EXPECT_EQ(x0Gradient, x0.get_dual());
+}
+
+TEST_F(CheckpointFileFixture, MismatchedGraphIsRejected)
+{
+  {
+    gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+    build_graph(dataStore, numSteps);
+    gretl::save_checkpoint_file(dataStore, path);
+  }
+
+  gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+  dataStore.restore_from(gretl::CheckpointFile::open(path));
+  auto x0 = dataStore.create_state(gretl::Vector{0.3, -0.2, 0.5, 0.1}, gretl::vec::initialize_zero_dual);
+  auto p = dataStore.create_state(gretl::Vector{1.5}, gretl::vec::initialize_zero_dual);
+  // the saved graph's first step uses x0 and p, not p twice
+  EXPECT_THROW(counted_step(p, p), std::runtime_error);
+}
+
+TEST_F(CheckpointFileFixture, InvalidFilesAreRejected)
+{
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "not a checkpoint file, but long enough to hold a header";
+  }
+  EXPECT_THROW(gretl::CheckpointFile::open(path), std::runtime_error);
+
+  {
+    gretl::DataStore dataStore(std::make_unique<gretl::WangCheckpointStrategy>(budget));
+    build_graph(dataStore, numSteps);
+    gretl::save_checkpoint_file(dataStore, path);
+  }
+  // bump the version
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(8);
+    std::uint32_t version = gretl::CheckpointFile::version + 1;
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  }
+  EXPECT_THROW(gretl::CheckpointFile::open(path), std::runtime_error);
+}
+
+TEST(CheckpointFile, SerializerRegistration)
+{
+  EXPECT_NE(nullptr, gretl::find_primal_serializer(std::type_index(typeid(gretl::Vector))));
+  EXPECT_EQ(nullptr, gretl::find_primal_serializer("vector<int>"));
+
+  gretl::register_primal_serializer<std::vector<int>>(
+      "vector<int>",
+      [](const std::vector<int>& values, std::vector<std::uint8_t>& bytes) {
+        auto begin = reinterpret_cast<const std::uint8_t*>(values.data());
+        bytes.insert(bytes.end(), begin, begin + values.size() * sizeof(int));
+      },
+      [](const std::uint8_t* bytes, size_t size) {
+        std::vector<int> values(size / sizeof(int));
+        std::memcpy(values.data(), bytes, size);
+        return values;
+      });
+
+  auto serializer = gretl::find_primal_serializer("vector<int>");
+  ASSERT_NE(nullptr, serializer);
+  EXPECT_EQ(serializer, gretl::find_primal_serializer(std::type_index(typeid(std::vector<int>))));
+  std::vector<std::uint8_t> bytes;
+  serializer->write(std::vector<int>{3, 1, 4}, bytes);
+  EXPECT_EQ((std::vector<int>{3, 1, 4}), std::any_cast<std::vector<int>>(serializer->read(bytes.data(), bytes.size())));
+}
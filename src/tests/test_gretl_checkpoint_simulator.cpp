@@ -0,0 +1,118 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/// @file test_gretl_checkpoint_simulator.cpp
+/// @brief The data-free checkpoint simulator predicts the recomputations of the real checkpointed drivers.
+
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gretl/checkpoint.hpp"
+#include "gretl/checkpoint_simulator.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+#include "gretl/strumm_walther_checkpoint_strategy.hpp"
+
+namespace {
+
+std::unique_ptr<gretl::CheckpointStrategy> make_wang(size_t budget)
+{
+  return std::make_unique<gretl::WangCheckpointStrategy>(budget);
+}
+
+std::unique_ptr<gretl::CheckpointStrategy> make_strumm_walther(size_t budget)
+{
+  return std::make_unique<gretl::StrummWaltherCheckpointStrategy>(budget);
+}
+
+}  // namespace
+
+TEST(CheckpointSimulator, MatchesLinearChainDriver)
+{
+  std::vector<gretl::CheckpointStrategyFactory> factories = {make_wang, make_strumm_walther};
+  for (const auto& factory : factories) {
+    for (size_t numSteps : {1, 10, 100, 1000}) {
+      for (size_t budget : {2, 5, 20}) {
+        size_t updates = 0;
+        auto strategy = factory(budget);
+        gretl::advance_and_reverse_steps<double>(
+            numSteps, 0.0, [&](size_t, const double& x, double& xNext) {
+              ++updates;
+              xNext = x + 1.0;
+            },
+            [](size_t, const double&) {}, std::move(strategy));
+
+        auto simulated = factory(budget);
+        auto result = gretl::simulate_checkpointing(numSteps, *simulated);
+        EXPECT_EQ(result.metrics.recomputations + numSteps, updates) << numSteps << " " << budget;
+        EXPECT_DOUBLE_EQ(result.forwardCost, static_cast<double>(numSteps));
+        EXPECT_DOUBLE_EQ(result.recomputeCost, static_cast<double>(result.metrics.recomputations));
+
+        // the persistent initial condition, the budget, and the state being computed
+        EXPECT_LE(result.peakCheckpoints, budget + 2);
+        EXPECT_DOUBLE_EQ(result.peakMemory, static_cast<double>(result.peakCheckpoints));
+
+        size_t timelineRecomputations = 0;
+        for (const auto& event : result.timeline) {
+          EXPECT_LT(event.fromStep, event.step);
+          EXPECT_EQ(event.fromStep + event.recomputations, event.step);
+          timelineRecomputations += event.recomputations;
+        }
+        EXPECT_EQ(timelineRecomputations, result.metrics.recomputations);
+      }
+    }
+  }
+}
+
+TEST(CheckpointSimulator, CostAndMemoryModels)
+{
+  size_t numSteps = 200;
+  auto cost = gretl::parse_step_model("linear:1,0.5");
+  auto memory = gretl::parse_step_model("const:8");
+
+  gretl::WangCheckpointStrategy strategy(10);
+  auto result = gretl::simulate_checkpointing(numSteps, strategy, cost, memory);
+
+  double forward = 0.0;
+  for (size_t n = 0; n < numSteps; ++n) {
+    forward += 1.0 + 0.5 * static_cast<double>(n);
+  }
+  EXPECT_DOUBLE_EQ(result.forwardCost, forward);
+  double recompute = 0.0;
+  for (const auto& event : result.timeline) {
+    for (size_t n = event.fromStep; n < event.step; ++n) {
+      recompute += cost(n);
+    }
+  }
+  EXPECT_DOUBLE_EQ(result.recomputeCost, recompute);
+  EXPECT_DOUBLE_EQ(result.peakMemory, 8.0 * static_cast<double>(result.peakCheckpoints));
+
+  EXPECT_THROW(gretl::parse_step_model("linear:1"), std::runtime_error);
+  EXPECT_THROW(gretl::parse_step_model("quadratic:1,2,3"), std::runtime_error);
+  EXPECT_THROW(gretl::parse_step_model("file:/nonexistent/gretl_costs.txt"), std::runtime_error);
+}
+
+TEST(CheckpointSimulator, BudgetSweepIsMonotone)
+{
+  size_t numSteps = 500;
+  std::vector<size_t> budgets(30);
+  std::iota(budgets.begin(), budgets.end(), size_t(2));
+
+  std::vector<gretl::CheckpointStrategyFactory> factories = {make_wang, make_strumm_walther};
+  for (const auto& factory : factories) {
+    auto points = gretl::sweep_checkpoint_budgets(numSteps, factory, budgets);
+    ASSERT_EQ(points.size(), budgets.size());
+    for (const auto& point : points) {
+      EXPECT_LE(point.result.peakCheckpoints, point.budget + 2);
+      EXPECT_GE(point.result.cost_ratio(), 1.0);
+    }
+    EXPECT_LT(points.back().result.metrics.recomputations, points.front().result.metrics.recomputations);
+    // 31 checkpoints cover 500 steps with at most two recomputations of each step (binomial(33, 2) = 528)
+    EXPECT_LE(points.back().result.cost_ratio(), 3.0);
+    EXPECT_GT(points.front().result.cost_ratio(), 4.0 * points.back().result.cost_ratio());
+  }
+}
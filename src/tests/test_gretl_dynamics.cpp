@@ -10,11 +10,15 @@
 #include <iostream>
 #include <array>
 #include <functional>
+#include <tuple>
+#include <vector>
 #include "gtest/gtest.h"
 #include "gretl/checkpoint.hpp"
+#include "gretl/checkpointed_call.hpp"
 #include "gretl/wang_checkpoint_strategy.hpp"
 #include "gretl/state.hpp"
 #include "gretl/test_utils.hpp"
+#include "gretl/time_integrator.hpp"
 #include "gretl/vector_state.hpp"
 
 static constexpr size_t numParams = 4;
@@ -39,40 +43,42 @@ State rk4(const State& state0, double time, double dt, std::function<State(State
   return state3 + tau * k4;
 }
 
-State state_rate_equation(const State& state, const Param& params, [[maybe_unused]] double time)
+State::type lorenz_rate(const State::type& s, const Param::type& p, [[maybe_unused]] double time)
 {
-  auto newState = state.clone(std::vector<gretl::StateBase>{state, params});
+  State::type sNew = s;
+  sNew[0] = p[0] * (s[1] - s[0]);
+  sNew[1] = s[0] * (p[1] - s[2]) - s[1];
+  sNew[2] = s[0] * s[1] - p[2] * s[2];
+  return sNew;
+}
 
-  newState.set_eval([](const gretl::UpstreamStates& inputs, gretl::DownstreamState& output) {
-    const State::type& s = inputs[0].get<State::type>();
-    const Param::type& p = inputs[1].get<Param::type>();
+void lorenz_rate_vjp(const State::type& s, const Param::type& p, [[maybe_unused]] double time,
+                     const State::type& sNewBar, State::dual_type& sBar, Param::dual_type& pBar)
+{
+  sBar.resize(s.size());
+  sBar[0] += -p[0] * sNewBar[0] + (p[1] - s[2]) * sNewBar[1] + s[1] * sNewBar[2];
+  sBar[1] += p[0] * sNewBar[0] - sNewBar[1] + s[0] * sNewBar[2];
+  sBar[2] += -s[0] * sNewBar[1] - p[2] * sNewBar[2];
 
-    State::type sNew = s;
-    sNew[0] = p[0] * (s[1] - s[0]);
-    sNew[1] = s[0] * (p[1] - s[2]) - s[1];
-    sNew[2] = s[0] * s[1] - p[2] * s[2];
-    output.set(std::move(sNew));
+  pBar.resize(p.size());
+  pBar[0] += (s[1] - s[0]) * sNewBar[0];
+  pBar[1] += s[0] * sNewBar[1];
+  pBar[2] -= s[2] * sNewBar[2];
+}
+
+State state_rate_equation(const State& state, const Param& params, double time)
+{
+  auto newState = state.clone(std::vector<gretl::StateBase>{state, params});
+
+  newState.set_eval([time](const gretl::UpstreamStates& inputs, gretl::DownstreamState& output) {
+    output.set(lorenz_rate(inputs[0].get<State::type>(), inputs[1].get<Param::type>(), time));
   });
 
-  newState.set_vjp([](gretl::UpstreamStates& inputs, const gretl::DownstreamState& output) {
+  newState.set_vjp([time](gretl::UpstreamStates& inputs, const gretl::DownstreamState& output) {
     auto state_ = inputs[0];
     auto params_ = inputs[1];
-
-    const State::type& s = state_.get<State::type>();
-    const Param::type& p = params_.get<Param::type>();
-    const State::type& sNewBar = output.get_dual<State::type>();
-
-    State::dual_type& sBar = state_.get_dual<State::dual_type, State::type>();
-    sBar.resize(s.size());
-    sBar[0] += -p[0] * sNewBar[0] + (p[1] - s[2]) * sNewBar[1] + s[1] * sNewBar[2];
-    sBar[1] += p[0] * sNewBar[0] - sNewBar[1] + s[0] * sNewBar[2];
-    sBar[2] += -s[0] * sNewBar[1] - p[2] * sNewBar[2];
-
-    Param::dual_type& pBar = params_.get_dual<Param::dual_type, Param::type>();
-    pBar.resize(p.size());
-    pBar[0] += (s[1] - s[0]) * sNewBar[0];
-    pBar[1] += s[0] * sNewBar[1];
-    pBar[2] -= s[2] * sNewBar[2];
+    lorenz_rate_vjp(state_.get<State::type>(), params_.get<Param::type>(), time, output.get_dual<State::type>(),
+                    state_.get_dual<State::dual_type, State::type>(), params_.get_dual<Param::dual_type, Param::type>());
   });
 
   return newState.finalize();
@@ -92,6 +98,32 @@ class MeshFixture : public ::testing::Test {
   double totalTime = 0.01;
   size_t N = 20;
   double dt = totalTime / static_cast<double>(N);
+
+  struct Rk4Graph {
+    Param params;
+    State state0;
+    gretl::State<double> objective;
+  };
+
+  /// @brief integrate the Lorenz system over N rk4 steps in dataStore, with the squared norm of the final state as
+  /// the objective.  afterStep is called on the state of every step.
+  Rk4Graph build_rk4_graph(const std::function<void(State&)>& afterStep = nullptr)
+  {
+    Param params = dataStore->create_state(params_data, gretl::vec::initialize_zero_dual);
+    State state0 = dataStore->create_state(state0_data, gretl::vec::initialize_zero_dual);
+
+    State state = copy(state0);
+    for (size_t i = 0; i < N; ++i) {
+      double i_double = static_cast<double>(i);
+      state = rk4(state, i_double * dt, dt,
+                  [params](const State& curState, double time) { return state_rate_equation(curState, params, time); });
+      if (afterStep) {
+        afterStep(state);
+      }
+    }
+    gretl::State<double> objective = set_as_objective(gretl::inner_product(state, state));
+    return Rk4Graph{params, state0, objective};
+  }
 };
 
 TEST_F(MeshFixture, NonlinearGraphGradients)
@@ -110,17 +142,7 @@ TEST_F(MeshFixture, NonlinearGraphGradients)
 
 TEST_F(MeshFixture, Dynamics)
 {
-  Param params = dataStore->create_state(params_data, gretl::vec::initialize_zero_dual);
-  State state0 = dataStore->create_state(state0_data, gretl::vec::initialize_zero_dual);
-
-  State state = copy(state0);
-  for (size_t i = 0; i < N; ++i) {
-    double i_double = static_cast<double>(i);
-    state = rk4(state, i_double * dt, dt,
-                [params](const State& curState, double time) { return state_rate_equation(curState, params, time); });
-  }
-
-  gretl::State<double> stateNorm = set_as_objective(gretl::inner_product(state, state));
+  auto [params, state0, stateNorm] = build_rk4_graph();
   dataStore->back_prop();
 
   for (size_t i = 0; i < numParams; ++i) {
@@ -130,3 +152,165 @@ TEST_F(MeshFixture, Dynamics)
   double constexpr eps = 1e-7;
   check_array_gradients(stateNorm, {state0, params}, {eps, eps}, {40 * eps, 40 * eps});
 }
+
+TEST_F(MeshFixture, LiveCutCheckpoints)
+{
+  auto stored_primals = [](const gretl::DataStore& store) {
+    size_t count = 0;
+    for (gretl::Int step = 0; step < store.states_.size(); ++step) {
+      if (!store.is_persistent(step) && store.states_[step]->primal()) {
+        ++count;
+      }
+    }
+    return count;
+  };
+
+  std::array<std::vector<double>, 2> sensitivities;
+  std::array<size_t, 2> storedAfterForward;
+  std::array<size_t, 2> storedAfterRefill;
+  for (size_t liveCut : {0, 1}) {
+    dataStore = std::make_shared<gretl::DataStore>(std::make_unique<gretl::WangCheckpointStrategy>(20));
+    dataStore->set_live_cut_checkpoints(liveCut);
+    auto [params, state0, stateNorm] = build_rk4_graph();
+
+    storedAfterForward[liveCut] = stored_primals(*dataStore);
+    dataStore->back_prop();
+    sensitivities[liveCut] = params.get_dual();
+
+    dataStore->reset();
+    dataStore->reset_for_backprop();
+    storedAfterRefill[liveCut] = stored_primals(*dataStore);
+    stateNorm.set_dual(1.0);
+    dataStore->back_prop();
+    EXPECT_EQ(sensitivities[liveCut], params.get_dual());
+  }
+
+  EXPECT_EQ(sensitivities[0], sensitivities[1]);
+  EXPECT_LT(storedAfterForward[1], storedAfterForward[0]);
+  EXPECT_LT(storedAfterRefill[1], storedAfterRefill[0]);
+}
+
+TEST_F(MeshFixture, MixedPrecisionCheckpoints)
+{
+  std::array<std::vector<double>, 2> gradients;
+  std::array<gretl::CompressionMetrics, 2> metrics;
+  for (size_t float32Checkpoints : {0, 1}) {
+    dataStore = std::make_shared<gretl::DataStore>(std::make_unique<gretl::WangCheckpointStrategy>(20));
+    auto [params, state0, stateNorm] = build_rk4_graph([float32Checkpoints](State& state) {
+      if (float32Checkpoints) {
+        state.set_checkpoint_codec(gretl::make_float32_codec());
+      }
+    });
+    dataStore->back_prop();
+
+    gradients[float32Checkpoints] = params.get_dual();
+    double constexpr eps = 1e-7;
+    for (const auto& error : gretl::array_gradient_errors(stateNorm, {state0, params}, {eps, eps})) {
+      EXPECT_LT(error.error(), 40 * eps);
+    }
+    metrics[float32Checkpoints] = dataStore->compression_metrics();
+  }
+
+  EXPECT_EQ(0u, metrics[0].compressions);
+  EXPECT_GT(metrics[1].compressions, 0u);
+  EXPECT_GT(metrics[1].decompressions, 0u);
+
+  double difference = 0.0;
+  double norm = 0.0;
+  for (size_t i = 0; i < gradients[0].size(); ++i) {
+    difference += (gradients[0][i] - gradients[1][i]) * (gradients[0][i] - gradients[1][i]);
+    norm += gradients[0][i] * gradients[0][i];
+  }
+  EXPECT_LT(std::sqrt(difference / norm), 1e-6);
+}
+
+TEST_F(MeshFixture, CheckpointedCallTimeSteps)
+{
+  auto run = [&](bool checkpointedCall) {
+    dataStore = std::make_shared<gretl::DataStore>(std::make_unique<gretl::WangCheckpointStrategy>(5));
+    // a logistic rate built from VectorState operations, which all support Hessian-vector products
+    Param params = dataStore->create_state(Param::type{1.3, 0.5, -0.7}, gretl::vec::initialize_zero_dual);
+    State state0 = dataStore->create_state(state0_data, gretl::vec::initialize_zero_dual);
+
+    State state = copy(state0);
+    for (size_t i = 0; i < N; ++i) {
+      double time = static_cast<double>(i) * dt;
+      auto step = [time, this](const State& curState, const Param& p) {
+        return rk4(curState, time, dt, [p](const State& s, double) { return p * s + -1.0 * (s * s); });
+      };
+      state = checkpointedCall ? gretl::checkpointed_call(step, state, params) : step(state, params);
+    }
+    gretl::State<double> stateNorm = set_as_objective(gretl::inner_product(state, state));
+    gretl::Int graphSize = dataStore->size();
+    dataStore->back_prop();
+    std::vector<double> gradient = params.get_dual();
+
+    // the Hessian-vector product in a direction of the parameters, which needs the tangents too
+    dataStore->reset();
+    params.set_tangent(Param::type{1.0, -1.0, 0.5});
+    gretl::hessian_vector_product(stateNorm);
+    std::vector<double> hvp = params.get_dual_tangent();
+    dataStore->clear_tangents();
+    return std::make_tuple(gradient, hvp, graphSize);
+  };
+
+  auto [gradient, hvp, graphSize] = run(false);
+  auto [callGradient, callHvp, callGraphSize] = run(true);
+  EXPECT_LT(10 * callGraphSize, graphSize);
+  for (size_t i = 0; i < gradient.size(); ++i) {
+    EXPECT_NEAR(gradient[i], callGradient[i], 1e-12);
+    EXPECT_NEAR(hvp[i], callHvp[i], 1e-10);
+  }
+}
+
+TEST_F(MeshFixture, FusedTimeIntegrators)
+{
+  auto run = [&](bool fused) {
+    dataStore = std::make_shared<gretl::DataStore>(std::make_unique<gretl::WangCheckpointStrategy>(5));
+    Param params = dataStore->create_state(params_data, gretl::vec::initialize_zero_dual);
+    State state0 = dataStore->create_state(state0_data, gretl::vec::initialize_zero_dual);
+
+    State state = copy(state0);
+    for (size_t i = 0; i < N; ++i) {
+      double time = static_cast<double>(i) * dt;
+      state = fused ? gretl::rk4_step(state, params, time, dt, lorenz_rate, lorenz_rate_vjp)
+                    : rk4(state, time, dt, [params](const State& s, double t) { return state_rate_equation(s, params, t); });
+    }
+    gretl::State<double> stateNorm = set_as_objective(gretl::inner_product(state, state));
+    gretl::Int graphSize = dataStore->size();
+    dataStore->back_prop();
+    return std::make_tuple(state.get(), params.get_dual(), state0.get_dual(), graphSize);
+  };
+
+  auto [state, paramsGradient, state0Gradient, graphSize] = run(false);
+  auto [fusedState, fusedParamsGradient, fusedState0Gradient, fusedGraphSize] = run(true);
+  EXPECT_EQ(N + 4, fusedGraphSize);
+  EXPECT_LT(10 * fusedGraphSize, graphSize);
+  for (size_t i = 0; i < state.size(); ++i) {
+    EXPECT_NEAR(state[i], fusedState[i], 1e-13);
+    EXPECT_NEAR(state0Gradient[i], fusedState0Gradient[i], 1e-12);
+  }
+  for (size_t i = 0; i < paramsGradient.size(); ++i) {
+    EXPECT_NEAR(paramsGradient[i], fusedParamsGradient[i], 1e-12);
+  }
+
+  // heun and implicit Euler steps, against finite differences
+  for (bool implicit : {false, true}) {
+    dataStore = std::make_shared<gretl::DataStore>(std::make_unique<gretl::WangCheckpointStrategy>(5));
+    Param params = dataStore->create_state(params_data, gretl::vec::initialize_zero_dual);
+    State state0 = dataStore->create_state(state0_data, gretl::vec::initialize_zero_dual);
+    State s = state0;
+    // a longer step than the explicit methods need, so the Newton solves take a few iterations
+    double largeDt = 20 * dt;
+    for (size_t i = 0; i < N; ++i) {
+      double time = static_cast<double>(i) * largeDt;
+      s = implicit ? gretl::implicit_euler_step(s, params, time, largeDt, lorenz_rate, lorenz_rate_vjp)
+                   : gretl::heun_step(s, params, time, largeDt, lorenz_rate, lorenz_rate_vjp);
+    }
+    gretl::State<double> stateNorm = set_as_objective(gretl::inner_product(s, s));
+    dataStore->back_prop();
+
+    double constexpr eps = 1e-7;
+    check_array_gradients(stateNorm, {state0, params}, {eps, eps}, {40 * eps, 40 * eps});
+  }
+}
@@ -0,0 +1,223 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/// @file test_gretl_implicit_state.cpp
+/// @brief Gradients through implicitly defined states, checked against finite differences.
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gretl/data_store.hpp"
+#include "gretl/implicit_state.hpp"
+#include "gretl/test_utils.hpp"
+#include "gretl/vector_state.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+
+using gretl::Vector;
+using gretl::VectorState;
+using Matrix = std::vector<Vector>;
+
+namespace {
+
+Vector multiply(const Matrix& A, const Vector& x, bool transpose)
+{
+  Vector y(x.size(), 0.0);
+  for (size_t i = 0; i < A.size(); ++i) {
+    for (size_t j = 0; j < A.size(); ++j) {
+      y[i] += (transpose ? A[j][i] : A[i][j]) * x[j];
+    }
+  }
+  return y;
+}
+
+/// solve A x = b by Gaussian elimination with partial pivoting
+Vector dense_solve(Matrix A, Vector b)
+{
+  const size_t n = b.size();
+  for (size_t k = 0; k < n; ++k) {
+    size_t pivot = k;
+    for (size_t i = k + 1; i < n; ++i) {
+      if (std::abs(A[i][k]) > std::abs(A[pivot][k])) {
+        pivot = i;
+      }
+    }
+    std::swap(A[k], A[pivot]);
+    std::swap(b[k], b[pivot]);
+    for (size_t i = k + 1; i < n; ++i) {
+      double factor = A[i][k] / A[k][k];
+      for (size_t j = k; j < n; ++j) {
+        A[i][j] -= factor * A[k][j];
+      }
+      b[i] -= factor * b[k];
+    }
+  }
+  Vector x(n);
+  for (size_t i = n; i-- > 0;) {
+    double sum = b[i];
+    for (size_t j = i + 1; j < n; ++j) {
+      sum -= A[i][j] * x[j];
+    }
+    x[i] = sum / A[i][i];
+  }
+  return x;
+}
+
+/// F(x, p) = A x + c x^3 - p, componentwise cube
+struct CubicSystem {
+  Matrix A;
+  double c;
+
+  Vector residual(const Vector& x, const Vector& p) const
+  {
+    Vector r = multiply(A, x, false);
+    for (size_t i = 0; i < x.size(); ++i) {
+      r[i] += c * x[i] * x[i] * x[i] - p[i];
+    }
+    return r;
+  }
+
+  Matrix jacobian(const Vector& x) const
+  {
+    Matrix J = A;
+    for (size_t i = 0; i < x.size(); ++i) {
+      J[i][i] += 3.0 * c * x[i] * x[i];
+    }
+    return J;
+  }
+
+  /// Newton iterations, counting them
+  Vector solve(const Vector& p, Vector x, size_t& iterations) const
+  {
+    for (size_t k = 0; k < 50; ++k) {
+      Vector r = residual(x, p);
+      double rNorm = 0.0;
+      for (double v : r) {
+        rNorm += v * v;
+      }
+      if (std::sqrt(rNorm) < 1e-14) {
+        break;
+      }
+      Vector dx = dense_solve(jacobian(x), r);
+      for (size_t i = 0; i < x.size(); ++i) {
+        x[i] -= dx[i];
+      }
+      ++iterations;
+    }
+    return x;
+  }
+};
+
+}  // namespace
+
+TEST(ImplicitState, LinearSystemWithRestarts)
+{
+  const size_t n = 30;
+  Matrix A(n, Vector(n, 0.0));
+  Vector b(n);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      A[i][j] = gretl::rand_in_range(-0.1, 0.1);
+    }
+    A[i][i] += 2.0 + 0.1 * static_cast<double>(i);
+    b[i] = gretl::rand_in_range(-1.0, 1.0);
+  }
+  auto transposeAction = [&](const Vector& v) { return multiply(A, v, true); };
+
+  gretl::ImplicitSolveOptions options;
+  options.restart = 5;
+  Vector y = gretl::solve_linear_system(transposeAction, b, options);
+  Vector ATy = multiply(A, y, true);
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_NEAR(ATy[i], b[i], 1e-11);
+  }
+
+  options.maxIterations = 2;
+  EXPECT_THROW(gretl::solve_linear_system(transposeAction, b, options), std::runtime_error);
+}
+
+TEST(ImplicitState, DenseCubicSystem)
+{
+  CubicSystem system{{{4.0, 1.0, -0.5}, {0.3, 3.0, 1.2}, {-1.0, 0.4, 5.0}}, 0.7};
+  size_t newtonIterations = 0;
+
+  gretl::DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto guess = store.create_state(Vector{0.0, 0.0, 0.0}, gretl::vec::initialize_zero_dual);
+  auto p = store.create_state(Vector{1.5, -2.0, 3.0}, gretl::vec::initialize_zero_dual);
+
+  auto x = gretl::implicit_solve(
+      guess, p,
+      [&](const Vector& P, const Vector& Guess) { return system.solve(P, Guess, newtonIterations); },
+      [&](const Vector& X, const Vector&, const Vector& v) { return multiply(system.jacobian(X), v, true); },
+      [](const Vector&, const Vector&, const Vector& v) {
+        Vector w(v);
+        for (auto& value : w) {
+          value = -value;
+        }
+        return w;
+      });
+  Vector r = system.residual(x.get(), p.get());
+  for (double v : r) {
+    EXPECT_NEAR(v, 0.0, 1e-13);
+  }
+
+  auto objective = gretl::set_as_objective(gretl::inner_product(x, x));
+  store.back_prop();
+
+  // one step for the solve, however many Newton iterations it took
+  EXPECT_GT(newtonIterations, 3u);
+  EXPECT_EQ(4u, store.size());
+  for (double v : guess.get_dual()) {
+    EXPECT_EQ(v, 0.0);
+  }
+
+  double constexpr eps = 1e-7;
+  gretl::check_array_gradients(objective, {p}, {eps}, {20 * eps});
+}
+
+TEST(ImplicitState, ImplicitEulerSteps)
+{
+  // x_{n+1} - x_n - dt * rate(x_{n+1}) = 0 with rate(x) = -x^3 + k x, each step warm started from x_n
+  const double dt = 0.1;
+  const Vector k = {0.5, -0.2};
+  const size_t numSteps = 15;
+
+  auto rate_jacobian = [&](const Vector& X) {
+    Matrix J = {{1.0 - dt * (-3.0 * X[0] * X[0] + k[0]), dt * 0.3}, {0.0, 1.0 - dt * (-3.0 * X[1] * X[1] + k[1])}};
+    return J;
+  };
+  auto residual = [&](const Vector& X, const Vector& Xn) {
+    return Vector{X[0] - Xn[0] - dt * (-X[0] * X[0] * X[0] + k[0] * X[0] - 0.3 * X[1]),
+                  X[1] - Xn[1] - dt * (-X[1] * X[1] * X[1] + k[1] * X[1])};
+  };
+  auto newton = [&](const Vector& Xn, const Vector& Guess) {
+    Vector X = Guess;
+    for (size_t it = 0; it < 30; ++it) {
+      Vector dX = dense_solve(rate_jacobian(X), residual(X, Xn));
+      X[0] -= dX[0];
+      X[1] -= dX[1];
+      if (std::abs(dX[0]) + std::abs(dX[1]) < 1e-15) {
+        break;
+      }
+    }
+    return X;
+  };
+
+  gretl::DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(4));
+  auto x0 = store.create_state(Vector{1.2, -0.8}, gretl::vec::initialize_zero_dual);
+  VectorState x = x0;
+  for (size_t n = 0; n < numSteps; ++n) {
+    x = gretl::implicit_solve(
+        x, x, newton, [&](const Vector& X, const Vector&, const Vector& v) { return multiply(rate_jacobian(X), v, true); },
+        [](const Vector&, const Vector&, const Vector& v) { return Vector{-v[0], -v[1]}; });
+  }
+  auto objective = gretl::set_as_objective(gretl::inner_product(x, x));
+  store.back_prop();
+  EXPECT_EQ(numSteps + 2, store.size());
+
+  double constexpr eps = 1e-7;
+  gretl::check_array_gradients(objective, {x0}, {eps}, {20 * eps});
+}
@@ -0,0 +1,228 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/// @file test_gretl_jvp.cpp
+/// @brief Forward-mode (jacobian-vector product) tangents and forward-over-reverse Hessian-vector products, checked
+/// against reverse-mode gradients.
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "gretl/data_store.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+#include "gretl/strumm_walther_checkpoint_strategy.hpp"
+#include "gretl/state.hpp"
+#include "gretl/double_state.hpp"
+#include "gretl/vector_state.hpp"
+
+using gretl::DataStore;
+using gretl::State;
+using gretl::VectorState;
+
+namespace {
+
+State<double> scalar_chain(const State<double>& x0, const State<double>& p, int N)
+{
+  State<double> x = x0 + 0.0;
+  for (int i = 0; i < N; ++i) {
+    auto xp = x * p;
+    x = gretl::axpby(0.5, xp, 0.25, x);
+    x = 1.0 / (x + 2.0);
+  }
+  return x;
+}
+
+}  // namespace
+
+TEST(ForwardMode, ScalarChainMatchesReverse)
+{
+  int N = 30;
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto x0 = store.create_state<double, double>(0.7);
+  auto p = store.create_state<double, double>(1.3);
+
+  auto xN = scalar_chain(x0, p, N);
+  gretl::set_as_objective(xN);
+  store.back_prop();
+  double dx0 = x0.get_dual();
+  double dp = p.get_dual();
+
+  gretl::forward_tangent(x0, 1.0);
+  EXPECT_NEAR(xN.get_tangent(), dx0, 1e-12);
+
+  store.clear_tangents();
+  gretl::forward_tangent(p, 1.0);
+  EXPECT_NEAR(xN.get_tangent(), dp, 1e-12);
+
+  // seeding both inputs gives the directional derivative
+  store.clear_tangents();
+  x0.set_tangent(2.0);
+  p.set_tangent(-3.0);
+  store.forward_tangent();
+  EXPECT_NEAR(xN.get_tangent(), 2.0 * dx0 - 3.0 * dp, 1e-12);
+}
+
+TEST(ForwardMode, TangentsPropagateDuringConstruction)
+{
+  DataStore store(std::make_unique<gretl::StrummWaltherCheckpointStrategy>(2));
+  auto x0 = store.create_state<double, double>(0.4);
+  auto p = store.create_state<double, double>(0.9);
+  x0.set_tangent(1.0);
+
+  auto xN = scalar_chain(x0, p, 10);
+  double constructionTangent = xN.get_tangent();
+
+  gretl::set_as_objective(xN);
+  store.back_prop();
+  EXPECT_NEAR(constructionTangent, x0.get_dual(), 1e-12);
+}
+
+TEST(ForwardMode, VectorGraphMatchesReverse)
+{
+  std::vector<double> dataA = {1.3, -0.5, 0.25};
+  std::vector<double> dataB = {0.7, 1.1, -2.0};
+  std::vector<double> seedA = {0.3, -1.2, 0.8};
+
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(2));
+  auto a = store.create_state(dataA, gretl::vec::initialize_zero_dual);
+  auto b = store.create_state(dataB, gretl::vec::initialize_zero_dual);
+
+  VectorState x = gretl::copy(a);
+  for (int i = 0; i < 8; ++i) {
+    x = gretl::testing_update(x * b) + 0.5 * a;
+  }
+  auto objective = gretl::inner_product(x, x);
+  gretl::set_as_objective(objective);
+  store.back_prop();
+
+  double directional = 0.0;
+  for (size_t i = 0; i < dataA.size(); ++i) {
+    directional += a.get_dual()[i] * seedA[i];
+  }
+
+  gretl::forward_tangent(a, seedA);
+  EXPECT_NEAR(objective.get_tangent(), directional, 1e-12);
+}
+
+TEST(ForwardMode, StopGradientStatesHaveZeroTangent)
+{
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto x0 = store.create_state<double, double>(1.0);
+  auto p = store.create_state<double, double>(0.5);
+
+  store.set_gradients_enabled(false);
+  auto x = x0 * p;
+  store.set_gradients_enabled(true);
+  auto y = x * p;
+
+  gretl::set_as_objective(y);
+  gretl::forward_tangent(p, 1.0);
+
+  // only the direct dependence of y on p survives: dy/dp = x
+  EXPECT_NEAR(y.get_tangent(), 0.5, 1e-14);
+}
+
+namespace {
+
+/// gradient of the objective with respect to x0 and p, after resetting the inputs to new values
+std::array<double, 2> scalar_gradient_at(DataStore& store, State<double>& x0, State<double>& p, State<double>& xN,
+                                         double x0Value, double pValue)
+{
+  store.reset();
+  x0.set(x0Value);
+  p.set(pValue);
+  store.reset_for_backprop();
+  xN.set_dual(1.0);
+  store.back_prop();
+  return {x0.get_dual(), p.get_dual()};
+}
+
+}  // namespace
+
+TEST(HessianVectorProduct, ScalarChainMatchesFiniteDifferencedGradients)
+{
+  int N = 20;
+  double x0Value = 0.7;
+  double pValue = 1.3;
+  std::array<double, 2> v = {0.6, -0.8};
+
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto x0 = store.create_state<double, double>(x0Value);
+  auto p = store.create_state<double, double>(pValue);
+  auto xN = scalar_chain(x0, p, N);
+  gretl::set_as_objective(xN);
+  store.back_prop();
+
+  double eps = 1e-6;
+  auto gPlus = scalar_gradient_at(store, x0, p, xN, x0Value + eps * v[0], pValue + eps * v[1]);
+  auto gMinus = scalar_gradient_at(store, x0, p, xN, x0Value - eps * v[0], pValue - eps * v[1]);
+  store.checkpointStrategy_->reset_metrics();
+  auto g = scalar_gradient_at(store, x0, p, xN, x0Value, pValue);
+  size_t gradientRecomputations = store.checkpointStrategy_->metrics().recomputations;
+
+  store.reset();
+  store.checkpointStrategy_->reset_metrics();
+  x0.set_tangent(v[0]);
+  p.set_tangent(v[1]);
+  gretl::hessian_vector_product(xN);
+
+  EXPECT_NEAR(x0.get_dual(), g[0], 1e-12);
+  EXPECT_NEAR(p.get_dual(), g[1], 1e-12);
+  EXPECT_NEAR(x0.get_dual_tangent(), (gPlus[0] - gMinus[0]) / (2.0 * eps), 1e-7);
+  EXPECT_NEAR(p.get_dual_tangent(), (gPlus[1] - gMinus[1]) / (2.0 * eps), 1e-7);
+
+  // the tangents ride along the same checkpointed sweep, so the recomputations are those of one gradient
+  EXPECT_GT(gradientRecomputations, 0u);
+  EXPECT_LE(store.checkpointStrategy_->metrics().recomputations, 2 * gradientRecomputations);
+}
+
+TEST(HessianVectorProduct, VectorGraphUnderTightBudget)
+{
+  std::vector<double> dataA = {1.3, -0.5, 0.25};
+  std::vector<double> dataB = {0.7, 1.1, -2.0};
+  std::vector<double> seedA = {0.3, -1.2, 0.8};
+  std::vector<double> seedB = {-0.4, 0.1, 0.5};
+
+  auto gradients_at = [&](double eps) {
+    DataStore store(std::make_unique<gretl::StrummWaltherCheckpointStrategy>(2));
+    std::vector<double> a0 = dataA;
+    std::vector<double> b0 = dataB;
+    for (size_t i = 0; i < a0.size(); ++i) {
+      a0[i] += eps * seedA[i];
+      b0[i] += eps * seedB[i];
+    }
+    auto a = store.create_state(a0, gretl::vec::initialize_zero_dual);
+    auto b = store.create_state(b0, gretl::vec::initialize_zero_dual);
+    VectorState x = gretl::copy(a);
+    for (int i = 0; i < 6; ++i) {
+      x = gretl::testing_update(x * b) + 0.5 * a;
+    }
+    auto objective = gretl::inner_product(x, x);
+    if (eps == 0.0) {
+      a.set_tangent(seedA);
+      b.set_tangent(seedB);
+      gretl::hessian_vector_product(objective);
+      return std::array<std::vector<double>, 4>{a.get_dual(), b.get_dual(), a.get_dual_tangent(),
+                                                b.get_dual_tangent()};
+    }
+    gretl::set_as_objective(objective);
+    store.back_prop();
+    return std::array<std::vector<double>, 4>{a.get_dual(), b.get_dual(), {}, {}};
+  };
+
+  double eps = 1e-6;
+  auto plus = gradients_at(eps);
+  auto minus = gradients_at(-eps);
+  auto hvp = gradients_at(0.0);
+
+  for (size_t i = 0; i < dataA.size(); ++i) {
+    double fdA = (plus[0][i] - minus[0][i]) / (2.0 * eps);
+    double fdB = (plus[1][i] - minus[1][i]) / (2.0 * eps);
+    EXPECT_NEAR(hvp[2][i], fdA, 1e-5 * std::max(1.0, std::abs(fdA)));
+    EXPECT_NEAR(hvp[3][i], fdB, 1e-5 * std::max(1.0, std::abs(fdB)));
+  }
+}
@@ -0,0 +1,121 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/// @file test_gretl_memory_estimate.cpp
+/// @brief Memory estimates of finalized graphs are checked against the memory a repeated sweep actually holds.
+
+#include <algorithm>
+#include <any>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gretl/data_store.hpp"
+#include "gretl/double_state.hpp"
+#include "gretl/memory_estimate.hpp"
+#include "gretl/strumm_walther_checkpoint_strategy.hpp"
+#include "gretl/vector_state.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+
+using gretl::State;
+using gretl::Vector;
+using gretl::VectorState;
+
+namespace {
+
+std::unique_ptr<gretl::CheckpointStrategy> make_strategy(bool strummWalther, size_t budget)
+{
+  if (strummWalther) {
+    return std::make_unique<gretl::StrummWaltherCheckpointStrategy>(budget);
+  }
+  return std::make_unique<gretl::WangCheckpointStrategy>(budget);
+}
+
+/// a DAG whose states change size, with some upstreams used several steps later
+State<double> build_graph(const VectorState& x0, const VectorState& y0, size_t numSteps)
+{
+  std::vector<VectorState> xs = {x0};
+  VectorState y = y0;
+  for (size_t n = 0; n < numSteps; ++n) {
+    VectorState x = gretl::testing_update(xs.back());
+    if (xs.size() == 4) {
+      x = x + 0.5 * xs.front();
+    }
+    if (n % 4 == 0) {
+      y = y * gretl::copy(y);
+    }
+    xs.push_back(x);
+    if (xs.size() > 4) {
+      xs.erase(xs.begin());
+    }
+  }
+  return gretl::inner_product(xs.back(), xs.back()) + gretl::inner_product(y, y);
+}
+
+/// bytes of the non-persistent primals and of all duals currently held
+size_t live_bytes(const gretl::DataStore& store)
+{
+  size_t bytes = 0;
+  for (gretl::Int step = 0; step < store.states_.size(); ++step) {
+    if (!store.is_persistent(step)) {
+      bytes += store.primal_bytes(step);
+    }
+    if (const auto& dual = store.duals_[step]) {
+      auto vector = std::any_cast<Vector>(dual.get());
+      bytes += vector ? vector->size() * sizeof(double) : sizeof(double);
+    }
+  }
+  return bytes;
+}
+
+}  // namespace
+
+class MemoryEstimate : public ::testing::TestWithParam<bool> {};
+
+TEST_P(MemoryEstimate, MatchesRepeatedSweep)
+{
+  for (size_t budget : {2, 5, 40}) {
+    gretl::DataStore store(make_strategy(GetParam(), budget));
+    auto x0 = store.create_state(Vector{0.3, -0.2, 0.7}, gretl::vec::initialize_zero_dual);
+    auto y0 = store.create_state(Vector(12, 0.9), gretl::vec::initialize_zero_dual);
+    // no handle to the objective is kept, it would keep its dual after back propagating through it
+    gretl::set_as_objective(build_graph(x0, y0, 30));
+    store.back_prop();
+
+    auto strategy = make_strategy(GetParam(), budget);
+    auto estimate = gretl::estimate_sweep_memory(store, *strategy);
+    EXPECT_EQ(estimate.persistentBytes, 15 * sizeof(double));
+    ASSERT_EQ(estimate.reverseLiveBytes.size(), store.size());
+
+    store.reset();
+    store.checkpointStrategy_->reset_metrics();
+    store.reset_for_backprop();
+    store.set_dual(store.size() - 1, 1.0);
+    for (size_t n = 0; n < store.size(); ++n) {
+      store.reverse_state();
+      EXPECT_EQ(live_bytes(store), estimate.reverseLiveBytes[n]) << "budget " << budget << " reverse step " << n;
+    }
+    EXPECT_EQ(store.checkpointStrategy_->metrics().recomputations, estimate.recomputations) << "budget " << budget;
+
+    const auto& liveBytes = estimate.reverseLiveBytes;
+    EXPECT_GE(estimate.peakBytes, *std::max_element(liveBytes.begin(), liveBytes.end()));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Strategies, MemoryEstimate, ::testing::Values(false, true));
+
+TEST(MemoryEstimateChecks, RequiresFinalizedGraphAndFreshStrategy)
+{
+  gretl::DataStore store(3);
+  auto x0 = store.create_state(Vector{1.0, 2.0}, gretl::vec::initialize_zero_dual);
+  auto x = gretl::testing_update(x0);
+  gretl::WangCheckpointStrategy strategy(3);
+  EXPECT_THROW(gretl::estimate_sweep_memory(store, strategy), std::runtime_error);
+
+  store.finalize_graph();
+  strategy.add_checkpoint_and_get_index_to_remove(0, true);
+  EXPECT_THROW(gretl::estimate_sweep_memory(store, strategy), std::runtime_error);
+}
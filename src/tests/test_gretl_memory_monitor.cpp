@@ -0,0 +1,210 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include "gtest/gtest.h"
+#include "gretl/checkpoint_strategy_registry.hpp"
+#include "gretl/data_store.hpp"
+#include "gretl/memory_monitor.hpp"
+#include "gretl/state.hpp"
+#include "gretl/vector_state.hpp"
+
+namespace {
+
+constexpr size_t vectorSize = 1000;
+constexpr size_t vectorBytes = vectorSize * sizeof(double);
+
+gretl::Vector initial_field()
+{
+  gretl::Vector v(vectorSize);
+  for (size_t i = 0; i < vectorSize; ++i) {
+    v[i] = 0.5 + 0.001 * static_cast<double>(i);
+  }
+  return v;
+}
+
+gretl::VectorState advance(const gretl::VectorState& x) { return x + 0.01 * (x * x); }
+
+struct Sweep {
+  gretl::Vector gradient;
+  size_t recomputations;
+};
+
+/// write a file of a fake cgroup tree, creating its directories
+void write_file(const std::filesystem::path& path, const std::string& contents)
+{
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path) << contents << "\n";
+}
+
+/// gradient of |x_N|^2 with respect to x_0, with a fixed checkpoint budget
+Sweep reference_run(const std::string& strategy, size_t budget, size_t numSteps)
+{
+  gretl::DataStore dataStore(gretl::make_checkpoint_strategy(strategy, budget));
+  auto x0 = dataStore.create_state(initial_field(), gretl::vec::initialize_zero_dual);
+  auto x = x0;
+  for (size_t n = 0; n < numSteps; ++n) {
+    x = advance(x);
+  }
+  gretl::set_as_objective(gretl::inner_product(x, x));
+  dataStore.back_prop();
+  return Sweep{x0.get_dual(), dataStore.checkpointStrategy_->metrics().recomputations};
+}
+
+}  // namespace
+
+TEST(MemoryMonitor, RecommendsFromReading)
+{
+  gretl::MemoryReading reading{1000, 0};
+  gretl::MemoryMonitor::Options options;
+  options.targetFraction = 0.5;
+  options.minCapacity = 2;
+  gretl::MemoryMonitor monitor(options, [&]() { return reading; });
+
+  // 500 bytes below the target fit 5 more checkpoints of 100 bytes
+  EXPECT_EQ(8u, monitor.recommend_capacity(3, 100, 50));
+  EXPECT_EQ(1000u, monitor.last_reading().limit);
+  EXPECT_EQ(50u, monitor.recommend_capacity(48, 100, 50));
+
+  // 200 bytes above the target, 2 checkpoints too many
+  reading.used = 700;
+  EXPECT_EQ(4u, monitor.recommend_capacity(6, 100, 50));
+  EXPECT_EQ(2u, monitor.recommend_capacity(3, 100, 50));
+
+  // an unknown limit leaves the largest capacity
+  reading = gretl::MemoryReading{};
+  EXPECT_EQ(50u, monitor.recommend_capacity(6, 100, 50));
+
+  options.maxCapacity = 10;
+  EXPECT_EQ(10u, gretl::MemoryMonitor(options, [&]() { return reading; }).recommend_capacity(6, 100, 50));
+}
+
+TEST(MemoryMonitor, ReadsProcessMemory)
+{
+  auto reading = gretl::read_process_memory();
+#ifdef __linux__
+  EXPECT_GT(reading.limit, 0u);
+  EXPECT_GT(reading.used, 0u);
+  EXPECT_LE(reading.used, reading.limit);
+#endif
+}
+
+TEST(MemoryMonitor, ReadsNearestLimitedCgroup)
+{
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() / "gretl_test_cgroup";
+  fs::remove_all(root);
+  fs::path procCgroup = root / "proc_self_cgroup";
+
+  // v2: the job is limited, the step it runs in is not
+  write_file(root / "sys/job_7/memory.max", "4000");
+  write_file(root / "sys/job_7/memory.current", "1500");
+  write_file(root / "sys/job_7/step_0/memory.max", "max");
+  write_file(root / "sys/job_7/step_0/memory.current", "1200");
+  write_file(procCgroup, "0::/job_7/step_0");
+  auto reading = gretl::read_cgroup_memory(procCgroup.string(), (root / "sys").string());
+  EXPECT_EQ(4000u, reading.limit);
+  EXPECT_EQ(1500u, reading.used);
+
+  // v1: the memory controller line names the cgroup, the v2 entry has no limit
+  write_file(root / "sys/memory/job_8/memory.limit_in_bytes", "3000");
+  write_file(root / "sys/memory/job_8/memory.usage_in_bytes", "700");
+  write_file(root / "sys/memory/job_8/task/memory.limit_in_bytes", "9223372036854771712");
+  write_file(root / "sys/memory/memory.limit_in_bytes", "9223372036854771712");
+  write_file(procCgroup, "4:cpu,memory:/job_8/task/\n0::/");
+  reading = gretl::read_cgroup_memory(procCgroup.string(), (root / "sys").string());
+  EXPECT_EQ(3000u, reading.limit);
+  EXPECT_EQ(700u, reading.used);
+
+  // no limit up to the root of the hierarchy
+  write_file(procCgroup, "4:memory:/other\n0::/other");
+  EXPECT_EQ(0u, gretl::read_cgroup_memory(procCgroup.string(), (root / "sys").string()).limit);
+  fs::remove_all(root);
+}
+
+TEST(MemoryMonitor, SetCheckpointCapacity)
+{
+  constexpr size_t numSteps = 60;
+  constexpr size_t budget = 12;
+  constexpr size_t smallBudget = 3;
+
+  for (std::string strategy : {"wang", "strumm_walther", "adaptive", "replay:wang"}) {
+    SCOPED_TRACE(strategy);
+    Sweep reference = reference_run(strategy, budget, numSteps);
+
+    gretl::DataStore dataStore(gretl::make_checkpoint_strategy(strategy, budget));
+    EXPECT_EQ(budget, dataStore.checkpoint_capacity());
+    auto x0 = dataStore.create_state(initial_field(), gretl::vec::initialize_zero_dual);
+    auto x = x0;
+    for (size_t n = 0; n < numSteps; ++n) {
+      x = advance(x);
+    }
+    EXPECT_EQ(budget + 1, dataStore.checkpointStrategy_->size());
+
+    // shrinking evicts right away, growing back only raises the limit
+    dataStore.set_checkpoint_capacity(smallBudget);
+    EXPECT_EQ(smallBudget, dataStore.checkpoint_capacity());
+    EXPECT_EQ(smallBudget + 1, dataStore.checkpointStrategy_->size());
+    EXPECT_TRUE(dataStore.check_validity());
+    dataStore.set_checkpoint_capacity(budget);
+    EXPECT_EQ(budget, dataStore.checkpoint_capacity());
+    EXPECT_EQ(smallBudget + 1, dataStore.checkpointStrategy_->size());
+    dataStore.set_checkpoint_capacity(smallBudget);
+
+    gretl::set_as_objective(gretl::inner_product(x, x));
+    dataStore.back_prop();
+    EXPECT_EQ(reference.gradient, x0.get_dual());
+    EXPECT_GT(dataStore.checkpointStrategy_->metrics().recomputations, reference.recomputations);
+  }
+}
+
+TEST(MemoryMonitor, DegradesUnderMemoryPressure)
+{
+  constexpr size_t numSteps = 50;
+  constexpr size_t budget = 20;
+  Sweep reference = reference_run("wang", budget, numSteps);
+
+  gretl::DataStore dataStore(gretl::make_checkpoint_strategy("wang", budget));
+
+  // a process whose memory is some baseline plus the checkpoints held: 100 checkpoints fit below the target
+  constexpr size_t limit = 125 * vectorBytes;
+  size_t baseline = 0;
+  auto source = [&]() {
+    return gretl::MemoryReading{limit, baseline + dataStore.checkpointStrategy_->size() * vectorBytes};
+  };
+  gretl::MemoryMonitor::Options options;
+  options.interval = 4;
+  dataStore.set_memory_monitor(std::make_shared<gretl::MemoryMonitor>(options, source));
+
+  auto x0 = dataStore.create_state(initial_field(), gretl::vec::initialize_zero_dual);
+  auto x = x0;
+  for (size_t n = 0; n < numSteps / 2; ++n) {
+    x = advance(x);
+  }
+  // plenty of memory, the capacity stays where it was when the monitor was set
+  EXPECT_EQ(budget, dataStore.checkpoint_capacity());
+
+  // something else takes all but 6 checkpoints' worth of memory, one of which is held by the persistent x0
+  baseline = 94 * vectorBytes;
+  for (size_t n = numSteps / 2; n < numSteps; ++n) {
+    x = advance(x);
+  }
+  EXPECT_EQ(5u, dataStore.checkpoint_capacity());
+  EXPECT_LE(dataStore.checkpointStrategy_->size(), 6u);
+
+  // the memory is released again during back propagation, and the capacity recovers
+  baseline = 0;
+  gretl::set_as_objective(gretl::inner_product(x, x));
+  dataStore.back_prop();
+  EXPECT_EQ(budget, dataStore.checkpoint_capacity());
+
+  EXPECT_EQ(reference.gradient, x0.get_dual());
+  size_t recomputations = dataStore.checkpointStrategy_->metrics().recomputations;
+  EXPECT_GT(recomputations, reference.recomputations);
+}
@@ -10,6 +10,8 @@
 //
 
 #include <vector>
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <chrono>
 #include <functional>
@@ -18,10 +20,13 @@
 #include "gtest/gtest.h"
 #include "gretl/data_store.hpp"
 #include "gretl/wang_checkpoint_strategy.hpp"
+#include "gretl/strumm_walther_checkpoint_strategy.hpp"
+#include "gretl/replay_checkpoint_strategy.hpp"
 #include "gretl/state.hpp"
 #include "gretl/double_state.hpp"
 #include "gretl/vector_state.hpp"
 #include "gretl/test_utils.hpp"
+#include "gretl/weak_state.hpp"
 
 using gretl::DataStore;
 using gretl::State;
@@ -89,6 +94,21 @@ static State<double> build_chain_holding_intermediates(const State<double>& x0,
   return x;
 }
 
+// Build a chain of N nonlinear steps x = x + 0.01 * x * x, whose vjps read
+// their primals, calling onStep on the state of every step.
+static VectorState build_quadratic_chain(const VectorState& x0, int N,
+                                         const std::function<void(const VectorState&)>& onStep = nullptr)
+{
+  VectorState x = x0;
+  for (int i = 0; i < N; ++i) {
+    x = x + 0.01 * (x * x);
+    if (onStep) {
+      onStep(x);
+    }
+  }
+  return x;
+}
+
 // ---------------------------------------------------------------------------
 // TEST SUITE: ScopeLifetime
 // States created in sub-functions going out of scope during graph construction
@@ -250,6 +270,183 @@ TEST(ExternalReferences, CopyStateAcrossScopes)
   EXPECT_NEAR(x0.get_dual(), 6.0, 1e-14);
 }
 
+TEST(ExternalReferences, WeakStatesDoNotPin)
+{
+  // Log every intermediate, strongly or weakly.  Strong handles keep every primal in memory, weak ones leave the
+  // checkpoint strategy in charge.
+  constexpr size_t size = 100;
+  constexpr int N = 40;
+  std::array<gretl::Vector, 2> gradients;
+  std::array<size_t, 2> heldBytes{};
+  for (size_t weak : {0, 1}) {
+    DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(4));
+    auto x0 = store.create_state(gretl::Vector(size, 0.5), gretl::vec::initialize_zero_dual);
+    std::vector<VectorState> strongLog;
+    std::vector<gretl::WeakState<gretl::Vector>> weakLog;
+    std::vector<double> firstValues;
+    auto x = build_quadratic_chain(x0, N, [&](const VectorState& state) {
+      firstValues.push_back(state.get()[0]);
+      if (weak) {
+        weakLog.push_back(state);
+      } else {
+        strongLog.push_back(state);
+      }
+    });
+    for (gretl::Int step = 0; step < store.size(); ++step) {
+      heldBytes[weak] += store.primal_bytes(step);
+    }
+
+    if (weak) {
+      EXPECT_FALSE(weakLog.front().in_memory());
+      EXPECT_THROW(weakLog.front().get(), std::runtime_error);
+      EXPECT_TRUE(weakLog.back().in_memory());
+    }
+    auto objective = gretl::set_as_objective(gretl::inner_product(x, x));
+
+    // once the graph is finalized, freed primals are recomputed on access
+    for (int i = 0; i < N; ++i) {
+      double value = weak ? weakLog[static_cast<size_t>(i)].get()[0] : strongLog[static_cast<size_t>(i)].get()[0];
+      EXPECT_EQ(firstValues[static_cast<size_t>(i)], value);
+    }
+    store.reset();
+    store.reset_for_backprop();
+    objective.set_dual(1.0);
+    store.back_prop();
+    gradients[weak] = x0.get_dual();
+
+    if (weak) {
+      EXPECT_EQ(weakLog.front().step() + 3, weakLog[1].step());
+      EXPECT_FALSE(weakLog.front().expired());
+      store.reset_graph();
+      EXPECT_TRUE(weakLog.front().expired());
+      EXPECT_THROW(weakLog.front().get(), std::runtime_error);
+    }
+  }
+
+  EXPECT_EQ(gradients[0], gradients[1]);
+  EXPECT_LT(heldBytes[1] * 3, heldBytes[0]);
+}
+
+TEST(ExternalReferences, PinnedStepsReport)
+{
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto x0 = store.create_state(gretl::Vector(100, 0.5), gretl::vec::initialize_zero_dual);
+  auto s0 = store.create_state<double, double>(2.0);
+  std::vector<VectorState> held;
+  auto x = x0;
+  auto s = s0;
+  for (int i = 0; i < 12; ++i) {
+    x = 0.5 * x;
+    s = gretl::axpb(0.5, s, 1.0);
+    if (i % 4 == 0) {
+      held.push_back(x);
+    }
+  }
+
+  // the held steps which are no longer checkpointed are reported, with the size of their vectors
+  auto report = store.pinned_steps();
+  size_t reported = 0;
+  for (const auto& h : held) {
+    auto entry = std::find_if(report.begin(), report.end(),
+                              [&](const gretl::PinnedStep& p) { return p.step == h.step(); });
+    if (store.active_[h.step()]) {
+      EXPECT_EQ(report.end(), entry);
+      continue;
+    }
+    ASSERT_NE(report.end(), entry);
+    ++reported;
+    EXPECT_EQ(1u, entry->externalHandles);
+    EXPECT_EQ(100 * sizeof(double), entry->bytes);
+    EXPECT_NE(std::string::npos, entry->type.find("State<std::vector<double"));
+  }
+  EXPECT_GT(reported, 0u);
+  for (size_t i = 1; i < report.size(); ++i) {
+    EXPECT_GE(report[i - 1].bytes, report[i].bytes);
+  }
+  for (const auto& entry : report) {
+    EXPECT_FALSE(store.active_[entry.step]);
+    EXPECT_TRUE(entry.externalHandles > 0 || entry.uses > 0);
+  }
+
+  // once dropped, only the steps still used by checkpoints remain
+  held.clear();
+  for (const auto& entry : store.pinned_steps()) {
+    EXPECT_EQ(0u, entry.externalHandles);
+    EXPECT_GT(entry.uses, 0u);
+  }
+
+  gretl::set_as_objective(gretl::inner_product(x, x) + s);
+  store.back_prop();
+  EXPECT_NEAR(std::pow(0.5, 12), s0.get_dual(), 1e-14);
+}
+
+// ---------------------------------------------------------------------------
+// TEST SUITE: LivenessAwareEviction
+// The DataStore tells the strategy which evictions actually release memory.
+// ---------------------------------------------------------------------------
+
+TEST(LivenessAwareEviction, FreeableBytesSeesPins)
+{
+  constexpr size_t size = 100;
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(100));
+  auto x0 = store.create_state(gretl::Vector(size, 1.0), gretl::vec::initialize_zero_dual);
+  auto x = x0;
+  std::vector<gretl::Int> steps;
+  for (int i = 0; i < 4; ++i) {
+    x = 0.5 * x;
+    steps.push_back(x.step());
+  }
+
+  // persistent states are never evicted
+  EXPECT_EQ(0u, store.freeable_bytes(x0.step()));
+  // every step is stored, so each one is still needed by the stored step after it
+  EXPECT_EQ(0u, store.freeable_bytes(steps[1]));
+  // the last step is referenced by a handle
+  EXPECT_EQ(0u, store.freeable_bytes(steps[3]));
+  x = x0;
+  EXPECT_EQ(size * sizeof(double), store.freeable_bytes(steps[3]));
+}
+
+TEST(LivenessAwareEviction, PrefersEvictionsReleasingMemory)
+{
+  // each step reads x twice, in x * x and in the final sum, so x is pinned by a passthrough over the step in between
+  constexpr size_t size = 1000;
+  constexpr int N = 100;
+  constexpr size_t budget = 10;
+
+  auto run = [&](std::unique_ptr<gretl::CheckpointStrategy> strategy, bool livenessAware, size_t& heldBytes) {
+    DataStore store(std::move(strategy));
+    store.set_liveness_aware_eviction(livenessAware);
+    auto x0 = store.create_state(gretl::Vector(size, 0.5), gretl::vec::initialize_zero_dual);
+    auto x = build_quadratic_chain(x0, N);
+    heldBytes = 0;
+    for (gretl::Int step = 0; step < store.size(); ++step) {
+      heldBytes += store.primal_bytes(step);
+    }
+    gretl::set_as_objective(gretl::inner_product(x, x));
+    store.back_prop();
+    return x0.get_dual();
+  };
+
+  size_t heldBytes;
+  size_t heldBytesLivenessAware;
+  auto expected = run(std::make_unique<gretl::WangCheckpointStrategy>(budget), false, heldBytes);
+  EXPECT_EQ(expected, run(std::make_unique<gretl::WangCheckpointStrategy>(budget), true, heldBytesLivenessAware));
+  EXPECT_LE(heldBytesLivenessAware, heldBytes);
+
+  EXPECT_EQ(expected, run(std::make_unique<gretl::StrummWaltherCheckpointStrategy>(budget), false, heldBytes));
+  EXPECT_EQ(expected,
+            run(std::make_unique<gretl::StrummWaltherCheckpointStrategy>(budget), true, heldBytesLivenessAware));
+  EXPECT_LT(heldBytesLivenessAware, heldBytes);
+
+  // a replay strategy hands the oracle to the strategy it wraps
+  size_t heldBytesReplay;
+  EXPECT_EQ(expected, run(std::make_unique<gretl::ReplayCheckpointStrategy>(
+                              std::make_unique<gretl::StrummWaltherCheckpointStrategy>(budget)),
+                          true, heldBytesReplay));
+  EXPECT_EQ(heldBytesLivenessAware, heldBytesReplay);
+}
+
 // ---------------------------------------------------------------------------
 // TEST SUITE: AssignmentOperator
 // Tests for the StateBase assignment operator and its try_to_free calls
@@ -1221,6 +1418,40 @@ TEST(PerformanceScaling, ConstructionTimeScaling)
   std::cout << "---\n";
 }
 
+TEST(PerformanceScaling, ValidationOverheadPerStep)
+{
+  // Per-step cost of construction + backprop at the compiled GRETL_VALIDATION level, against the cost of also running
+  // the O(N) check_validity after every constructed step, which is what GRETL_VALIDATION=full does.
+  std::cout << "\n--- Per-step cost, GRETL_VALIDATION=" << GRETL_VALIDATION << " vs full graph checks ---\n";
+
+  for (int N : {500, 2000}) {
+    double perStepUs[2];
+    for (bool fullChecks : {false, true}) {
+      DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(10));
+      auto x0 = store.create_state<double, double>(1.0);
+
+      auto start = std::chrono::steady_clock::now();
+      auto x = x0;
+      bool valid = true;
+      for (int i = 0; i < N; ++i) {
+        x = gretl::axpb(0.99, x, 0.01);
+        if (fullChecks) {
+          valid = valid && store.check_validity();
+        }
+      }
+      gretl::set_as_objective(x);
+      store.back_prop();
+      perStepUs[fullChecks] = 1e3 * elapsed_ms(start) / N;
+
+      EXPECT_TRUE(valid);
+      EXPECT_NEAR(x0.get_dual(), std::pow(0.99, N), std::pow(0.99, N) * 1e-4);
+    }
+    std::cout << "  N=" << N << " per step: " << perStepUs[0] << "us, with full checks: " << perStepUs[1]
+              << "us (" << perStepUs[1] / perStepUs[0] << "x)\n";
+  }
+  std::cout << "---\n";
+}
+
 TEST(PerformanceScaling, BackpropTimeVsBudget)
 {
   // Fixed graph size, vary budget. Measures the tradeoff between
@@ -0,0 +1,224 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/// @file test_gretl_scalar_tape.cpp
+/// @brief Scalar tapes checked against the same computations built from State<double> operations, one step each.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gretl/data_store.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+#include "gretl/double_state.hpp"
+#include "gretl/vector_state.hpp"
+#include "gretl/scalar_tape.hpp"
+
+using gretl::DataStore;
+using gretl::Scalar;
+using gretl::ScalarTape;
+using gretl::State;
+
+namespace {
+
+/// the same code for State<double> and Scalar
+template <typename S>
+S nonlinear_chain(const S& x0, const S& p, int N)
+{
+  S x = x0 + 0.0;
+  for (int i = 0; i < N; ++i) {
+    S xp = x * p;
+    x = axpby(0.5, xp, 0.25, x);
+    x = 1.0 / (x + 2.0);
+  }
+  return x;
+}
+
+/// the chain of LargeGraphStress, split into tapes of tapeLength operations
+State<double> taped_linear_chain(const State<double>& x0, int N, int tapeLength)
+{
+  State<double> x = x0;
+  for (int i = 0; i < N; i += tapeLength) {
+    ScalarTape tape;
+    Scalar s = tape.input(x);
+    for (int j = i; j < std::min(N, i + tapeLength); ++j) {
+      s = axpb(0.99, s, 0.01);
+    }
+    x = tape.finalize(s);
+  }
+  return x;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+TEST(ScalarTape, LinearChainGradient)
+{
+  int N = 200;
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto x0 = store.create_state<double, double>(1.0);
+  auto x = taped_linear_chain(x0, N, 16);
+  EXPECT_NEAR(x.get(), 1.0, 1e-12);
+
+  gretl::set_as_objective(x);
+  store.back_prop();
+  EXPECT_NEAR(x0.get_dual(), std::pow(0.99, N), 1e-12);
+}
+
+TEST(ScalarTape, MatchesStateOperations)
+{
+  int N = 30;
+  std::array<double, 2> v = {0.6, -0.8};
+
+  DataStore graphStore(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto gx0 = graphStore.create_state<double, double>(0.7);
+  auto gp = graphStore.create_state<double, double>(1.3);
+  auto gxN = nonlinear_chain(gx0, gp, N);
+
+  DataStore tapeStore(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto tx0 = tapeStore.create_state<double, double>(0.7);
+  auto tp = tapeStore.create_state<double, double>(1.3);
+  ScalarTape tape;
+  auto txN = tape.finalize(nonlinear_chain(tape.input(tx0), tape.input(tp), N));
+  EXPECT_EQ(2u + 4u * static_cast<size_t>(N) + 1u, tape.size());
+  EXPECT_NEAR(gxN.get(), txN.get(), 1e-14);
+
+  gretl::set_as_objective(gxN);
+  graphStore.back_prop();
+  gretl::set_as_objective(txN);
+  tapeStore.back_prop();
+  EXPECT_NEAR(gx0.get_dual(), tx0.get_dual(), 1e-13);
+  EXPECT_NEAR(gp.get_dual(), tp.get_dual(), 1e-13);
+  double dp = tp.get_dual();
+
+  gretl::forward_tangent(gp, 1.0);
+  gretl::forward_tangent(tp, 1.0);
+  EXPECT_NEAR(gxN.get_tangent(), txN.get_tangent(), 1e-13);
+  EXPECT_NEAR(txN.get_tangent(), dp, 1e-13);
+
+  for (auto* store : {&graphStore, &tapeStore}) {
+    store->reset();
+    store->clear_tangents();
+  }
+  gx0.set_tangent(v[0]);
+  gp.set_tangent(v[1]);
+  gretl::hessian_vector_product(gxN);
+  tx0.set_tangent(v[0]);
+  tp.set_tangent(v[1]);
+  gretl::hessian_vector_product(txN);
+  EXPECT_NEAR(gx0.get_dual_tangent(), tx0.get_dual_tangent(), 1e-12);
+  EXPECT_NEAR(gp.get_dual_tangent(), tp.get_dual_tangent(), 1e-12);
+}
+
+TEST(ScalarTape, RecomputedAfterEviction)
+{
+  // every tape is a step of a chain longer than the budget, so the tapes are replayed during back propagation
+  int N = 20;
+  int numTapes = 12;
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(2));
+  auto x0 = store.create_state<double, double>(0.7);
+  auto p = store.create_state<double, double>(1.3);
+  State<double> x = x0;
+  for (int t = 0; t < numTapes; ++t) {
+    ScalarTape tape;
+    x = tape.finalize(nonlinear_chain(tape.input(x), tape.input(p), N));
+  }
+  gretl::set_as_objective(x);
+  store.back_prop();
+  EXPECT_GT(store.checkpointStrategy_->metrics().recomputations, 0u);
+
+  DataStore graphStore(std::make_unique<gretl::WangCheckpointStrategy>(100));
+  auto gx0 = graphStore.create_state<double, double>(0.7);
+  auto gp = graphStore.create_state<double, double>(1.3);
+  State<double> gx = gx0;
+  for (int t = 0; t < numTapes; ++t) {
+    gx = nonlinear_chain(gx, gp, N);
+  }
+  gretl::set_as_objective(gx);
+  graphStore.back_prop();
+  EXPECT_NEAR(gx0.get_dual(), x0.get_dual(), 1e-12);
+  EXPECT_NEAR(gp.get_dual(), p.get_dual(), 1e-12);
+}
+
+TEST(ScalarTape, VectorStateInputsAndOutputs)
+{
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto a = store.create_state(std::vector<double>{1.3, 3.5, -0.4}, gretl::vec::initialize_zero_dual);
+  auto s = store.create_state<double, double>(0.5);
+
+  ScalarTape tape;
+  auto x = tape.input(a);
+  auto c = tape.input(s);
+  std::vector<Scalar> y = {x[0] * x[1], c * x[2] + x[0], 2.0 / x[1]};
+  auto b = tape.finalize(y);
+  ASSERT_EQ(3u, b.get().size());
+  EXPECT_DOUBLE_EQ(1.3 * 3.5, b.get()[0]);
+  EXPECT_DOUBLE_EQ(0.5 * -0.4 + 1.3, b.get()[1]);
+  EXPECT_DOUBLE_EQ(2.0 / 3.5, b.get()[2]);
+
+  gretl::set_as_objective(gretl::inner_product(b, b));
+  store.back_prop();
+
+  // d/da of |b|^2 = 2 b . db/da
+  const auto& B = b.get();
+  const auto& A = a.get_dual();
+  EXPECT_NEAR(A[0], 2.0 * (B[0] * 3.5 + B[1]), 1e-12);
+  EXPECT_NEAR(A[1], 2.0 * (B[0] * 1.3 - B[2] * 2.0 / (3.5 * 3.5)), 1e-12);
+  EXPECT_NEAR(A[2], 2.0 * B[1] * 0.5, 1e-12);
+  EXPECT_NEAR(s.get_dual(), 2.0 * B[1] * -0.4, 1e-12);
+}
+
+TEST(ScalarTape, RejectsMisuse)
+{
+  DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(3));
+  auto x0 = store.create_state<double, double>(1.0);
+  ScalarTape tape;
+  ScalarTape other;
+  Scalar x = tape.input(x0);
+  Scalar y = other.input(x0);
+  EXPECT_THROW(x + y, std::runtime_error);
+  auto z = tape.finalize(x * x);
+  EXPECT_THROW(tape.finalize(x), std::runtime_error);
+  EXPECT_THROW(x + 1.0, std::runtime_error);
+  EXPECT_DOUBLE_EQ(1.0, z.get());
+}
+
+TEST(ScalarTape, Throughput)
+{
+  int N = 100000;
+
+  auto start = std::chrono::steady_clock::now();
+  DataStore graphStore(std::make_unique<gretl::WangCheckpointStrategy>(20));
+  auto gx0 = graphStore.create_state<double, double>(1.0);
+  State<double> gx = gx0;
+  for (int i = 0; i < N; ++i) {
+    gx = gretl::axpb(0.99, gx, 0.01);
+  }
+  gretl::set_as_objective(gx);
+  graphStore.back_prop();
+  double graphSeconds = seconds_since(start);
+
+  start = std::chrono::steady_clock::now();
+  DataStore tapeStore(std::make_unique<gretl::WangCheckpointStrategy>(20));
+  auto tx0 = tapeStore.create_state<double, double>(1.0);
+  auto tx = taped_linear_chain(tx0, N, 1000);
+  gretl::set_as_objective(tx);
+  tapeStore.back_prop();
+  double tapeSeconds = seconds_since(start);
+
+  EXPECT_NEAR(gx0.get_dual(), tx0.get_dual(), 1e-14);
+  std::cout << N << " scalar operations: " << graphSeconds << " s as State<double> steps, " << tapeSeconds
+            << " s on scalar tapes, " << graphSeconds / tapeSeconds << "x" << std::endl;
+  // only a loose bound, timings vary across build types and machines
+  EXPECT_LT(tapeSeconds, graphSeconds);
+}
@@ -0,0 +1,201 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/// @file test_gretl_sliding_window.cpp
+/// @brief Gradients over a sliding window of an unbounded run, checked against graphs built from the window boundary.
+
+#include <memory>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gretl/checkpoint_strategy_registry.hpp"
+#include "gretl/data_store.hpp"
+#include "gretl/replay_checkpoint_strategy.hpp"
+#include "gretl/test_utils.hpp"
+#include "gretl/time_integrator.hpp"
+#include "gretl/vector_state.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+
+using gretl::Vector;
+using gretl::VectorState;
+
+namespace {
+
+constexpr double dt = 0.05;
+
+/// logistic rate, p s - s^2 componentwise
+Vector logistic_rate(const Vector& s, const Vector& p, double)
+{
+  Vector r(s.size());
+  for (size_t i = 0; i < s.size(); ++i) {
+    r[i] = p[i] * s[i] - s[i] * s[i];
+  }
+  return r;
+}
+
+void logistic_rate_vjp(const Vector& s, const Vector& p, double, const Vector& rBar, Vector& sBar, Vector& pBar)
+{
+  for (size_t i = 0; i < s.size(); ++i) {
+    sBar[i] += (p[i] - 2.0 * s[i]) * rBar[i];
+    pBar[i] += s[i] * rBar[i];
+  }
+}
+
+VectorState time_step(const VectorState& s, const VectorState& p)
+{
+  return gretl::heun_step(s, p, 0.0, dt, logistic_rate, logistic_rate_vjp);
+}
+
+struct WindowGradient {
+  Vector boundaryGradient;  ///< gradient with respect to it
+  Vector paramsGradient;    ///< gradient with respect to the parameters
+};
+
+/// the window's gradient, from a graph which only holds the window: numSteps time steps from the boundary
+WindowGradient reference_gradient(const Vector& boundary, const Vector& params, size_t numSteps)
+{
+  gretl::DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(100));
+  auto p = store.create_state(params, gretl::vec::initialize_zero_dual);
+  auto s0 = store.create_state(boundary, gretl::vec::initialize_zero_dual);
+  VectorState s = s0;
+  for (size_t n = 0; n < numSteps; ++n) {
+    s = time_step(s, p);
+  }
+  gretl::set_as_objective(gretl::inner_product(s, s));
+  store.back_prop();
+  return {s0.get_dual(), p.get_dual()};
+}
+
+void expect_near(const Vector& a, const Vector& b, double tol)
+{
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_NEAR(a[i], b[i], tol);
+  }
+}
+
+}  // namespace
+
+TEST(SlidingWindow, GradientOverTheLastSteps)
+{
+  for (const char* name : {"wang", "strumm_walther", "adaptive"}) {
+    SCOPED_TRACE(name);
+    // a small budget, so the window boundary is often freed and must be evaluated again when it is retired
+    gretl::DataStore store(gretl::make_checkpoint_strategy(name, 3));
+    const gretl::Int window = 12;
+    store.set_window(window);
+
+    Vector params = {1.5, 0.8, 2.0};
+    auto p = store.create_state(params, gretl::vec::initialize_zero_dual);
+    VectorState s = store.create_state(Vector{0.1, 0.4, 1.1}, gretl::vec::initialize_zero_dual);
+    const size_t numSteps = 500;
+    for (size_t n = 0; n < numSteps; ++n) {
+      s = time_step(s, p);
+      // the parameters and the retired boundary are the only persistent steps
+      EXPECT_LE(store.size(), 2 * window + 2);
+    }
+    auto objective = gretl::set_as_objective(gretl::inner_product(s, s));
+    store.back_prop();
+
+    // the window holds the objective and the last window - 1 time steps, after the parameters and the boundary
+    ASSERT_EQ(window + 2, store.size());
+    gretl::Int boundaryStep = 1;
+    EXPECT_TRUE(store.is_persistent(boundaryStep));
+    auto reference = reference_gradient(store.get_primal<Vector>(boundaryStep), params, window - 1);
+    expect_near(p.get_dual(), reference.paramsGradient, 1e-12);
+    expect_near(store.get_dual<Vector, Vector>(boundaryStep), reference.boundaryGradient, 1e-12);
+
+    double constexpr eps = 1e-7;
+    gretl::check_array_gradients(objective, {p}, {eps}, {20 * eps});
+  }
+}
+
+TEST(SlidingWindow, TangentsThroughRetiredSteps)
+{
+  // the tangent of the objective, propagated again from the persistent steps, matches that of the whole run: a
+  // boundary evaluated again when it was retired keeps its tangent
+  Vector params = {1.5, 0.8, 2.0};
+  Vector state0 = {0.1, 0.4, 1.1};
+  auto objective_tangent = [&](gretl::Int window) {
+    gretl::DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(window > 0 ? 3 : 1000));
+    store.set_window(window);
+    auto p = store.create_state(params, gretl::vec::initialize_zero_dual);
+    VectorState s = store.create_state(state0, gretl::vec::initialize_zero_dual);
+    p.set_tangent(Vector{1.0, -0.5, 0.25});
+    for (size_t n = 0; n < 200; ++n) {
+      // built from VectorState operations, which all have jvps
+      s = s + dt * (p * s + -1.0 * (s * s));
+    }
+    auto objective = gretl::set_as_objective(gretl::inner_product(s, s));
+    store.back_prop();
+    store.reset();
+    store.reset_for_backprop();
+    return objective.get_tangent();
+  };
+  EXPECT_NEAR(objective_tangent(12), objective_tangent(0), 1e-12);
+}
+
+TEST(SlidingWindow, OnlineGradients)
+{
+  auto replayStrategy = std::make_unique<gretl::ReplayCheckpointStrategy>(
+      std::make_unique<gretl::WangCheckpointStrategy>(4));
+  const auto& replay = *replayStrategy;
+  gretl::DataStore store(std::move(replayStrategy));
+  const gretl::Int window = 20;
+  store.set_window(window);
+
+  Vector params = {1.2, 0.6};
+  auto p = store.create_state(params, gretl::vec::initialize_zero_dual);
+  VectorState s = store.create_state(Vector{0.3, 0.9}, gretl::vec::initialize_zero_dual);
+  for (size_t gradient = 0; gradient < 6; ++gradient) {
+    for (size_t n = 0; n < 37; ++n) {
+      s = time_step(s, p);
+    }
+    Vector last = s.get();
+    gretl::set_as_objective(gretl::inner_product(s, s));
+    store.back_prop();
+
+    // the earlier objectives are out of the window by now
+    ASSERT_EQ(window + 2, store.size());
+    gretl::Int boundaryStep = 1;
+    ASSERT_TRUE(store.is_persistent(boundaryStep));
+    auto reference = reference_gradient(store.get_primal<Vector>(boundaryStep), params, window - 1);
+    expect_near(p.get_dual(), reference.paramsGradient, 1e-12);
+    expect_near(store.get_dual<Vector, Vector>(boundaryStep), reference.boundaryGradient, 1e-12);
+
+    // back propagation freed the last state, which is evaluated again to continue the run
+    store.resume_graph();
+    EXPECT_EQ(last, s.get());
+
+    // setting the window again does not drop the recorded schedule
+    size_t scheduled = replay.schedule().size();
+    EXPECT_GT(scheduled, 0u);
+    store.set_window(window);
+    EXPECT_EQ(scheduled, replay.schedule().size());
+  }
+}
+
+TEST(SlidingWindow, DagWithLongLivedUpstreams)
+{
+  // several graph steps per time step, and upstreams used across the window boundary
+  gretl::DataStore store(std::make_unique<gretl::WangCheckpointStrategy>(5));
+  store.set_window(25);
+  auto p = store.create_state(Vector{0.9, 1.1, 0.7}, gretl::vec::initialize_zero_dual);
+  VectorState s = store.create_state(Vector{0.5, 0.2, 0.8}, gretl::vec::initialize_zero_dual);
+  VectorState lagged = s;
+  for (size_t n = 0; n < 120; ++n) {
+    VectorState next = s + dt * (p * s + -1.0 * (s * s)) + 0.01 * lagged;
+    if (n % 7 == 0) {
+      lagged = s;
+    }
+    s = next;
+  }
+  auto objective = gretl::set_as_objective(gretl::inner_product(s, s));
+  store.back_prop();
+  EXPECT_LE(store.size(), 25 + 4);
+
+  double constexpr eps = 1e-7;
+  gretl::check_array_gradients(objective, {p}, {eps}, {20 * eps});
+}
@@ -0,0 +1,122 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/// @file test_gretl_strategy_registry.cpp
+/// @brief Runtime selection of checkpoint strategies by name, including self-registered user strategies.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "gretl/checkpoint_strategy_registry.hpp"
+#include "gretl/data_store.hpp"
+#include "gretl/replay_checkpoint_strategy.hpp"
+#include "gretl/state.hpp"
+#include "gretl/strumm_walther_checkpoint_strategy.hpp"
+#include "gretl/wang_checkpoint_strategy.hpp"
+
+namespace {
+
+/// user strategy which never evicts, ignoring its budget
+class StoreAllCheckpointStrategy final : public gretl::CheckpointStrategy {
+ public:
+  explicit StoreAllCheckpointStrategy(size_t) {}
+
+  size_t add_checkpoint_and_get_index_to_remove(size_t step, bool persistent = false) override
+  {
+    (persistent ? persistent_ : steps_).insert(step);
+    metrics_.stores++;
+    return invalidCheckpointIndex;
+  }
+  size_t last_checkpoint_step() const override
+  {
+    size_t last = steps_.empty() ? 0 : *steps_.rbegin();
+    return persistent_.empty() ? last : std::max(last, *persistent_.rbegin());
+  }
+  bool erase_step(size_t stepIndex) override { return steps_.erase(stepIndex) > 0; }
+  bool contains_step(size_t stepIndex) const override
+  {
+    return steps_.count(stepIndex) > 0 || persistent_.count(stepIndex) > 0;
+  }
+  void reset() override { steps_.clear(); }
+  size_t capacity() const override { return std::numeric_limits<size_t>::max(); }
+  size_t size() const override { return steps_.size() + persistent_.size(); }
+  void print(std::ostream& os) const override { os << "CHECKPOINTS (StoreAll): " << size() << std::endl; }
+  gretl::CheckpointMetrics metrics() const override { return metrics_; }
+  void reset_metrics() override { metrics_ = {}; }
+  void record_recomputation() override { metrics_.recomputations++; }
+
+ private:
+  std::set<size_t> steps_;
+  std::set<size_t> persistent_;
+  gretl::CheckpointMetrics metrics_;
+};
+
+GRETL_REGISTER_CHECKPOINT_STRATEGY("store_all", StoreAllCheckpointStrategy);
+
+gretl::State<double> scaled(const gretl::State<double>& a)
+{
+  auto b = a.clone({a});
+  b.set_eval([](const gretl::UpstreamStates& upstreams, gretl::DownstreamState& downstream) {
+    downstream.set(upstreams[0].get<double>() / 3.0 + 2.0);
+  });
+  b.set_vjp([](gretl::UpstreamStates& upstreams, const gretl::DownstreamState& downstream) {
+    upstreams[0].get_dual<double, double>() += downstream.get_dual<double>() / 3.0;
+  });
+  return b.finalize();
+}
+
+}  // namespace
+
+TEST(StrategyRegistry, BuiltInStrategiesByName)
+{
+  auto wang = gretl::make_checkpoint_strategy("wang", 7);
+  EXPECT_NE(dynamic_cast<gretl::WangCheckpointStrategy*>(wang.get()), nullptr);
+  EXPECT_EQ(wang->capacity(), 7u);
+
+  auto strummWalther = gretl::make_checkpoint_strategy("Strumm_Walther", 4);
+  EXPECT_NE(dynamic_cast<gretl::StrummWaltherCheckpointStrategy*>(strummWalther.get()), nullptr);
+  EXPECT_EQ(strummWalther->capacity(), 4u);
+
+  auto replay = gretl::make_checkpoint_strategy("replay:wang", 5);
+  EXPECT_NE(dynamic_cast<gretl::ReplayCheckpointStrategy*>(replay.get()), nullptr);
+  EXPECT_EQ(replay->capacity(), 5u);
+
+  EXPECT_TRUE(gretl::is_checkpoint_strategy_registered("WANG"));
+  EXPECT_TRUE(gretl::is_checkpoint_strategy_registered("replay:strumm_walther"));
+  EXPECT_FALSE(gretl::is_checkpoint_strategy_registered("revolve"));
+  EXPECT_THROW(gretl::make_checkpoint_strategy("revolve", 5), std::runtime_error);
+  EXPECT_THROW(gretl::register_checkpoint_strategy("replay:wang", gretl::CheckpointStrategyFactory{}),
+               std::runtime_error);
+}
+
+TEST(StrategyRegistry, SelfRegisteredStrategyDrivesDataStore)
+{
+  auto names = gretl::registered_checkpoint_strategies();
+  EXPECT_NE(std::find(names.begin(), names.end(), "store_all"), names.end());
+
+  for (const auto& name : names) {
+    size_t N = 40;
+    gretl::DataStore dataStore(gretl::make_checkpoint_strategy(name, 4));
+    auto X0 = dataStore.create_state<double, double>(0.0);
+    auto X = X0;
+    for (size_t n = 0; n < N; ++n) {
+      X = scaled(X);
+    }
+    gretl::set_as_objective(X);
+    dataStore.back_prop();
+    EXPECT_NEAR(X0.get_dual(), std::pow(1.0 / 3.0, N), 1e-14) << name;
+
+    auto recomputations = dataStore.checkpointStrategy_->metrics().recomputations;
+    if (name == "store_all") {
+      EXPECT_EQ(recomputations, 0u);
+    } else {
+      EXPECT_GT(recomputations, 0u) << name;
+    }
+  }
+}
@@ -0,0 +1,252 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/// @file test_gretl_strumm_walther.cpp
+/// @brief Differential test of the O(log S) StrummWalther eviction search against the original linear-scan
+/// implementation, which is kept here as a reference.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <set>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gretl/checkpoint_strategy.hpp"
+#include "gretl/strumm_walther_checkpoint_strategy.hpp"
+
+namespace {
+
+/// the original StrummWalther strategy: slots in a sorted vector, with a quadratic dispensable search
+class ReferenceStrummWalther {
+ public:
+  explicit ReferenceStrummWalther(size_t maxStates) : maxNumSlots_(maxStates) {}
+
+  size_t add_checkpoint_and_get_index_to_remove(size_t step, bool persistent = false)
+  {
+    size_t nextEraseStep = gretl::CheckpointStrategy::invalidCheckpointIndex;
+    size_t newWeight = 0;
+
+    if (persistent) {
+      maxNumSlots_++;
+    }
+
+    if (slots_.size() >= maxNumSlots_) {
+      size_t dispensableIdx = find_dispensable();
+      if (dispensableIdx < slots_.size()) {
+        nextEraseStep = slots_[dispensableIdx].step;
+        slots_.erase(slots_.begin() + static_cast<ptrdiff_t>(dispensableIdx));
+      } else {
+        size_t rightmostIdx = find_rightmost_nonpersistent();
+        newWeight = slots_[rightmostIdx].weight + 1;
+        nextEraseStep = slots_[rightmostIdx].step;
+        slots_.erase(slots_.begin() + static_cast<ptrdiff_t>(rightmostIdx));
+      }
+    }
+
+    Slot newSlot{step, persistent, persistent ? std::numeric_limits<size_t>::max() : newWeight};
+    auto it =
+        std::lower_bound(slots_.begin(), slots_.end(), step, [](const Slot& s, size_t st) { return s.step < st; });
+    slots_.insert(it, newSlot);
+    return nextEraseStep;
+  }
+
+  size_t last_checkpoint_step() const { return slots_.back().step; }
+
+  bool erase_step(size_t stepIndex)
+  {
+    for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+      if (it->step == stepIndex && !it->persistent) {
+        slots_.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void reset()
+  {
+    slots_.erase(std::remove_if(slots_.begin(), slots_.end(), [](const Slot& s) { return !s.persistent; }),
+                 slots_.end());
+  }
+
+  size_t size() const { return slots_.size(); }
+
+ private:
+  struct Slot {
+    size_t step;
+    bool persistent;
+    size_t weight;
+  };
+
+  size_t find_dispensable() const
+  {
+    size_t maxWeight = 0;
+    size_t dispensableWeight = std::numeric_limits<size_t>::max();
+    for (size_t i = slots_.size(); i > 0; --i) {
+      size_t idx = i - 1;
+      if (slots_[idx].persistent) continue;
+      if (slots_[idx].weight < maxWeight) {
+        dispensableWeight = slots_[idx].weight;
+        break;
+      }
+      maxWeight = std::max(maxWeight, slots_[idx].weight);
+    }
+
+    if (dispensableWeight == std::numeric_limits<size_t>::max()) {
+      return slots_.size();
+    }
+
+    size_t bestIdx = slots_.size();
+    size_t bestProduct = std::numeric_limits<size_t>::max();
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i].persistent) continue;
+      if (slots_[i].weight != dispensableWeight) continue;
+
+      bool hasHigherWeightAfter = false;
+      for (size_t j = i + 1; j < slots_.size(); ++j) {
+        if (!slots_[j].persistent && slots_[j].weight > dispensableWeight) {
+          hasHigherWeightAfter = true;
+          break;
+        }
+      }
+      if (!hasHigherWeightAfter) continue;
+
+      size_t leftStep = (i > 0) ? slots_[i - 1].step : 0;
+      size_t rightStep = (i + 1 < slots_.size()) ? slots_[i + 1].step : slots_.back().step + 1;
+      size_t product = (slots_[i].step - leftStep) * (rightStep - slots_[i].step);
+      if (product < bestProduct) {
+        bestProduct = product;
+        bestIdx = i;
+      }
+    }
+    return bestIdx;
+  }
+
+  size_t find_rightmost_nonpersistent() const
+  {
+    for (size_t i = slots_.size(); i > 0; --i) {
+      if (!slots_[i - 1].persistent) {
+        return i - 1;
+      }
+    }
+    return slots_.size();
+  }
+
+  size_t maxNumSlots_;
+  std::vector<Slot> slots_;
+};
+
+/// runs the forward and reverse sweep of a linear chain through a strategy, recording every eviction decision
+template <typename Strategy>
+std::vector<size_t> sweep_decisions(Strategy& strategy, size_t numSteps, size_t numSweeps)
+{
+  std::vector<size_t> decisions;
+  strategy.add_checkpoint_and_get_index_to_remove(0, true);
+  for (size_t sweep = 0; sweep < numSweeps; ++sweep) {
+    strategy.reset();
+    for (size_t i = 0; i < numSteps; ++i) {
+      decisions.push_back(strategy.add_checkpoint_and_get_index_to_remove(i + 1));
+    }
+    for (size_t i = numSteps; i > 0; --i) {
+      while (strategy.last_checkpoint_step() < i) {
+        decisions.push_back(strategy.add_checkpoint_and_get_index_to_remove(strategy.last_checkpoint_step() + 1));
+      }
+      strategy.erase_step(i);
+    }
+  }
+  return decisions;
+}
+
+}  // namespace
+
+TEST(StrummWalther, SweepDecisionsMatchReference)
+{
+  for (size_t budget : {1, 2, 3, 5, 8, 13, 40}) {
+    for (size_t numSteps : {1, 7, 50, 333}) {
+      ReferenceStrummWalther reference(budget);
+      gretl::StrummWaltherCheckpointStrategy strategy(budget);
+      auto expected = sweep_decisions(reference, numSteps, 2);
+      auto actual = sweep_decisions(strategy, numSteps, 2);
+      ASSERT_EQ(expected, actual) << "budget=" << budget << " N=" << numSteps;
+    }
+  }
+}
+
+TEST(StrummWalther, RandomOperationsMatchReference)
+{
+  std::mt19937 random(20100326);
+  for (size_t trial = 0; trial < 200; ++trial) {
+    size_t budget = 1 + random() % 12;
+    ReferenceStrummWalther reference(budget);
+    gretl::StrummWaltherCheckpointStrategy strategy(budget);
+    std::set<size_t> live;
+    std::set<size_t> persistent;
+
+    auto add = [&](size_t step, bool isPersistent) {
+      size_t expected = reference.add_checkpoint_and_get_index_to_remove(step, isPersistent);
+      size_t actual = strategy.add_checkpoint_and_get_index_to_remove(step, isPersistent);
+      ASSERT_EQ(expected, actual) << "trial " << trial << " adding step " << step;
+      live.erase(expected);
+      live.insert(step);
+      if (isPersistent) {
+        persistent.insert(step);
+      }
+    };
+
+    add(0, true);
+    for (size_t op = 0; op < 300; ++op) {
+      size_t kind = random() % 10;
+      if (kind < 6) {
+        add(strategy.last_checkpoint_step() + 1 + random() % 3, false);
+      } else if (kind < 8 && !live.empty()) {
+        // new steps in between existing checkpoints
+        size_t step = random() % (strategy.last_checkpoint_step() + 2);
+        if (!live.count(step)) {
+          add(step, random() % 20 == 0);
+        }
+      } else if (kind < 9 && !live.empty()) {
+        auto it = live.begin();
+        std::advance(it, static_cast<ptrdiff_t>(random() % live.size()));
+        bool expected = reference.erase_step(*it);
+        ASSERT_EQ(expected, strategy.erase_step(*it)) << "trial " << trial << " erasing step " << *it;
+        if (expected) {
+          live.erase(it);
+        }
+      } else if (random() % 10 == 0) {
+        reference.reset();
+        strategy.reset();
+        live = persistent;
+      }
+      if (HasFatalFailure()) return;
+      ASSERT_EQ(reference.size(), strategy.size());
+      ASSERT_EQ(reference.last_checkpoint_step(), strategy.last_checkpoint_step());
+    }
+  }
+}
+
+TEST(StrummWalther, LargeBudgetTiming)
+{
+  size_t budget = 1000;
+  size_t numSteps = 10000;
+
+  auto time_ms = [&](auto& strategy) {
+    auto start = std::chrono::steady_clock::now();
+    auto decisions = sweep_decisions(strategy, numSteps, 1);
+    auto end = std::chrono::steady_clock::now();
+    return std::make_pair(std::chrono::duration<double, std::milli>(end - start).count(), decisions);
+  };
+
+  ReferenceStrummWalther reference(budget);
+  gretl::StrummWaltherCheckpointStrategy strategy(budget);
+  auto [referenceMs, expected] = time_ms(reference);
+  auto [treeMs, actual] = time_ms(strategy);
+  EXPECT_EQ(expected, actual);
+
+  std::cout << "StrummWalther budget=" << budget << " N=" << numSteps << ": reference " << referenceMs
+            << " ms, O(log S) " << treeMs << " ms, " << expected.size() << " stores" << std::endl;
+}
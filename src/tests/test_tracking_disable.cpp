@@ -1,9 +1,12 @@
+#include <chrono>
+#include <iostream>
 #include <gtest/gtest.h>
 #include "gretl/data_store.hpp"
 #include "gretl/state.hpp"
 #include "gretl/create_state.hpp"
 #include "gretl/wang_checkpoint_strategy.hpp"
 #include "gretl/double_state.hpp"
+#include "gretl/vector_state.hpp"
 
 using namespace gretl;
 
@@ -69,3 +72,61 @@ TEST(GraphTracking, PicardIterationNoOpVjp)
   // The dependency through x_10 is killed because x_10 has no-op VJP.
   EXPECT_EQ(p.get_dual(), 1.0);
 }
+
+TEST(GraphTracking, PicardIterationStreaming)
+{
+  DataStore ds(std::make_unique<WangCheckpointStrategy>(3));
+  auto p = ds.create_state<double, double>(0.1);
+  auto x = ds.create_state<double, double>(1.0);
+
+  // stream the iterations, nothing is recorded and every step but the live ones is reused
+  ds.set_streaming(true);
+  for (int i = 0; i < 10; ++i) {
+    x = picard_step(x, p, false);
+  }
+  EXPECT_EQ(4u, ds.size());
+
+  // the last iterate is kept as a constant of the graph
+  ds.set_streaming(false);
+  EXPECT_EQ(3u, ds.size());
+  EXPECT_EQ(2u, x.step());
+
+  auto x_final = picard_step(x, p, true);
+  auto obj = set_as_objective(x_final);
+  ds.finalize_graph();
+  ds.back_prop();
+  EXPECT_EQ(p.get_dual(), 1.0);
+}
+
+TEST(GraphTracking, StreamingBenchmark)
+{
+  constexpr size_t numSteps = 20000;
+  constexpr size_t size = 100;
+
+  auto run = [&](bool streaming, Int& graphSize) {
+    DataStore ds(std::make_unique<WangCheckpointStrategy>(20));
+    auto x = ds.create_state(Vector(size, 0.5), vec::initialize_zero_dual);
+    if (streaming) {
+      ds.set_streaming(true);
+    } else {
+      ds.set_gradients_enabled(false);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < numSteps; ++n) {
+      x = x + 1e-5 * (x * x);
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << (streaming ? "streaming: " : "gradients disabled: ") << seconds.count() << " s, " << ds.size()
+              << " steps held" << std::endl;
+    graphSize = ds.size();
+    return x.get();
+  };
+
+  Int disabledSize;
+  Int streamingSize;
+  Vector disabled = run(false, disabledSize);
+  Vector streamed = run(true, streamingSize);
+  EXPECT_EQ(disabled, streamed);
+  EXPECT_GT(disabledSize, numSteps);
+  EXPECT_LE(streamingSize, 5u);
+}
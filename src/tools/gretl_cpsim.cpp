@@ -0,0 +1,225 @@
+// Copyright (c) Lawrence Livermore National Security, LLC and
+// other Gretl Project Developers. See the top-level LICENSE file for
+// details.
+//
+// SPDX-License-Identifier: (BSD-3-Clause)
+
+/**
+ * @file gretl_cpsim.cpp
+ * @brief Command line checkpoint strategy simulator: estimates recomputation cost and checkpoint memory of a linear
+ * chain for a given number of steps, budget, and per-step cost and memory models, without running the real solver.
+ */
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gretl/checkpoint_simulator.hpp"
+#include "gretl/checkpoint_strategy_registry.hpp"
+
+namespace {
+
+void print_usage(std::ostream& os)
+{
+  os << "usage: gretl_cpsim -n <steps> -b <budget> [options]\n"
+     << "  -n, --steps <N>          number of forward steps\n"
+     << "  -b, --budget <S>         number of non-persistent checkpoints\n"
+     << "  -s, --strategy <name>    registered strategy to simulate, or 'all' (default)\n"
+     << "      --cost <model>       per-step cost: <v>, const:<v>, linear:<a>,<b> or file:<path> (default 1)\n"
+     << "      --memory <model>     per-state memory, same format as --cost (default 1)\n"
+     << "      --timeline           print the recompute timeline of the reverse sweep\n"
+     << "      --sweep <lo>:<hi>[:<stride>]\n"
+     << "                           print the budget vs cost curve over a range of budgets\n"
+     << "      --csv                comma separated output\n"
+     << "strategies:";
+  for (const auto& name : gretl::registered_checkpoint_strategies()) {
+    os << " " << name;
+  }
+  os << ", each also as replay:<name>";
+  os << std::endl;
+}
+
+struct Options {
+  size_t numSteps = 0;
+  size_t budget = 0;
+  std::string strategy = "all";
+  std::string cost = "1";
+  std::string memory = "1";
+  bool timeline = false;
+  bool csv = false;
+  std::vector<size_t> sweepBudgets;
+};
+
+std::vector<size_t> parse_sweep(const std::string& spec)
+{
+  // parsed as signed values, so a negative bound is rejected rather than wrapped around
+  std::vector<long long> values;
+  size_t begin = 0;
+  while (begin <= spec.size()) {
+    size_t end = spec.find(':', begin);
+    values.push_back(std::stoll(spec.substr(begin, end - begin)));
+    if (end == std::string::npos) break;
+    begin = end + 1;
+  }
+  if (values.size() < 2 || values.size() > 3 || values[0] < 1 || values[0] > values[1] ||
+      (values.size() == 3 && values[2] < 1)) {
+    throw std::invalid_argument("expected --sweep <lo>:<hi>[:<stride>] with 1 <= lo <= hi and stride >= 1");
+  }
+  const auto hi = static_cast<size_t>(values[1]);
+  const auto stride = static_cast<size_t>(values.size() == 3 ? values[2] : 1);
+  std::vector<size_t> budgets;
+  for (auto b = static_cast<size_t>(values[0]);; b += stride) {
+    budgets.push_back(b);
+    // stop before b + stride could pass hi, or overflow
+    if (hi - b < stride) break;
+  }
+  return budgets;
+}
+
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+  auto value = [&](int& i) {
+    if (i + 1 >= argc) {
+      throw std::invalid_argument(std::string("missing value for ") + argv[i]);
+    }
+    return std::string(argv[++i]);
+  };
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-n" || arg == "--steps") {
+      options.numSteps = std::stoul(value(i));
+    } else if (arg == "-b" || arg == "--budget") {
+      options.budget = std::stoul(value(i));
+    } else if (arg == "-s" || arg == "--strategy") {
+      options.strategy = value(i);
+    } else if (arg == "--cost") {
+      options.cost = value(i);
+    } else if (arg == "--memory") {
+      options.memory = value(i);
+    } else if (arg == "--timeline") {
+      options.timeline = true;
+    } else if (arg == "--sweep") {
+      options.sweepBudgets = parse_sweep(value(i));
+    } else if (arg == "--csv") {
+      options.csv = true;
+    } else if (arg == "-h" || arg == "--help") {
+      print_usage(std::cout);
+      std::exit(EXIT_SUCCESS);
+    } else {
+      throw std::invalid_argument("unknown argument " + arg);
+    }
+  }
+  if (options.numSteps == 0) {
+    throw std::invalid_argument("the number of steps is required");
+  }
+  if (options.budget == 0 && options.sweepBudgets.empty()) {
+    throw std::invalid_argument("a budget or a budget sweep is required");
+  }
+  if (options.strategy != "all" && !gretl::is_checkpoint_strategy_registered(options.strategy)) {
+    throw std::invalid_argument("unknown strategy " + options.strategy);
+  }
+  return options;
+}
+
+/// @brief table output, either aligned columns or comma separated
+class Table {
+ public:
+  Table(std::ostream& os, bool csv, std::vector<std::string> columns) : os_(os), csv_(csv), columns_(columns)
+  {
+    for (size_t c = 0; c < columns_.size(); ++c) {
+      cell(columns_[c], c);
+    }
+    os_ << "\n";
+  }
+
+  template <typename... Values>
+  void row(const Values&... values)
+  {
+    size_t c = 0;
+    (cell(values, c++), ...);
+    os_ << "\n";
+  }
+
+ private:
+  template <typename Value>
+  void cell(const Value& value, size_t c)
+  {
+    if (csv_) {
+      os_ << (c ? "," : "") << value;
+    } else {
+      os_ << std::setw(static_cast<int>(std::max<size_t>(columns_[c].size(), 10) + 2)) << value;
+    }
+  }
+
+  std::ostream& os_;
+  bool csv_;
+  std::vector<std::string> columns_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  Options options;
+  gretl::StepModel cost;
+  gretl::StepModel memory;
+  try {
+    options = parse_options(argc, argv);
+    cost = gretl::parse_step_model(options.cost);
+    memory = gretl::parse_step_model(options.memory);
+  } catch (const std::exception& e) {
+    std::cerr << "gretl_cpsim: " << e.what() << "\n";
+    print_usage(std::cerr);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> names = {options.strategy};
+  if (options.strategy == "all") {
+    names = gretl::registered_checkpoint_strategies();
+  }
+
+  std::cout << std::setprecision(6);
+
+  if (options.budget > 0) {
+    Table summary(std::cout, options.csv,
+                  {"strategy", "steps", "budget", "stores", "evictions", "recomputations", "forward_cost",
+                   "recompute_cost", "cost_ratio", "peak_checkpoints", "peak_memory"});
+    std::vector<std::pair<std::string, gretl::SimulationResult>> results;
+    for (const auto& name : names) {
+      auto strategy = gretl::make_checkpoint_strategy(name, options.budget);
+      auto r = gretl::simulate_checkpointing(options.numSteps, *strategy, cost, memory);
+      summary.row(name, options.numSteps, options.budget, r.metrics.stores, r.metrics.evictions,
+                  r.metrics.recomputations, r.forwardCost, r.recomputeCost, r.cost_ratio(), r.peakCheckpoints,
+                  r.peakMemory);
+      results.emplace_back(name, std::move(r));
+    }
+
+    if (options.timeline) {
+      for (const auto& [name, r] : results) {
+        std::cout << "\nrecompute timeline: " << name << "\n";
+        Table timeline(std::cout, options.csv, {"step", "from_step", "recomputations", "cost"});
+        for (const auto& event : r.timeline) {
+          timeline.row(event.step, event.fromStep, event.recomputations, event.cost);
+        }
+      }
+    }
+  }
+
+  if (!options.sweepBudgets.empty()) {
+    std::cout << "\nbudget sweep\n";
+    Table sweep(std::cout, options.csv,
+                {"strategy", "budget", "recomputations", "recompute_cost", "cost_ratio", "peak_memory"});
+    for (const auto& name : names) {
+      auto factory = [&name](size_t budget) { return gretl::make_checkpoint_strategy(name, budget); };
+      auto points = gretl::sweep_checkpoint_budgets(options.numSteps, factory, options.sweepBudgets, cost, memory);
+      for (const auto& point : points) {
+        const auto& r = point.result;
+        sweep.row(name, point.budget, r.metrics.recomputations, r.recomputeCost, r.cost_ratio(), r.peakMemory);
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}